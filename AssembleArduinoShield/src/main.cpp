@@ -18,10 +18,32 @@
  *      The jumper position needed is 1-2 with pin 3 empty. This allows for the switch, when pressed, to supply power to the display.
  */
 #include <Arduino.h>
+#include "scheduler.hpp"
+#include "coroutine.hpp"
+#include "gpio.hpp"
+#include "loop_monitor.hpp"
+#include "stack_paint.hpp"
+
+// switch and LED pins
+using Sw0 = Pin<PortB, PB0>; // count up
+using Sw1 = Pin<PortB, PB1>; // count down
+using Sw2 = Pin<PortB, PB2>; // blink LED
+using Sw3 = Pin<PortB, PB3>; // LED on
+using Switches = PinGroup<PortB, PB0, PB1, PB2, PB3>;
+using Led = Pin<PortB, PB5>;
+using Segments = PinGroup<PortD, PD0, PD1, PD2, PD3, PD4, PD5, PD6, PD7>;
+using Pot = Pin<PortC, PC0>; // A0
+const byte DP = Pin<PortD, PD7>::MASK; // decimal point
+const unsigned long blinkTime = 500; // ms per LED toggle
+
+// sequence of the switch being held, stepped by shieldTask()
+Coroutine shield;
+unsigned long digitTime = 0; // ms per digit, from A0 when the sequence started
+int8_t digit = 0;            // digit on the display
 
 // function prototypes
-void countdown();
-void countup();
+void shieldTask();
+CoStatus shieldSequence();
 
 // hex font array
 const byte hexFont[16] = {
@@ -49,10 +71,10 @@ void setup()
     // Serial.begin(9600);
 
     // set PORTB pin 5 to output for LED
-    DDRB |= 0b00100000;
+    Led::output();
 
     // set D0-D7 as output for 7-segment display
-    DDRD = 0b11111111;
+    Segments::output();
 
     /*
     Explain why PORTB, bits 0-3 must be configured as inputs. What might happen if this is ignored? Why?
@@ -60,68 +82,108 @@ void setup()
     This could damage the pin by creating a short circuit and potentially damage the MCU.
     */
     // set PORTB pins 0-3 as input for buttons
-    DDRB &= 0b11110000;
+    Switches::input();
 
     // set A0 as input
-    DDRC &= 0b11111110;
+    Pot::input();
+
+    // check the switches and step the sequence every millisecond
+    scheduler.addTask(shieldTask, 1);
+    scheduler.begin();
+
+    // loop() idles until each 1 ms tick, a longer gap is a late tick
+    loopMonitor.begin(1500);
+
+    stackPaint.begin(STACK_RESET_MARGIN);
 }
 
 void loop()
 {
-    int analogVal = analogRead(A0);
-    // check if PORTB pin 3 is LOW
-    if (!(PINB & 0b00001000))
+    loopMonitor.tick();
+    stackPaint.scan();
+
+    // run the tasks that are due, idle until the next tick otherwise
+    scheduler.run();
+
+    loopMonitor.report();
+    stackPaint.report();
+}
+
+/**
+ * @brief Step the switch sequence
+ *
+ */
+void shieldTask()
+{
+    shieldSequence();
+}
+
+/**
+ * @brief Read the switches, highest first, and run what they ask for. Each
+ * wait returns to the scheduler, and the next call carries on after it.
+ *
+ * @return CoStatus CO_DONE when the sequence has finished
+ */
+CoStatus shieldSequence()
+{
+    CO_BEGIN(shield);
+
+    // check if SW3 is LOW
+    if (Sw3::isLow())
     {
         // turn on LED
-        PORTB |= 0b00100000;
+        Led::set();
     }
-    else if (!(PINB & 0b00000100))
+    else if (Sw2::isLow())
     {
         // toggle LED
-        PORTB ^= 0b00100000;
-        delay(500);
+        Led::toggle();
+        CO_AWAIT_TICKS(shield, blinkTime);
     }
-    else if (!(PINB & 0b00000010))
+    else if (Sw1::isLow())
     {
-        // set PORTD pin 7 to HIGH
-        PORTD = 0b10000000;
-        delay(analogVal);
-        PORTD = 0b00000000;
+        digitTime = analogRead(A0);
+
+        // set the decimal point
+        Segments::write(DP);
+        CO_AWAIT_TICKS(shield, digitTime);
+        Segments::write(0);
 
-        for (int i = 15; i >= 0; --i)
+        for (digit = 15; digit >= 0; --digit)
         {
-            PORTD = hexFont[i];
-            delay(analogVal);
+            Segments::write(hexFont[digit]);
+            CO_AWAIT_TICKS(shield, digitTime);
 
-            if (PINB & 0b00000010)
+            if (Sw1::isHigh())
             {
                 break;
             }
-
         }
-
     }
-    else if (!(PINB & 0b00000001))
+    else if (Sw0::isLow())
     {
-        PORTD = 0b00000000; // ensure 7-segment is blank
+        digitTime = analogRead(A0);
+        Segments::write(0); // ensure 7-segment is blank
 
-        for (int i = 0; i < 16; ++i)
+        for (digit = 0; digit < 16; ++digit)
         {
-            PORTD = hexFont[i];
-            delay(analogVal);
+            Segments::write(hexFont[digit]);
+            CO_AWAIT_TICKS(shield, digitTime);
 
-            if (PINB & 0b00000001)
+            if (Sw0::isHigh())
             {
                 break;
             }
         }
 
-        PORTD = 0b10000000;
-        delay(analogVal);
+        Segments::write(DP);
+        CO_AWAIT_TICKS(shield, digitTime);
     }
     else
     {
         // turn off LED
-        PORTB &= 0b11011111;
+        Led::clear();
     }
+
+    CO_END(shield);
 }
@@ -0,0 +1,57 @@
+/**
+ * @file code_store.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Wear leveled EEPROM log of owner code changes
+ */
+#ifndef CODE_STORE_HPP
+#define CODE_STORE_HPP
+
+#include <Arduino.h>
+#include "code_table.hpp"
+
+const uint16_t CODE_LOG_BASE = 0;     // first EEPROM byte of the log
+const uint8_t CODE_LOG_RECORDS = 32;  // records in the ring, each slot wears 1/32
+
+/**
+ * @brief One record of the log. The crc is written last, so a record torn by a
+ * reset fails its check and the previous record stays the newest valid one.
+ */
+struct CodeRecord
+{
+    uint16_t sequence; // increases by one per record, wraps
+    CodeType code;
+    uint8_t crc;       // CRC-8 of sequence and code
+};
+
+/**
+ * @brief Append only EEPROM log of the owner code. Every change goes to the next
+ * slot of a ring, so EEPROM wear is spread over all slots. Writes are done one
+ * byte per EE_READY interrupt and never block the caller.
+ */
+class CodeStore
+{
+public:
+    void begin();
+    bool hasCode() const;
+    CodeType getCode() const;
+    void save(CodeType code);
+    bool isBusy() const;
+
+private:
+    static uint8_t recordCrc(const CodeRecord &record);
+    static bool isValid(const CodeRecord &record);
+    void startWrite();
+
+    CodeType code = EMPTY_CODE;  // newest code, EMPTY_CODE if none was saved
+    uint16_t sequence = 0;       // sequence of the newest record
+    uint8_t nextSlot = 0;        // slot the next record is written to
+
+    // pending write, drained by the EE_READY interrupt
+    CodeRecord pending;
+    volatile uint8_t pendingByte = sizeof(CodeRecord); // next byte of pending to write
+    volatile bool dirty = false; // code changed while a record was being written
+
+    friend void eepromReady();
+};
+
+#endif // CODE_STORE_HPP
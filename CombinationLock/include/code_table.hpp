@@ -0,0 +1,162 @@
+/**
+ * @file code_table.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Flash resident table of user codes with constant time lookup
+ */
+#ifndef CODE_TABLE_HPP
+#define CODE_TABLE_HPP
+
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+
+// a code is packed one key per nibble: '0'-'9' -> 0x0-0x9, 'A'-'D' -> 0xA-0xD,
+// so the code "1234" is 0x1234 and 0xF never appears in a valid code
+using CodeType = uint16_t;
+
+const uint8_t CODE_DIGITS = 4;           // keys per code (nibbles in CodeType)
+const CodeType EMPTY_CODE = 0xFFFF;      // marks an unused table slot
+const uint8_t NO_USER = 0xFF;            // lookup result when no code matches
+const uint8_t MAX_USERS = 32;            // user slots with audit counters
+const uint8_t CODE_TABLE_SIZE = 64;      // slots, power of two, at most half full
+const uint8_t MAX_PROBES = 4;            // longest probe sequence allowed
+
+/**
+ * @brief One slot of the open addressing hash table
+ */
+struct CodeSlot
+{
+    CodeType code;
+    uint8_t user;
+};
+
+/**
+ * @brief Open addressing (linear probing) hash table of user codes
+ */
+struct CodeSlots
+{
+    CodeSlot slot[CODE_TABLE_SIZE];
+};
+
+/**
+ * @brief Fibonacci hash of a packed code into a table index
+ *
+ * @param code
+ * @return constexpr uint8_t
+ */
+constexpr uint8_t hashCode(CodeType code)
+{
+    return static_cast<uint16_t>(code * 40503u) >> 10;
+}
+
+/**
+ * @brief Build the hash table at compile time. User n is codes[n].
+ *
+ * @tparam N number of users
+ * @param codes packed user codes
+ * @return constexpr CodeSlots
+ */
+template <size_t N>
+constexpr CodeSlots buildCodeSlots(const CodeType (&codes)[N])
+{
+    CodeSlots table{};
+
+    for (uint8_t i = 0; i < CODE_TABLE_SIZE; ++i)
+    {
+        table.slot[i] = {EMPTY_CODE, NO_USER};
+    }
+
+    for (uint8_t user = 0; user < N; ++user)
+    {
+        uint8_t index = hashCode(codes[user]);
+        while (table.slot[index].code != EMPTY_CODE)
+        {
+            index = (index + 1) & (CODE_TABLE_SIZE - 1);
+        }
+        table.slot[index] = {codes[user], user};
+    }
+
+    return table;
+}
+
+/**
+ * @brief Longest number of slots a lookup has to read, hit or miss, including
+ * the empty slot that ends the search. The worst case is a miss that hashes to
+ * the first slot of the longest run of used slots and reads the whole run.
+ *
+ * @param table
+ * @return constexpr uint8_t
+ */
+constexpr uint8_t longestProbe(const CodeSlots &table)
+{
+    uint8_t longest = 0;
+
+    for (uint8_t start = 0; start < CODE_TABLE_SIZE; ++start)
+    {
+        uint8_t probes = 1;
+        uint8_t index = start;
+        while (table.slot[index].code != EMPTY_CODE && probes <= CODE_TABLE_SIZE)
+        {
+            index = (index + 1) & (CODE_TABLE_SIZE - 1);
+            ++probes;
+        }
+
+        if (probes > longest)
+        {
+            longest = probes;
+        }
+    }
+
+    return longest;
+}
+
+/**
+ * @brief Check that every code is made of valid keys and no code is repeated
+ *
+ * @tparam N number of users
+ * @param codes
+ * @return constexpr bool
+ */
+template <size_t N>
+constexpr bool validCodes(const CodeType (&codes)[N])
+{
+    for (uint8_t i = 0; i < N; ++i)
+    {
+        for (uint8_t digit = 0; digit < CODE_DIGITS; ++digit)
+        {
+            if (((codes[i] >> (4 * digit)) & 0x0F) > 0x0D)
+            {
+                return false;
+            }
+        }
+
+        for (uint8_t j = i + 1; j < N; ++j)
+        {
+            if (codes[i] == codes[j])
+            {
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief User code table. The codes live in flash and only the per-user audit
+ * counters take SRAM.
+ */
+class CodeTable
+{
+public:
+    CodeTable();
+
+    uint8_t lookup(CodeType code) const;
+    void recordUse(uint8_t user);
+    uint16_t auditCount(uint8_t user) const;
+    uint8_t userCount() const;
+
+private:
+    uint16_t audit[MAX_USERS];
+};
+
+#endif // CODE_TABLE_HPP
@@ -9,16 +9,23 @@
 
 #include <Arduino.h>
 #include "utils.hpp"
-
-#define nop() asm("nop \n")
+#include "timing.hpp"
+#include "gpio.hpp"
 
 using TickType = unsigned long;
 
 const TickType DEBOUNCE_DELAY = 5000;
+const uint32_t ROW_SETTLE_NS = 1000; // time for the columns to settle after driving a row
 
 const uint8_t ROWS = 4;
 const uint8_t COLS = 4;
 
+// rows and columns, in keys[][] order
+using RowPins = PinGroup<PortD, PD0, PD7, PD6, PD4>;
+using ColPins = PinGroup<PortD, PD5, PD3, PD2, PD1>;
+const uint8_t ROW_MASKS[ROWS] = {pinMask(PD0), pinMask(PD7), pinMask(PD6), pinMask(PD4)};
+const uint8_t COL_MASKS[COLS] = {pinMask(PD5), pinMask(PD3), pinMask(PD2), pinMask(PD1)};
+
 /**
  * @brief Class for interfacing with a keypad
  */
@@ -29,7 +36,7 @@ public:
     // it should be able to be deduced from the size of the array passed in.
     KeyMatrix();
     
-    char getKey();
+    char getKey(TickType debounceDelay = DEBOUNCE_DELAY);
 
 private: 
     char keys[ROWS][COLS] = {
@@ -38,8 +45,6 @@ private:
         {'7', '8', '9', 'C'},
         {'*', '0', '#', 'D'}
     };
-    uint8_t rowPins[ROWS] = {0, 7, 6, 4};
-    uint8_t colPins[COLS] = {5, 3, 2, 1};
     uint8_t numRows;
     uint8_t numCols;
     char keyState;
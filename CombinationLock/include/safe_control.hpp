@@ -8,10 +8,34 @@
 
 #include <Arduino.h>
 #include "key_matrix.hpp"
+#include "code_table.hpp"
+#include "code_store.hpp"
+#include "config_store.hpp"
+#include "warm_restart.hpp"
+#include "task_supervisor.hpp"
+#include "coroutine.hpp"
+#include "gpio.hpp"
 
 using namespace std;
 
-const String Code = "1234";
+const uint8_t OWNER_USER = 0; // user slot whose code can be changed with SET_CODE
+
+// supervised tasks
+enum SafeTask : uint8_t
+{
+    TASK_KEYPAD, // one keypad scan and state machine step
+    TASK_SERVO,  // one servo move
+};
+
+/**
+ * @brief Tuning values kept in EEPROM
+ */
+struct SafeConfig
+{
+    uint16_t pulseMin;      // closed servo pulse in microseconds
+    uint16_t pulseMax;      // open servo pulse in microseconds
+    TickType debounceDelay; // keypad debounce time in microseconds
+};
 
 class SafeControl
 {
@@ -25,24 +49,44 @@ private:
     };
     bool checkCombination();
     void servoOpen(bool open);
+    CoStatus servoMove();
+    void openSafe();
+    void closeSafe();
+    void saveWarmState(bool moving);
+    void updateContinuous(char key);
+    static int8_t symbolIndex(char key);
     KeyMatrix keypad;
+    CodeTable codes;
+    CodeStore store;
+    TaskSupervisor supervisor;
 
-    uint8_t codeLength = 4;
+    uint8_t codeLength = CODE_DIGITS;
 
-    byte ledPin = PB5;
-    byte servoPin = PC5;
+    using Led = Pin<PortB, PB5>;
+    using Servo = Pin<PortC, PC5>;
     // pins PD0-PD7 map to Keypad pins 7-0 (respectively)
-    int pulseMin = 1000;   // -60 degrees
-                           //  int pulseMid = 1500;   // 0 degrees
-    int pulseMax = 2000;   // +60 degrees
+    // servo pulses: 1000 us is -60 degrees, 1500 us is 0 and 2000 us is +60,
+    // the defaults are in safe_control.cpp
+    ConfigStore<SafeConfig> config;
     int freq = 100;        // 60 Hz
     int pulseWidth = 1;    // 1 ms pulse width
     int timeFrame = 20000; // 20 ms time frame
 
+    // servo move in progress, stepped from update()
+    Coroutine servo;
+    bool servoMoving = false;
+    bool servoTarget = true; // move to the open position
+    int servoPulses = 0;     // pulses sent in this move
+
     int closedPos = -60;
     int openPos = 60;
 
-    String enteredCode = "";
+    CodeType enteredCode = 0;     // keys typed so far, packed one per nibble
+    uint8_t enteredLength = 0;    // number of keys in enteredCode
+    uint8_t lastUser = NO_USER;   // user slot of the last matching code
+
+    // continuous entry: the last codeLength keys typed, looked up on every key
+    bool continuousEntry = false;
 
     State state = OPEN;
     State lastState = OPEN;
@@ -51,6 +95,10 @@ public:
     SafeControl();
     void update();
     void init();
+    void setContinuousEntry(bool enable);
+    uint8_t getLastUser() const;
+    uint16_t getAuditCount(uint8_t user) const;
+    uint8_t getLastFailure() const;
 };
 
 #endif // SAFE_CONTROL_HPP
@@ -1,7 +1,7 @@
 /**
  * @file utils.hpp
  * @author your name (you@domain.com)
- * @brief Declaration of utility functions
+ * @brief Shared types
  */
 #ifndef UTILS_HPP
 #define UTILS_HPP
@@ -10,7 +10,6 @@
 
 using TickType = unsigned long;
 
-void delayMicros(TickType uS);
 // function to map a 2d array of keys to a 1d array of keys
 
 
@@ -0,0 +1,211 @@
+/**
+ * @file code_store.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Definition of the wear leveled EEPROM log of owner code changes
+ */
+#include "code_store.hpp"
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+
+// store whose pending record the EE_READY interrupt is writing
+static CodeStore *activeStore = nullptr;
+
+/**
+ * @brief Find the newest valid record. Reads every slot once, so boot time is
+ * bounded by CODE_LOG_RECORDS no matter how often the code was changed.
+ *
+ */
+void CodeStore::begin()
+{
+    bool found = false;
+
+    for (uint8_t slot = 0; slot < CODE_LOG_RECORDS; ++slot)
+    {
+        CodeRecord record;
+        eeprom_read_block(&record, (const void *)(CODE_LOG_BASE + slot * sizeof(CodeRecord)), sizeof(CodeRecord));
+
+        if (!isValid(record))
+        {
+            continue;
+        }
+
+        // sequence numbers wrap, so compare by signed difference
+        if (!found || (int16_t)(record.sequence - this->sequence) > 0)
+        {
+            found = true;
+            this->code = record.code;
+            this->sequence = record.sequence;
+            this->nextSlot = (slot + 1) % CODE_LOG_RECORDS;
+        }
+    }
+
+    activeStore = this;
+}
+
+/**
+ * @brief Check if an owner code has been saved
+ *
+ * @return true
+ * @return false
+ */
+bool CodeStore::hasCode() const
+{
+    return this->code != EMPTY_CODE;
+}
+
+/**
+ * @brief Get the newest saved owner code
+ *
+ * @return CodeType code, or EMPTY_CODE if none was saved
+ */
+CodeType CodeStore::getCode() const
+{
+    return this->code;
+}
+
+/**
+ * @brief Save a new owner code. The code takes effect immediately; the record
+ * is written in the background. Changes made while a record is being written
+ * are coalesced into one more record.
+ *
+ * @param code
+ */
+void CodeStore::save(CodeType code)
+{
+    uint8_t oldSREG = SREG;
+    cli();
+
+    this->code = code;
+
+    if (this->pendingByte < sizeof(CodeRecord))
+    {
+        this->dirty = true;
+    }
+    else
+    {
+        startWrite();
+    }
+
+    SREG = oldSREG;
+}
+
+/**
+ * @brief Check if a record is still being written
+ *
+ * @return true
+ * @return false
+ */
+bool CodeStore::isBusy() const
+{
+    return this->pendingByte < sizeof(CodeRecord) || this->dirty;
+}
+
+/**
+ * @brief Build the next record from code and start writing it. Must be called
+ * with interrupts disabled.
+ *
+ */
+void CodeStore::startWrite()
+{
+    this->pending.sequence = ++this->sequence;
+    this->pending.code = this->code;
+    this->pending.crc = recordCrc(this->pending);
+    this->pendingByte = 0;
+    this->dirty = false;
+
+    // EE_READY fires as soon as the EEPROM is idle
+    EECR |= (1 << EERIE);
+}
+
+/**
+ * @brief CRC-8 of the sequence and code of a record
+ *
+ * @param record
+ * @return uint8_t
+ */
+uint8_t CodeStore::recordCrc(const CodeRecord &record)
+{
+    const uint8_t *bytes = (const uint8_t *)&record;
+    uint8_t crc = 0;
+
+    for (uint8_t i = 0; i < offsetof(CodeRecord, crc); ++i)
+    {
+        crc = _crc8_ccitt_update(crc, bytes[i]);
+    }
+
+    return crc;
+}
+
+/**
+ * @brief Check a record read from EEPROM. Erased slots read as 0xFF and are
+ * rejected because 0xF is not a key.
+ *
+ * @param record
+ * @return true
+ * @return false
+ */
+bool CodeStore::isValid(const CodeRecord &record)
+{
+    if (record.crc != recordCrc(record))
+    {
+        return false;
+    }
+
+    for (uint8_t digit = 0; digit < CODE_DIGITS; ++digit)
+    {
+        if (((record.code >> (4 * digit)) & 0x0F) > 0x0D)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Write the next byte of the pending record. Bytes that already hold the
+ * right value are skipped to save EEPROM wear.
+ *
+ */
+void eepromReady()
+{
+    CodeStore *store = activeStore;
+
+    while (store->pendingByte < sizeof(CodeRecord))
+    {
+        uint8_t index = store->pendingByte++;
+        uint16_t address = CODE_LOG_BASE + store->nextSlot * sizeof(CodeRecord) + index;
+        uint8_t data = ((const uint8_t *)&store->pending)[index];
+
+        if (index == sizeof(CodeRecord) - 1)
+        {
+            // record complete once the crc is written
+            store->nextSlot = (store->nextSlot + 1) % CODE_LOG_RECORDS;
+        }
+
+        EEAR = address;
+        EECR |= (1 << EERE);
+        if (EEDR != data)
+        {
+            EEDR = data;
+            EECR |= (1 << EEMPE);
+            EECR |= (1 << EEPE);
+            return;
+        }
+    }
+
+    if (store->dirty)
+    {
+        store->startWrite();
+        return;
+    }
+
+    // nothing left to write
+    EECR &= ~(1 << EERIE);
+}
+
+// ISR for EEPROM ready, fires whenever EERIE is set and no write is in progress
+ISR(EE_READY_vect)
+{
+    eepromReady();
+}
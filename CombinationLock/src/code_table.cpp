@@ -0,0 +1,114 @@
+/**
+ * @file code_table.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Definition of the flash resident user code table
+ */
+#include "code_table.hpp"
+
+// user codes, one per user slot. User 0 is the owner.
+constexpr CodeType UserCodes[] = {
+    0x1234, // 0 owner
+    0x2580, // 1
+    0x1397, // 2
+    0x4826, // 3
+    0x7050, // 4
+    0x9146, // 5
+    0x3A81, // 6
+    0x6302, // 7
+    0x5C19, // 8
+    0x0871, // 9
+    0x2244, // 10
+    0xB407, // 11
+    0x8815, // 12
+    0x6931, // 13
+    0x4D72, // 14
+    0x1029, // 15
+};
+
+const uint8_t USER_COUNT = sizeof(UserCodes) / sizeof(UserCodes[0]);
+
+static_assert(USER_COUNT <= MAX_USERS, "too many user codes");
+static_assert(USER_COUNT * 2 <= CODE_TABLE_SIZE, "code table more than half full");
+static_assert(CODE_TABLE_SIZE == 64, "hashCode() yields 6 bit indices");
+static_assert(validCodes(UserCodes), "user codes must be unique and use keys 0-9 and A-D");
+
+constexpr CodeSlots codeSlots PROGMEM = buildCodeSlots(UserCodes);
+
+static_assert(longestProbe(codeSlots) <= MAX_PROBES, "code table probe sequence too long, change a code");
+
+/**
+ * @brief Construct a new Code Table:: Code Table object
+ *
+ */
+CodeTable::CodeTable()
+{
+    for (uint8_t i = 0; i < MAX_USERS; ++i)
+    {
+        this->audit[i] = 0;
+    }
+}
+
+/**
+ * @brief Find the user slot that owns a code. Reads at most MAX_PROBES slots
+ * from flash.
+ *
+ * @param code packed code
+ * @return uint8_t user slot, or NO_USER if the code is not in the table
+ */
+uint8_t CodeTable::lookup(CodeType code) const
+{
+    uint8_t index = hashCode(code);
+
+    for (uint8_t probe = 0; probe < MAX_PROBES; ++probe)
+    {
+        CodeType slotCode = pgm_read_word(&codeSlots.slot[index].code);
+
+        if (slotCode == code)
+        {
+            return pgm_read_byte(&codeSlots.slot[index].user);
+        }
+
+        if (slotCode == EMPTY_CODE)
+        {
+            break;
+        }
+
+        index = (index + 1) & (CODE_TABLE_SIZE - 1);
+    }
+
+    return NO_USER;
+}
+
+/**
+ * @brief Count a successful open or close by a user
+ *
+ * @param user
+ */
+void CodeTable::recordUse(uint8_t user)
+{
+    if (user < MAX_USERS && this->audit[user] != 0xFFFF)
+    {
+        ++this->audit[user];
+    }
+}
+
+/**
+ * @brief Number of times a user has opened or closed the safe
+ *
+ * @param user
+ * @return uint16_t
+ */
+uint16_t CodeTable::auditCount(uint8_t user) const
+{
+    return user < MAX_USERS ? this->audit[user] : 0;
+}
+
+/**
+ * @brief Number of users in the table
+ *
+ * @return uint8_t
+ */
+uint8_t CodeTable::userCount() const
+{
+    return USER_COUNT;
+}
@@ -4,6 +4,7 @@
  * @brief Class definition for interfacing with a keypad
  */
 #include "key_matrix.hpp"
+#include "profiler.hpp"
 
 /**
  * @brief Construct a new Key Matrix:: Key Matrix object
@@ -18,25 +19,19 @@ KeyMatrix::KeyMatrix()
     this->lastDebounceTime = 0;
 
     // set Row pins to input
-    for (int i = 0; i < this->numRows; i++)
-    {
-        DDRD &= ~(1 << rowPins[i]);
-    }
+    RowPins::input();
 
     // set Col pins to input_pullup
-    for (uint8_t i = 0; i < this->numCols; i++)
-    {
-        DDRD &= ~(1 << this->colPins[i]);
-        PORTD |= (1 << this->colPins[i]);
-    }
+    ColPins::pullUp();
 }
 
 /**
  * @brief Get the key pressed on the keypad and debounce it
  * 
+ * @param debounceDelay time the key must be stable, in microseconds
  * @return char 
  */
-char KeyMatrix::getKey()
+char KeyMatrix::getKey(TickType debounceDelay)
 {
     // get key press
     char rawKeyPress = this->getRawKey();
@@ -46,7 +41,7 @@ char KeyMatrix::getKey()
         this->lastDebounceTime = micros();
     }
 
-    if ((micros() - this->lastDebounceTime) > DEBOUNCE_DELAY)
+    if ((micros() - this->lastDebounceTime) > debounceDelay)
     {
         if (rawKeyPress != this->keyState)
         {
@@ -69,52 +64,40 @@ char KeyMatrix::getKey()
  */
 char KeyMatrix::getRawKey()
 {
+    PROFILE("getRawKey");
+
     // loop through rows, set ROWn to 1, make ROWn an output, clear ROWn to 0, delay for ~1uS, read column inputs, set ROWn to 1, make all ROWs inputs again
-    for (int i = 0; i < this->numRows; i++)
+    for (uint8_t i = 0; i < this->numRows; i++)
     {
         // set ROWn to 1
-        PORTD |= (1 << this->rowPins[i]);
+        RowPins::set();
 
         // make ROWn an output
-        DDRD |= (1 << this->rowPins[i]);
+        DDRD |= ROW_MASKS[i];
 
         // clear ROWn to 0
-        PORTD &= ~(1 << this->rowPins[i]);
+        PORTD &= ~ROW_MASKS[i];
 
-        // delay for ~1uS
-        nop();
-        nop();
+        // let the columns settle
+        delayNanos<ROW_SETTLE_NS>();
 
         // read column inputs
-        for (int j = 0; j < this->numCols; j++)
+        uint8_t cols = ColPins::read();
+
+        // set ROWn to 1 and make all ROWs inputs again
+        RowPins::set();
+        RowPins::input();
+
+        for (uint8_t j = 0; j < this->numCols; j++)
         {
             // check if column is low
-            if (!(PIND & (1 << this->colPins[j])))
+            if (!(cols & COL_MASKS[j]))
             {
-                // set ROWn to 1
-                PORTD |= (1 << this->rowPins[i]);
-                // make all ROWs inputs again
-                for (int k = 0; k < this->numRows; k++)
-                {
-                    // make ROWn an input
-                    DDRD &= ~(1 << this->rowPins[k]);
-                    // enable pullup
-                    // PORTD |= (1 << ROW_PINS[k]);
-                }
                 // return key
                 return this->keys[i][j];
             }
         }
-
-        // set ROWn to 1
-        PORTD |= (1 << this->rowPins[i]);
-        // make all ROWs inputs again
-        for (uint8_t k = 0; k < this->numRows; k++)
-        {
-            // make ROWn an input
-            DDRD &= ~(1 << this->rowPins[k]);
-        }
     }
 
     return '\0';
-}
\ No newline at end of file
+}
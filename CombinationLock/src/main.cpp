@@ -5,8 +5,28 @@
  * @date 2023-11-10
  *
  * If the wrong combination is entered, pressing the '#' or '*' key will reset
+ *
+ * While the safe is open, the owner code followed by '*' starts a code change:
+ * type the new code and press '#' to save it to EEPROM, or '*' to cancel.
+ *
+ * Build with -D SAFE_CONTINUOUS_ENTRY to toggle the safe as soon as the code is
+ * typed, without pressing '#' or '*' and without clearing after a typo.
+ *
+ * After a watchdog or brown-out reset the safe comes back open or closed as it
+ * was, without moving the servo. A power-on or reset button start opens it,
+ * and a start whose reset cause cannot be read locks it.
+ *
+ * Built with -D PROFILE_ENABLE (pio run -e profile) it prints the cycles spent
+ * in the PROFILE() sections every PROFILE_PERIOD ms at PROFILE_BAUD. The UART
+ * shares PD0 and PD1 with the keypad, so it is only on while printing.
  */
 #include "safe_control.hpp"
+#include "profiler.hpp"
+#include "loop_monitor.hpp"
+#include "stack_paint.hpp"
+
+const unsigned long PROFILE_PERIOD = 5000; // ms between profile dumps
+const unsigned long PROFILE_BAUD = 115200;
 
 SafeControl safe;
 
@@ -14,10 +34,38 @@ void setup()
 {
     // initialize safe
     safe.init();
+
+#ifdef SAFE_CONTINUOUS_ENTRY
+    safe.setContinuousEntry(true);
+#endif
+
+    profiler.begin();
+
+    // a keypad scan and at most one servo pulse per iteration
+    loopMonitor.begin(5000);
+
+    stackPaint.begin(STACK_RESET_MARGIN);
 }
 
 void loop()
 {
+    loopMonitor.tick();
+    stackPaint.scan();
+
     // update safe
     safe.update();
+
+    loopMonitor.report();
+    stackPaint.report();
+
+#ifdef PROFILE_ENABLE
+    if (profiler.due(PROFILE_PERIOD))
+    {
+        Serial.begin(PROFILE_BAUD);
+        profiler.print(Serial);
+        Serial.flush();
+        Serial.end(); // give PD0 and PD1 back to the keypad
+        profiler.reset();
+    }
+#endif
 }
\ No newline at end of file
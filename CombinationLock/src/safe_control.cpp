@@ -4,57 +4,212 @@
  * @brief Class definition for interfacing with a safe
  */
 #include "safe_control.hpp"
+#include "profiler.hpp"
+
+const ConfigField safeConfigFields[] PROGMEM = {
+    CONFIG_FIELD(SafeConfig, pulseMin),      // key 0
+    CONFIG_FIELD(SafeConfig, pulseMax),      // key 1
+    CONFIG_FIELD(SafeConfig, debounceDelay), // key 2
+};
+
+/**
+ * @brief Safe state kept across a watchdog or brown-out reset
+ */
+struct SafeWarmState
+{
+    uint8_t state;    // OPEN or CLOSED, where the servo is or is moving to
+    uint8_t lastUser;
+    bool moving;      // reset came while the servo was moving
+};
+
+static WarmState<SafeWarmState> warmState WARM_NOINIT;
 
 /**
  * @brief Construct a new Safe Control:: Safe Control object
  * 
  */
-SafeControl::SafeControl()
+SafeControl::SafeControl() : config({1000, 2000, DEBOUNCE_DELAY}, 1, safeConfigFields)
 {
     // set SERVO_PIN to output
-    DDRC |= (1 << servoPin);
+    Servo::output();
 
     // set LED_PIN to output
-    DDRB |= (1 << ledPin);
+    Led::output();
 }
 
 /**
- * @brief Check combination against entered code and return true if they match
+ * @brief Check entered code against the user code table and return true if it
+ * belongs to a user. The matching user is saved in lastUser.
  * 
  * @return true 
  * @return false 
  */
 bool SafeControl::checkCombination()
 {
-    // check if code is correct
-    if (enteredCode == Code)
+    if (enteredLength != codeLength)
+    {
+        return false;
+    }
+
+    // a saved owner code replaces the owner code in the table
+    if (store.hasCode() && enteredCode == store.getCode())
     {
+        lastUser = OWNER_USER;
         return true;
     }
 
-    return false;
+    // check if code is correct
+    lastUser = codes.lookup(enteredCode);
+
+    if (lastUser == OWNER_USER && store.hasCode())
+    {
+        lastUser = NO_USER;
+    }
+
+    return lastUser != NO_USER;
 }
 
 /**
- * @brief Move servo to open or closed position
+ * @brief Close the safe, light the LED and clear the entered code
  * 
- * @param open 
  */
-void SafeControl::servoOpen(bool open)
+void SafeControl::closeSafe()
 {
-    int pulseWidth = open ? pulseMax : pulseMin;
+    // switch state to close safe
+    state = CLOSED;
+    servoOpen(false);
 
-    for (int i = 0; i < freq; ++i)
+    // set LED to HIGH
+    Led::set();
+
+    codes.recordUse(lastUser);
+
+    // reset code
+    enteredCode = 0;
+    enteredLength = 0;
+}
+
+/**
+ * @brief Open the safe, clear the LED and clear the entered code
+ * 
+ */
+void SafeControl::openSafe()
+{
+    // switch state to open safe
+    state = OPEN;
+    servoOpen(true);
+
+    // set LED to LOW
+    Led::clear();
+
+    codes.recordUse(lastUser);
+
+    // reset code
+    enteredCode = 0;
+    enteredLength = 0;
+}
+
+/**
+ * @brief Save the open or closed state to .noinit RAM for a warm restart. It
+ * is taken from the servo, not from state, which may be INVALID_CODE or
+ * SET_CODE for an update and would make init() cold start and open the safe.
+ * 
+ * @param moving true while the servo is moving to the new position
+ */
+void SafeControl::saveWarmState(bool moving)
+{
+    warmState.data.state = servoTarget ? OPEN : CLOSED;
+    warmState.data.lastUser = lastUser;
+    warmState.data.moving = moving;
+    warmState.save();
+}
+
+/**
+ * @brief Map a code key to the nibble it is packed as
+ * 
+ * @param key 
+ * @return int8_t 0x0-0xD, or -1 for '*', '#' and no key
+ */
+int8_t SafeControl::symbolIndex(char key)
+{
+    if (key >= '0' && key <= '9')
+    {
+        return key - '0';
+    }
+
+    if (key >= 'A' && key <= 'D')
+    {
+        return 10 + (key - 'A');
+    }
+
+    return -1;
+}
+
+/**
+ * @brief Enable or disable continuous entry. In continuous entry mode the safe
+ * toggles as soon as the last key of a user code is typed, no matter what was
+ * typed before it, and '*' or '#' only clear the entry.
+ * 
+ * @param enable 
+ */
+void SafeControl::setContinuousEntry(bool enable)
+{
+    continuousEntry = enable;
+    enteredCode = 0;
+    enteredLength = 0;
+
+    // continuous entry only knows OPEN and CLOSED: settle a rejected entry and
+    // cancel a code change rather than leave them to the other mode
+    if (state == INVALID_CODE)
+    {
+        state = lastState;
+    }
+    if (state == SET_CODE)
+    {
+        state = OPEN;
+    }
+}
+
+/**
+ * @brief Shift one key into the continuous entry window and toggle the safe
+ * when the last codeLength keys typed are a user code. Codes are fixed length,
+ * so the window is the only state needed to match any code as a suffix.
+ * 
+ * @param key 
+ */
+void SafeControl::updateContinuous(char key)
+{
+    if (key == '\0')
     {
-        // set SERVO_PIN high
-        PORTC |= (1 << servoPin);
-        // delay for pulseWidth
-        delayMicroseconds(pulseWidth);
-        // set SERVO_PIN low
-        PORTC &= ~(1 << servoPin);
-        // delay for 20 ms to complete servo cycle
-        delayMicroseconds(timeFrame);
-        // delayMicroseconds(timeFrame - pulseWidth);
+        return;
+    }
+
+    int8_t symbol = symbolIndex(key);
+    if (symbol < 0)
+    {
+        // '*' and '#' clear the entry
+        enteredCode = 0;
+        enteredLength = 0;
+        return;
+    }
+
+    // older keys fall off the top of the window
+    enteredCode = (enteredCode << 4) | symbol;
+    if (enteredLength < codeLength)
+    {
+        ++enteredLength;
+    }
+
+    if (checkCombination())
+    {
+        if (state == OPEN)
+        {
+            closeSafe();
+        }
+        else
+        {
+            openSafe();
+        }
     }
 }
 
@@ -64,18 +219,47 @@ void SafeControl::servoOpen(bool open)
  */
 void SafeControl::update()
 {
+    PROFILE("update");
+
+    // write back changed tuning values
+    config.service();
+
+    // the watchdog is fed only while every task is on time
+    supervisor.service();
+
+    // send the next servo pulse when it is due
+    if (servoMoving && servoMove() == CO_DONE)
+    {
+        servoMoving = false;
+    }
+
+    supervisor.start(TASK_KEYPAD);
+
     // get key press
-    char key = keypad.getKey();
+    char key = keypad.getKey(config.values().debounceDelay);
+    supervisor.checkIn(TASK_KEYPAD);
+
+    if (continuousEntry)
+    {
+        updateContinuous(key);
+        return;
+    }
 
     // check if key is pressed and append to code if it is not a special key
     if (key != '\0' && key != '*' && key != '#')
     {
         // append key to code
-        enteredCode += key;
+        enteredCode = (enteredCode << 4) | symbolIndex(key);
+        ++enteredLength;
 
-        if (enteredCode.length() > codeLength)
+        if (enteredLength > codeLength)
         {
-            lastState = state;    // save last state
+            // a key in the same update as a rejected '*' or '#' must not make
+            // INVALID_CODE the state to go back to, or the safe never leaves it
+            if (state != INVALID_CODE)
+            {
+                lastState = state; // save last state
+            }
             state = INVALID_CODE; // switch state to invalid code
         }
     }
@@ -88,15 +272,7 @@ void SafeControl::update()
         {
             if (checkCombination())
             {
-                // switch state to close safe
-                state = CLOSED;
-                servoOpen(false);
-
-                // set LED to HIGH
-                PORTB |= (1 << ledPin);
-
-                // reset code
-                enteredCode = "";
+                closeSafe();
             }
             else
             {
@@ -106,9 +282,19 @@ void SafeControl::update()
         }
         else if (key == '*')
         {
-            // set to invalid code state
-            lastState = state;
-            state = INVALID_CODE;
+            if (checkCombination() && lastUser == OWNER_USER)
+            {
+                // owner code followed by '*' starts a code change
+                state = SET_CODE;
+                enteredCode = 0;
+                enteredLength = 0;
+            }
+            else
+            {
+                // set to invalid code state
+                lastState = state;
+                state = INVALID_CODE;
+            }
         }
 
         break;
@@ -117,15 +303,7 @@ void SafeControl::update()
         {
             if (checkCombination())
             {
-                // switch state to open safe
-                state = OPEN;
-                servoOpen(true);
-
-                // set LED to LOW
-                PORTB &= ~(1 << ledPin);
-
-                // reset code
-                enteredCode = "";
+                openSafe();
             }
             else
             {
@@ -142,13 +320,38 @@ void SafeControl::update()
         break;
     case INVALID_CODE:
         // reset code
-        enteredCode = "";
+        enteredCode = 0;
+        enteredLength = 0;
 
         // switch state to last state
         state = lastState;
         break;
-    case SET_CODE:
-        // TODO: implement combination update code with EEPROM storage
+    case SET_CODE: // safe is open, owner is typing a new code
+        if (key == '#')
+        {
+            // the new code must be complete and not belong to another user;
+            // looked up directly so lastUser stays the owner who started this
+            uint8_t user = codes.lookup(enteredCode);
+            if (enteredLength == codeLength && (user == NO_USER || user == OWNER_USER))
+            {
+                store.save(enteredCode);
+
+                state = OPEN;
+                enteredCode = 0;
+                enteredLength = 0;
+            }
+            else
+            {
+                lastState = OPEN;
+                state = INVALID_CODE;
+            }
+        }
+        else if (key == '*')
+        {
+            // cancel code change
+            lastState = OPEN;
+            state = INVALID_CODE;
+        }
         break;
     default:
         break;
@@ -164,8 +367,86 @@ void SafeControl::update()
  */
 void SafeControl::init()
 {
+    // a keypad scan takes well under a millisecond and a servo move 2 s
+    supervisor.addTask(TASK_KEYPAD, NO_PERIOD, 5);
+    supervisor.addTask(TASK_SERVO, NO_PERIOD, 2500);
+    supervisor.begin(WDTO_500MS);
+
+    // load tuning values and the newest owner code from EEPROM
+    config.begin();
+    store.begin();
+
+    // after a watchdog or brown-out reset the servo is already in place, so
+    // only the LED is set, unless the reset cut a move short
+    if (warmState.restore() && (warmState.data.state == OPEN || warmState.data.state == CLOSED))
+    {
+        state = (State)warmState.data.state;
+        lastUser = warmState.data.lastUser;
+        servoTarget = state == OPEN;
+
+        if (state == OPEN)
+        {
+            Led::clear();
+        }
+        else
+        {
+            Led::set();
+        }
+
+        if (warmState.data.moving)
+        {
+            servoOpen(state == OPEN);
+        }
+        return;
+    }
+
+    // only a power-on or reset button start opens the safe. Any other cold
+    // start may be a watchdog reset of a closed safe whose cause could not be
+    // read (see warm_restart.hpp), so it locks instead
+    if (!(resetFlags() & ((1 << PORF) | (1 << EXTRF))))
+    {
+        state = CLOSED;
+        lastState = CLOSED;
+        servoOpen(false);
+
+        // set LED to HIGH
+        Led::set();
+        return;
+    }
+
     servoOpen(true);
 
     // set LED to LOW
-    PORTB &= ~(1 << ledPin);
+    Led::clear();
+}
+
+/**
+ * @brief Get the user slot of the code that last opened or closed the safe
+ * 
+ * @return uint8_t user slot, or NO_USER
+ */
+uint8_t SafeControl::getLastUser() const
+{
+    return lastUser;
+}
+
+/**
+ * @brief Get the number of times a user has opened or closed the safe
+ * 
+ * @param user 
+ * @return uint16_t 
+ */
+uint16_t SafeControl::getAuditCount(uint8_t user) const
+{
+    return codes.auditCount(user);
+}
+
+/**
+ * @brief Get the task blamed for the watchdog reset that restarted the safe
+ * 
+ * @return uint8_t SafeTask, or NO_TASK
+ */
+uint8_t SafeControl::getLastFailure() const
+{
+    return supervisor.lastFailure();
 }
\ No newline at end of file
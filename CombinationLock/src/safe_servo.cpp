@@ -0,0 +1,51 @@
+/**
+ * @file safe_servo.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief The servo moves of SafeControl. Kept apart from the state machine so
+ * tools/safe_fuzz can link a stand-in that only records the moves.
+ */
+#include "safe_control.hpp"
+
+/**
+ * @brief Start moving the servo to the open or closed position. update()
+ * sends the pulses, so the keypad keeps working during the move.
+ * 
+ * @param open 
+ */
+void SafeControl::servoOpen(bool open)
+{
+    servoTarget = open;
+    servoMoving = true;
+    servo.reset();
+
+    supervisor.start(TASK_SERVO);
+    saveWarmState(true);
+}
+
+/**
+ * @brief Send the pulses of a servo move, one per time frame. Only the pulse
+ * itself is timed with a delay; the rest of the frame is awaited.
+ * 
+ * @return CoStatus CO_DONE when the move is finished
+ */
+CoStatus SafeControl::servoMove()
+{
+    CO_BEGIN(servo);
+
+    for (servoPulses = 0; servoPulses < freq; ++servoPulses)
+    {
+        // set SERVO_PIN high
+        Servo::set();
+        // delay for pulseWidth
+        delayMicroseconds(servoTarget ? config.values().pulseMax : config.values().pulseMin);
+        // set SERVO_PIN low
+        Servo::clear();
+        // wait 20 ms to complete servo cycle
+        CO_AWAIT_TICKS(servo, timeFrame / 1000);
+    }
+
+    supervisor.checkIn(TASK_SERVO);
+    saveWarmState(false);
+
+    CO_END(servo);
+}
@@ -0,0 +1,19 @@
+/**
+ * @file log_events.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Binary log event ids and their formats for tools/binlog_decode.py
+ */
+#ifndef LOG_EVENTS_HPP
+#define LOG_EVENTS_HPP
+
+#include <Arduino.h>
+
+// id 0 is BINLOG_DROPPED; the decoder reads the format after each id
+enum LogEvent : uint8_t
+{
+    EVT_PRESSED = 1,  // "Switch pressed. %u high-to-low transitions occurred in %u uS."
+    EVT_RELEASED = 2, // "Switch released. %u low-to-high transitions occurred in %u uS."
+    EVT_EDGE = 3,     // "Switch edge, level %u", BOUNCE_EDGE_TRACE builds only
+};
+
+#endif // LOG_EVENTS_HPP
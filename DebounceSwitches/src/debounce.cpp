@@ -1,4 +1,6 @@
 #include "debounce.hpp"
+#include "bin_log.hpp"
+#include "log_events.hpp"
 
 Debounce::Debounce(uint8_t ledPin, uint8_t switchPin) : ledPin(ledPin), switchPin(switchPin)
 {
@@ -133,24 +135,16 @@ void Debounce::time()
         // if the switch is pressed
         if (this->switchPinState == 1)
         {
-            // print the number of bounces and the time since the last bounce
-            Serial.print("Switch pressed. ");
-            Serial.print(this->bounceCount);
-            Serial.print(" high-to-low transitions occurred in ");
-            Serial.print(micros() - this->lastBounceTime);
-            Serial.println(" uS.");
+            // log the number of bounces and the time since the last bounce
+            binlog.log(EVT_PRESSED, this->bounceCount, micros() - this->lastBounceTime);
             // reset the bounce count
             this->bounceCount = 0;
         }
         // if the switch is not pressed
         else
         {
-            // print the number of bounces and the time since the last bounce
-            Serial.print("Switch released. ");
-            Serial.print(this->bounceCount);
-            Serial.print(" low-to-high transitions occurred in ");
-            Serial.print(micros() - this->lastBounceTime);
-            Serial.println(" uS.");
+            // log the number of bounces and the time since the last bounce
+            binlog.log(EVT_RELEASED, this->bounceCount, micros() - this->lastBounceTime);
             // reset the bounce count
             this->bounceCount = 0;
         }
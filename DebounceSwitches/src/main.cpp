@@ -13,6 +13,14 @@
  * What is the highest number of bounces that occur when released? 9
  * What type of variables (e.g. global, static, local, class) should be used to hold state variables like timestamps? Why? 
  *    Global variables should be used to hold state variables like timestamps because they are accessible from anywhere in the program.
+ *
+ * Reports go out as binary log records at BINLOG_BAUD so printing does not
+ * stretch the bounce timing. Read them with
+ *     python tools/binlog_decode.py --events DebounceSwitches/include/log_events.hpp <port>
+ * Only the debounced presses and releases are logged. Built with
+ * -D BOUNCE_EDGE_TRACE (pio run -e edge_trace) every edge the loop sees is
+ * logged too, so a decoded capture is a bounce trace that tools/bounce_replay
+ * can replay through the debouncers.
 
  * @date 2023-10-08
  *
@@ -21,24 +29,62 @@
  */
 
 #include <Arduino.h>
+#include "config_store.hpp"
+#include "bin_log.hpp"
+#include "log_events.hpp"
+#include "gpio.hpp"
+#include "loop_monitor.hpp"
+#include "stack_paint.hpp"
 
-const byte buttonPin = 3;                   // PORTB pin 3
+using Button = Pin<PortB, PB3>;             // D11
 volatile byte lastButtonState = HIGH;       // Last state of the button
 volatile unsigned long bounceStartTime = 0; // Timestamp when bouncing starts
 volatile unsigned int bounceCount = 0;      // Number of bounces
 volatile bool bouncing = false;             // Flag to indicate if the button is bouncing
 
+/**
+ * @brief Tuning values kept in EEPROM. Set over serial with "c <key> <value>".
+ *
+ */
+struct Config
+{
+    unsigned long settleTime; // longest expected bounce in uS
+};
+
+const ConfigField configFields[] PROGMEM = {
+    CONFIG_FIELD(Config, settleTime), // key 0
+};
+
+ConfigStore<Config> config({5000}, 1, configFields);
+
+/**
+ * @brief Handle the "l" serial command: print the loop period histogram, and
+ * "m": print the SRAM high-water marks
+ *
+ * @param line command line
+ * @param serial
+ */
+void printStats(const char *line, Stream &serial)
+{
+    loopMonitor.command(line, serial);
+    stackPaint.command(line, serial);
+}
+
 void setup()
 {
-    DDRB &= ~(1 << buttonPin); // Set buttonPin as input
-    PORTB |= (1 << buttonPin); // Enable pull-up resistor
-    Serial.begin(9600);        // Initialize serial communication
+    config.begin();             // Load tuning values from EEPROM
+    Button::pullUp();          // Set the button as input with pull-up
+    binlog.begin();            // Initialize the binary logger on the UART
+    loopMonitor.begin(200);    // A bounce shorter than a loop() is missed
+    stackPaint.begin(STACK_RESET_MARGIN);
 }
 
 void loop()
 {
-    // Read the current state of the button
-    byte currentButtonState = PINB & (1 << buttonPin);
+    loopMonitor.tick();
+
+    // Read the current state of the button as HIGH or LOW
+    byte currentButtonState = Button::read() ? HIGH : LOW;
 
     // If the button is pressed and not bouncing and the button state has changed
     if (!bouncing && currentButtonState != lastButtonState)
@@ -53,27 +99,30 @@ void loop()
     {
         bounceCount++;
         lastButtonState = currentButtonState;
+#ifdef BOUNCE_EDGE_TRACE
+        binlog.log(EVT_EDGE, currentButtonState); // raw edge for tools/bounce_replay
+#endif
     }
 
-    // If the button is bouncing and the button state has not changed for 5ms
-    if (bouncing && (micros() - bounceStartTime) > 5000)
-    { // Assuming 5ms as a max bounce time
+    // If the button is bouncing and the button state has not changed for the settle time
+    if (bouncing && (micros() - bounceStartTime) > config.values().settleTime)
+    { // Assuming settleTime (5ms by default) as a max bounce time
         bouncing = false;
         if (lastButtonState == LOW)
         {
-            Serial.print("Switch pressed. ");
-            Serial.print(bounceCount / 2); // Only high-to-low transitions
-            Serial.print(" high-to-low transitions occurred in ");
-            Serial.print(micros() - bounceStartTime);
-            Serial.println(" uS.");
+            binlog.log(EVT_PRESSED, bounceCount / 2, micros() - bounceStartTime); // Only high-to-low transitions
         }
         else
         {
-            Serial.print("Switch released. ");
-            Serial.print(bounceCount / 2); // Only low-to-high transitions
-            Serial.print(" low-to-high transitions occurred in ");
-            Serial.print(micros() - bounceStartTime);
-            Serial.println(" uS.");
+            binlog.log(EVT_RELEASED, bounceCount / 2, micros() - bounceStartTime); // Only low-to-high transitions
         }
     }
+
+    // Retune, write back and scan the SRAM only while the switch is quiet
+    if (!bouncing)
+    {
+        config.poll(binlog, printStats);
+        config.service();
+        stackPaint.scan();
+    }
 }
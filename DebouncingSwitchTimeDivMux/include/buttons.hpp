@@ -0,0 +1,28 @@
+/**
+ * @file buttons.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Debouncing of the increment and decrement buttons
+ */
+#ifndef BUTTONS_HPP
+#define BUTTONS_HPP
+
+#include <Arduino.h>
+#include "gpio.hpp"
+
+// type aliases
+using TickType = unsigned long;
+
+// enum SwitchState
+enum SwitchState
+{
+    NONE_PRESSED,
+    INCREMENT_PRESSED,
+    DECREMENT_PRESSED,
+};
+
+using ButtonIncrement = Pin<PortB, PB3>;
+using ButtonDecrement = Pin<PortB, PB2>;
+
+SwitchState debounceButton(TickType debounceDelay);
+
+#endif // BUTTONS_HPP
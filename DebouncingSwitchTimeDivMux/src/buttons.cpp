@@ -0,0 +1,67 @@
+/**
+ * @file buttons.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Definition of the button debouncing
+ */
+#include "buttons.hpp"
+
+// only buttonTask() calls debounceButton(), from loop(), so none of these is
+// shared with an interrupt
+static byte LastIncrementButtonState = HIGH; // the previous reading from the input pin
+static byte LastDecrementButtonState = HIGH; // the previous reading from the input pin
+static byte IncrementButtonState = HIGH; // the current reading from the input pin
+static byte DecrementButtonState = HIGH; // the current reading from the input pin
+static TickType LastIncrementDebounceTime = 0; // the last time the output pin was toggled
+static TickType LastDecrementDebounceTime = 0; // the last time the output pin was toggled
+
+// function to debounce button press and release events for a given pin saving the last state of each button
+SwitchState debounceButton(TickType debounceDelay)
+{
+    // read value of PORTB[2:3] into variable
+    byte incrementState = ButtonIncrement::read();
+    byte decrementState = ButtonDecrement::read();
+
+    // check if the state of the button has changed since last read
+    if (incrementState != LastIncrementButtonState)
+    {
+        LastIncrementDebounceTime = micros();
+    }
+
+    // check if the state of the button has changed since last read
+    if (decrementState != LastDecrementButtonState)
+    {
+        LastDecrementDebounceTime = micros();
+    }
+
+    // if the increment button state has been stable for longer than the debounce delay then return INCREMENT_PRESSED
+    if ((micros() - LastIncrementDebounceTime) > debounceDelay)
+    {
+        if (incrementState != IncrementButtonState)
+        {
+            IncrementButtonState = incrementState; // update last button state
+            if (IncrementButtonState == LOW)
+            {
+                return INCREMENT_PRESSED;
+            }
+        }
+    }
+
+    // if the decrement button state has been stable for longer than the debounce delay then return DECREMENT_PRESSED
+    if ((micros() - LastDecrementDebounceTime) > debounceDelay)
+    {
+        if (decrementState != DecrementButtonState)
+        {
+            DecrementButtonState = decrementState; // update last button state
+            if (DecrementButtonState == LOW)
+            {
+                return DECREMENT_PRESSED;
+            }
+        }
+    }
+
+    // update last button states
+    LastIncrementButtonState = incrementState;
+    LastDecrementButtonState = decrementState;
+
+    return NONE_PRESSED; // no button pressed
+}
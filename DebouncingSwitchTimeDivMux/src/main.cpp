@@ -8,57 +8,119 @@
  *     It seems to be around 1200 uS. At 1100 uS it is noticeable but not too bad.
  */
 #include <Arduino.h>
-
-// type aliases
-using TickType = unsigned long;
-
-// enum SwitchState
-enum SwitchState
+#include "config_store.hpp"
+#include "warm_restart.hpp"
+#include "task_supervisor.hpp"
+#include "scheduler.hpp"
+#include "gpio.hpp"
+#include "buttons.hpp"
+#include "loop_monitor.hpp"
+#include "stack_paint.hpp"
+
+// supervised tasks
+enum Task
 {
-    NONE_PRESSED,
-    INCREMENT_PRESSED,
-    DECREMENT_PRESSED,
+    TASK_BUTTONS, // button debouncing and counting
+    TASK_DISPLAY, // one multiplexed frame of both digits
 };
 
 // Define pins and constants
-const byte buttonIncrementPin = 3;    // PORTB[3]
-const byte buttonDecrementPin = 2;    // PORTB[2]
 const TickType debounceDelay = 50000; // the debounce time
-const byte displayOnesPin = 0;    // DDRB[0]
-const byte displayTensPin = 1;    // DDRB[1]
-const TickType TickDelay = 10000; // 1/1000 second
+using DisplayOnes = Pin<PortB, PB0>; // common cathode, on while an output
+using DisplayTens = Pin<PortB, PB1>;
+using Segments = PinGroup<PortD, PD0, PD1, PD2, PD3, PD4, PD5, PD6, PD7>;
+const TickType TickDelay = 10000; // uS per digit, whole milliseconds
+
+// tuning values kept in EEPROM, the constants above are the defaults
+struct Config
+{
+    TickType debounceDelay;
+    TickType tickDelay;
+};
+
+const ConfigField configFields[] PROGMEM = {
+    CONFIG_FIELD(Config, debounceDelay), // key 0
+    CONFIG_FIELD(Config, tickDelay),     // key 1
+};
+
+ConfigStore<Config> config({debounceDelay, TickDelay}, 1, configFields);
 
 // TODO: refactor to remove global variables
-// Global variables
-volatile byte LastIncrementButtonState = HIGH; // the previous reading from the input pin
-volatile byte LastDecrementButtonState = HIGH; // the previous reading from the input pin
-volatile byte IncrementButtonState = HIGH; // the current reading from the input pin
-volatile byte DecrementButtonState = HIGH; // the current reading from the input pin
-volatile TickType LastIncrementDebounceTime = 0; // the last time the output pin was toggled
-volatile TickType LastDecrementDebounceTime = 0; // the last time the output pin was toggled
-volatile long count = 0; // count of button presses
+// Global variables, only used by the tasks, which all run from loop(), so
+// none of them is shared with an interrupt
+long count = 0; // count of button presses
+
+// count kept across a watchdog or brown-out reset
+WarmState<long> warmCount WARM_NOINIT;
+
+// feeds the watchdog only while every task is on time
+TaskSupervisor supervisor;
 
 // function prototypes
-SwitchState debounceButton();
-void delayMicros(TickType durationMicros);
-void displayDigit(byte digit, byte upPin, byte downPin);
+void displayDigit(byte digit, bool tens);
+void buttonTask();
+void displayTask();
 
 void setup()
 {
+    // load tuning values from EEPROM
+    config.begin();
+
+    // after a watchdog or brown-out reset, keep counting from where it was
+    if (warmCount.restore())
+    {
+        count = warmCount.data;
+    }
+
     // clear PORTB[0:1]
-    PORTB &= ~((1 << displayOnesPin) | (1 << displayTensPin));
+    DisplayOnes::clear();
+    DisplayTens::clear();
 
     // set PORTB[2:3] as input
-    DDRB &= ~((1 << buttonIncrementPin) | (1 << buttonDecrementPin));
+    ButtonIncrement::input();
+    ButtonDecrement::input();
 
     // set PORTD as output
-    DDRD = 0b11111111;
+    Segments::output();
+
+    // buttons every tick, one digit per tick delay (at least one tick)
+    scheduler.addTask(buttonTask, 1);
+    scheduler.addTask(displayTask, config.values().tickDelay / 1000);
+    scheduler.begin();
+
+    supervisor.addTask(TASK_BUTTONS, 100, 2);
+    supervisor.addTask(TASK_DISPLAY, 100, 2);
+    supervisor.begin(WDTO_250MS);
+
+    // loop() idles until each 1 ms tick, a longer gap is a late tick
+    loopMonitor.begin(1500);
+
+    stackPaint.begin(STACK_RESET_MARGIN);
 }
 
 void loop()
 {
-    // monitor switches for button presses and increment or decrement count
-    SwitchState switchChoice = debounceButton();
+    loopMonitor.tick();
+    stackPaint.scan();
+
+    // the watchdog is fed only while every task is on time
+    supervisor.service();
+
+    // run the tasks that are due, idle until the next tick otherwise
+    scheduler.run();
+
+    // write back changed tuning values
+    config.service();
+
+    loopMonitor.report();
+    stackPaint.report();
+}
+
+// task to monitor switches for button presses and increment or decrement count
+void buttonTask()
+{
+    supervisor.start(TASK_BUTTONS);
+    SwitchState switchChoice = debounceButton(config.values().debounceDelay);
 
     // increment or decrement count based on state
     switch (switchChoice)
@@ -86,79 +148,27 @@ void loop()
         count = 99;
     }
 
-    // time division multiplexing
-    // display tens digit
-    displayDigit(count / 10, displayTensPin, displayOnesPin);
-    delayMicros(TickDelay);
-    // display ones digit
-    displayDigit(count % 10, displayOnesPin, displayTensPin);
-    delayMicros(TickDelay);
-}
-
-// function to debounce button press and release events for a given pin saving the last state of each button
-SwitchState debounceButton()
-{
-    // read value of PORTB[2:3] into variable
-    byte incrementState = PINB & (1 << buttonIncrementPin);
-    byte decrementState = PINB & (1 << buttonDecrementPin);
-
-    // check if the state of the button has changed since last read
-    if (incrementState != LastIncrementButtonState)
-    {
-        LastIncrementDebounceTime = micros();
-    }
-
-    // check if the state of the button has changed since last read
-    if (decrementState != LastDecrementButtonState)
-    {
-        LastDecrementDebounceTime = micros();
-    }
-
-    // if the increment button state has been stable for longer than the debounce delay then return INCREMENT_PRESSED
-    if ((micros() - LastIncrementDebounceTime) > debounceDelay)
-    {
-        if (incrementState != IncrementButtonState)
-        {
-            IncrementButtonState = incrementState; // update last button state
-            if (IncrementButtonState == LOW)
-            {
-                return INCREMENT_PRESSED;
-            }
-        }
-    }
-
-    // if the decrement button state has been stable for longer than the debounce delay then return DECREMENT_PRESSED
-    if ((micros() - LastDecrementDebounceTime) > debounceDelay)
+    if (switchChoice != NONE_PRESSED)
     {
-        if (decrementState != DecrementButtonState)
-        {
-            DecrementButtonState = decrementState; // update last button state
-            if (DecrementButtonState == LOW)
-            {
-                return DECREMENT_PRESSED;
-            }
-        }
+        warmCount.data = count;
+        warmCount.save();
     }
-
-    // update last button states
-    LastIncrementButtonState = incrementState;
-    LastDecrementButtonState = decrementState;
-
-    return NONE_PRESSED; // no button pressed
+    supervisor.checkIn(TASK_BUTTONS);
 }
 
-// function to delay for a specified number of microseconds
-void delayMicros(TickType durationMicros)
+// task for time division multiplexing, shows the other digit on each run
+void displayTask()
 {
-    volatile TickType start = micros();
-    while (micros() - start < durationMicros)
-    {
-        // do nothing
-    }
+    static bool tens = false;
+
+    supervisor.start(TASK_DISPLAY);
+    tens = !tens;
+    displayDigit(tens ? count / 10 : count % 10, tens);
+    supervisor.checkIn(TASK_DISPLAY);
 }
 
 // function to display a digit on the 7-segment display
-void displayDigit(byte digit, byte upPin, byte downPin)
+void displayDigit(byte digit, bool tens)
 {
     // decimal font table
     static uint8_t fontTable[] = {
@@ -174,12 +184,18 @@ void displayDigit(byte digit, byte upPin, byte downPin)
         0b01101111, // 9
     };
 
-    // turn off downPin
-    DDRB &= ~(1 << downPin);
-
-    // turn on upPin
-    DDRB |= (1 << upPin);
+    // turn off the other digit, then turn on this one
+    if (tens)
+    {
+        DisplayOnes::input();
+        DisplayTens::output();
+    }
+    else
+    {
+        DisplayTens::input();
+        DisplayOnes::output();
+    }
 
-    // set upPin digit to digit for display
-    PORTD = fontTable[digit];
+    // set the digit for display
+    Segments::write(fontTable[digit]);
 }
\ No newline at end of file
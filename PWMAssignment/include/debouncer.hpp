@@ -2,6 +2,7 @@
 #define DEBOUNCER_HPP
 
 #include <Arduino.h>
+#include "gpio.hpp"
 
 using TickType = unsigned long;
 
@@ -10,10 +11,11 @@ const TickType debounceDelay = 1000; // the debounce time
 /**
  * @brief Class for debouncing a digital input
  * 
+ * @tparam PIN Pin type of the switch
  */
+template <typename PIN>
 class Debouncer {
     private:
-        uint8_t btnPin; // pin number of button
         uint8_t state; // current state of button
         uint8_t lastState; // previous state of button
         TickType lastDebounceTime; // last time button state changed
@@ -23,31 +25,31 @@ class Debouncer {
          * @brief perform some setup
          * 
          */
-        void begin(uint8_t btn)
+        void begin()
         {
-            btnPin = btn;
             state = HIGH;
             lastState = HIGH;
             // set pin to input
-            DDRC &= ~(1 << btnPin);
+            PIN::input();
         }
 
         /**
          * @brief debounce switch input signal and return true if pressed
          * 
+         * @param delay time the input must be stable, in microseconds
          * @return true 
          * @return false 
          */
-        bool debounce()
+        bool debounce(TickType delay = debounceDelay)
         {
-            uint8_t tempState = PINC & (1 << btnPin); // read input pin
+            uint8_t tempState = PIN::isHigh(); // read input pin
 
             if (tempState != lastState)
             {
                 lastDebounceTime = micros();
             }
 
-            if ((micros() - lastDebounceTime) > debounceDelay)
+            if ((micros() - lastDebounceTime) > delay)
             {
                 if (tempState != state)
                 {
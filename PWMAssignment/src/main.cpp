@@ -68,6 +68,12 @@
  */
 // #include <Arduino.h>
 #include "debouncer.hpp"
+#include "config_store.hpp"
+#include "warm_restart.hpp"
+#include "task_supervisor.hpp"
+#include "gpio.hpp"
+#include "loop_monitor.hpp"
+#include "stack_paint.hpp"
 
 // Types
 typedef enum MotorDirection_t
@@ -89,6 +95,17 @@ typedef enum MotorSpeed_t
     MOTOR_SPEED_100,
 } MotorSpeed_t;
 
+/**
+ * @brief Supervised tasks
+ * 
+ */
+typedef enum Task_t
+{
+    TASK_SERIAL,   // serial commands and EEPROM write back
+    TASK_SWITCHES, // switch debouncing
+    TASK_PWM,      // one PWM pulse
+} Task_t;
+
 /**
  * @brief Switch states
  * 
@@ -115,6 +132,22 @@ typedef enum SwitchState_t
 #define INPUT_2_PIN PB1
 #define MAX_DUTY_CYCLE 255
 
+// Pins
+using Switch1 = Pin<PortC, SWITCH_1_PIN>;
+using Switch2 = Pin<PortC, SWITCH_2_PIN>;
+using BarGraph = PinGroup<PortC, LED_1_PIN, LED_2_PIN, LED_3_PIN, LED_4_PIN>;
+using RgbLed = PinGroup<PortD, RGB_RED_PIN, RGB_GREEN_PIN, RGB_BLUE_PIN>;
+using MotorEnable = Pin<PortB, ENABLE_PIN>;
+using MotorInputs = PinGroup<PortB, INPUT_1_PIN, INPUT_2_PIN>;
+
+// bar graph: one LED per speed step
+const uint8_t barGraph[] = {
+    (1 << LED_1_PIN),
+    (1 << LED_1_PIN) | (1 << LED_2_PIN),
+    (1 << LED_1_PIN) | (1 << LED_2_PIN) | (1 << LED_3_PIN),
+    (1 << LED_1_PIN) | (1 << LED_2_PIN) | (1 << LED_3_PIN) | (1 << LED_4_PIN),
+};
+
 // Variables
 MotorDirection_t motorDirection = MOTOR_OFF;
 MotorDirection_t previousMotorDirection = MOTOR_OFF;
@@ -122,78 +155,180 @@ MotorSpeed_t motorSpeed = MOTOR_SPEED_25;
 
 uint8_t dutyCycle = MAX_DUTY_CYCLE * 0.25; // default duty cycle is 25%
 
+/**
+ * @brief Motor state kept across a watchdog or brown-out reset
+ * 
+ */
+struct MotorState
+{
+    MotorDirection_t direction;
+    MotorDirection_t previousDirection;
+    MotorSpeed_t speed;
+};
+
+WarmState<MotorState> warmState WARM_NOINIT;
+
+/**
+ * @brief Tuning values kept in EEPROM. Set over serial with "c <key> <value>".
+ * 
+ */
+struct Config
+{
+    uint8_t duty25;        // duty cycle presets, 0-255
+    uint8_t duty50;
+    uint8_t duty75;
+    uint8_t duty100;
+    TickType debounceDelay; // switch debounce time in microseconds
+};
+
+const ConfigField configFields[] PROGMEM = {
+    CONFIG_FIELD(Config, duty25),        // key 0
+    CONFIG_FIELD(Config, duty50),        // key 1
+    CONFIG_FIELD(Config, duty75),        // key 2
+    CONFIG_FIELD(Config, duty100),       // key 3
+    CONFIG_FIELD(Config, debounceDelay), // key 4
+};
+
+ConfigStore<Config> config({MAX_DUTY_CYCLE / 4, MAX_DUTY_CYCLE / 2, MAX_DUTY_CYCLE * 3 / 4, MAX_DUTY_CYCLE, debounceDelay}, 1, configFields);
+
 // Function Prototypes
 void pwm(uint8_t duty);
 void delayMicros(unsigned long delay);
 void setMotorSpeed();
 void setMotorDirection();
 void setDutyCycle();
+void restoreOutputs();
+void saveWarmState();
+void printTaskTimes(const char *line, Stream &serial);
 
 // Switch debouncers
-Debouncer switch1;
-Debouncer switch2;
+Debouncer<Switch1> switch1;
+Debouncer<Switch2> switch2;
+
+// feeds the watchdog only while every task is on time
+TaskSupervisor supervisor;
 
 void setup()
 {
-    switch1.begin(SWITCH_1_PIN); // initialize switch 1
-    switch2.begin(SWITCH_2_PIN); // initialize switch 2
+    // load tuning values from EEPROM
+    config.begin();
+
+    // after a watchdog or brown-out reset, carry on with the motor as it was
+    bool warm = warmState.restore();
+    if (warm)
+    {
+        motorDirection = warmState.data.direction;
+        previousMotorDirection = warmState.data.previousDirection;
+        motorSpeed = warmState.data.speed;
+    }
+
+    setDutyCycle();
+    Serial.begin(9600);
+
+    // a serial command may wait on the 64 byte TX buffer at 9600 baud
+    supervisor.addTask(TASK_SERIAL, 100, 100);
+    supervisor.addTask(TASK_SWITCHES, 10, 2);
+    supervisor.addTask(TASK_PWM, 10, 2);
+    supervisor.begin(WDTO_250MS);
+
+    // one loop() is one PWM frame: the pulse, up to 255 us, and the polling
+    loopMonitor.begin(1000);
+
+    stackPaint.begin(STACK_RESET_MARGIN);
+
+    if (supervisor.lastFailure() != NO_TASK)
+    {
+        Serial.print("Watchdog reset by task ");
+        Serial.println(supervisor.lastFailure());
+    }
+    if (stackPaint.lowMemoryReset())
+    {
+        Serial.println("Reset for low SRAM");
+    }
+
+    switch1.begin(); // initialize switch 1
+    switch2.begin(); // initialize switch 2
 
     // Set LED 1, 2, 3, 4 as outputs
-    DDRC |= (1 << LED_1_PIN) | (1 << LED_2_PIN) | (1 << LED_3_PIN) | (1 << LED_4_PIN); // 0b00000001 | 0b00000010 | 0b00000100 | 0b00001000 = 0b00001111
+    BarGraph::output(); // 0b00001111
 
     // Set RGB LED as outputs
-    DDRD |= (1 << RGB_RED_PIN) | (1 << RGB_GREEN_PIN) | (1 << RGB_BLUE_PIN); // 0b00000100 | 0b00010000 | 0b10000000 = 0b10010100
+    RgbLed::output(); // 0b10010100
 
     // Set H-Bridge as outputs
-    DDRB |= (1 << ENABLE_PIN) | (1 << INPUT_1_PIN) | (1 << INPUT_2_PIN); // 0b00001000 | 0b00000010 | 0b00000001 = 0b00001011
+    MotorEnable::output();
+    MotorInputs::output(); // 0b00001110
 
-    // Set initial state of LED 1, 2, 3, 4 to off
-    PORTC &= ~((1 << LED_1_PIN) | (1 << LED_2_PIN) | (1 << LED_3_PIN) | (1 << LED_4_PIN)); // 0b00000001 | 0b00000010 | 0b00000100 | 0b00001000 = 0b00001111: ~0b00001111 = 0b11110000
+    if (warm)
+    {
+        restoreOutputs();
+        return;
+    }
 
-    // Set initial state of RGB LED to off
-    PORTD &= ~((1 << RGB_RED_PIN) | (1 << RGB_GREEN_PIN) | (1 << RGB_BLUE_PIN)); // 0b00000100 | 0b00010000 | 0b10000000 = 0b10010100: ~0b10010100 = 0b01101011
+    // Set initial state of RGB LED, and so the motor direction, to off
+    RgbLed::clear();
 
     // set initial state of motor to off
-    PORTB &= ~(1 << ENABLE_PIN); // 0b00001000
+    MotorEnable::clear();
 
-    // set initial motor direction to off
-    PORTD &= ~((1 << RGB_RED_PIN) | (1 << RGB_GREEN_PIN) | (1 << RGB_BLUE_PIN)); // 0b00000100 | 0b00010000 | 0b10000000 = 0b10010100: ~0b10010100 = 0b01101011
+    // set initial state of LED 1 to on and LED 2, 3, 4 off
+    BarGraph::write(barGraph[MOTOR_SPEED_25]);
 
-    // set initial state of LED 1 to on
-    PORTC |= (1 << LED_1_PIN); // 0b00000001 = 0b00000001
+    saveWarmState();
 }
 
 void loop()
 {
+    loopMonitor.tick();
+    stackPaint.scan();
+
+    // the watchdog is fed only while every task is on time
+    supervisor.service();
+
+    // retune from serial and write back changed values
+    supervisor.start(TASK_SERIAL);
+    if (config.poll(Serial, printTaskTimes))
+    {
+        setDutyCycle();
+    }
+    config.service();
+    supervisor.checkIn(TASK_SERIAL);
+
     // switch 1: motor direction
-    if (switch1.debounce())
+    supervisor.start(TASK_SWITCHES);
+    if (switch1.debounce(config.values().debounceDelay))
     {
         // motor direction: forward -> off -> reverse -> off -> forward -> off
         setMotorDirection();
+        saveWarmState();
     }
 
     // switch 2: motor speed
-    if (switch2.debounce())
+    if (switch2.debounce(config.values().debounceDelay))
     {
         // motor speed: 25% -> 50% -> 75% -> 100%
         setMotorSpeed();
+        saveWarmState();
     }
+    supervisor.checkIn(TASK_SWITCHES);
 
     // PWM
+    supervisor.start(TASK_PWM);
     switch (motorDirection)
     {
     case MOTOR_FORWARD: // intentional fall-through
     case MOTOR_REVERSE:
-        PORTB |= (1 << ENABLE_PIN);
+        MotorEnable::set();
         delayMicros(dutyCycle);
-        PORTB &= ~(1 << ENABLE_PIN);
+        MotorEnable::clear();
         break;
     case MOTOR_OFF:
-        PORTB &= ~(1 << ENABLE_PIN);
+        MotorEnable::clear();
         break;
     default:
         break;
     }
+    supervisor.checkIn(TASK_PWM);
 }
 
 /**
@@ -216,38 +351,11 @@ void delayMicros(unsigned long delay)
  */
 void setMotorSpeed()
 {
-    switch (motorSpeed)
-    {
-    case MOTOR_SPEED_25:
-        motorSpeed = MOTOR_SPEED_50;
-        // set LED 1,2 on and 3,4 off
-        PORTC |= (1 << LED_1_PIN) | (1 << LED_2_PIN);
-        PORTC &= ~((1 << LED_3_PIN) | (1 << LED_4_PIN));
-        break;
+    // motor speed: 25% -> 50% -> 75% -> 100% -> 25%
+    motorSpeed = (MotorSpeed_t)((motorSpeed + 1) % (MOTOR_SPEED_100 + 1));
 
-    case MOTOR_SPEED_50:
-        motorSpeed = MOTOR_SPEED_75;
-        // set LED 1, 2, 3 on and 4 off
-        PORTC |= (1 << LED_1_PIN) | (1 << LED_2_PIN) | (1 << LED_3_PIN);
-        PORTC &= ~(1 << LED_4_PIN);
-        break;
-
-    case MOTOR_SPEED_75:
-        motorSpeed = MOTOR_SPEED_100;
-        // set LED 1, 2, 3, 4 on
-        PORTC |= (1 << LED_1_PIN) | (1 << LED_2_PIN) | (1 << LED_3_PIN) | (1 << LED_4_PIN);
-        break;
-
-    case MOTOR_SPEED_100:
-        motorSpeed = MOTOR_SPEED_25;
-        // set LED 1 on and 2, 3, 4 off
-        PORTC |= (1 << LED_1_PIN);
-        PORTC &= ~((1 << LED_2_PIN) | (1 << LED_3_PIN) | (1 << LED_4_PIN));
-        break;
-
-    default:
-        break;
-    }
+    // one LED per speed step
+    BarGraph::write(barGraph[motorSpeed]);
 
     setDutyCycle(); // call function to set duty cycle
 }
@@ -265,19 +373,15 @@ void setMotorDirection()
         {
             motorDirection = MOTOR_REVERSE;
             // set pins to reverse
-            PORTD |= (1 << RGB_RED_PIN);
-            PORTD &= ~((1 << RGB_GREEN_PIN) | (1 << RGB_BLUE_PIN));
-            PORTB |= (1 << INPUT_2_PIN);
-            PORTB &= ~(1 << INPUT_1_PIN);
+            RgbLed::write(1 << RGB_RED_PIN);
+            MotorInputs::write(1 << INPUT_2_PIN);
         }
         else
         {
             motorDirection = MOTOR_FORWARD;
             // set pins to forward
-            PORTD |= (1 << RGB_GREEN_PIN);
-            PORTD &= ~((1 << RGB_RED_PIN) | (1 << RGB_BLUE_PIN));
-            PORTB |= (1 << INPUT_1_PIN);
-            PORTB &= ~(1 << INPUT_2_PIN);
+            RgbLed::write(1 << RGB_GREEN_PIN);
+            MotorInputs::write(1 << INPUT_1_PIN);
         }
         previousMotorDirection = motorDirection;
         break;
@@ -287,7 +391,7 @@ void setMotorDirection()
         previousMotorDirection = motorDirection;
         motorDirection = MOTOR_OFF;
         // set RGB off
-        PORTD &= ~((1 << RGB_RED_PIN) | (1 << RGB_GREEN_PIN) | (1 << RGB_BLUE_PIN));
+        RgbLed::clear();
         break;
 
     default:
@@ -304,22 +408,86 @@ void setDutyCycle()
     switch (motorSpeed)
     {
     case MOTOR_SPEED_25:
-        dutyCycle = MAX_DUTY_CYCLE * 0.25;
+        dutyCycle = config.values().duty25;
         break;
 
     case MOTOR_SPEED_50:
-        dutyCycle = MAX_DUTY_CYCLE * 0.50;
+        dutyCycle = config.values().duty50;
         break;
 
     case MOTOR_SPEED_75:
-        dutyCycle = MAX_DUTY_CYCLE * 0.75;
+        dutyCycle = config.values().duty75;
         break;
 
     case MOTOR_SPEED_100:
-        dutyCycle = MAX_DUTY_CYCLE;
+        dutyCycle = config.values().duty100;
         break;
 
     default:
         break;
     }
 }
+
+/**
+ * @brief Set the LEDs and H-Bridge inputs from the motor state, for a warm restart
+ * 
+ */
+void restoreOutputs()
+{
+    BarGraph::write(barGraph[motorSpeed]);
+    MotorEnable::clear();
+
+    // the H-Bridge inputs keep the last direction while the motor is off
+    if (motorDirection == MOTOR_REVERSE || (motorDirection == MOTOR_OFF && previousMotorDirection == MOTOR_REVERSE))
+    {
+        MotorInputs::write(1 << INPUT_2_PIN);
+    }
+    else if (motorDirection == MOTOR_FORWARD || previousMotorDirection == MOTOR_FORWARD)
+    {
+        MotorInputs::write(1 << INPUT_1_PIN);
+    }
+
+    if (motorDirection == MOTOR_FORWARD)
+    {
+        RgbLed::write(1 << RGB_GREEN_PIN);
+    }
+    else if (motorDirection == MOTOR_REVERSE)
+    {
+        RgbLed::write(1 << RGB_RED_PIN);
+    }
+    else
+    {
+        RgbLed::clear();
+    }
+}
+
+/**
+ * @brief Save the motor state to .noinit RAM for a warm restart
+ * 
+ */
+void saveWarmState()
+{
+    warmState.data.direction = motorDirection;
+    warmState.data.previousDirection = previousMotorDirection;
+    warmState.data.speed = motorSpeed;
+    warmState.save();
+}
+
+/**
+ * @brief Handle the "w" serial command: print the worst case time of each task,
+ * "l": print the loop period histogram, and "m": print the SRAM high-water
+ * marks
+ * 
+ * @param line command line
+ * @param serial 
+ */
+void printTaskTimes(const char *line, Stream &serial)
+{
+    if (line[0] == 'w')
+    {
+        supervisor.print(serial);
+    }
+
+    loopMonitor.command(line, serial);
+    stackPaint.command(line, serial);
+}
@@ -0,0 +1,18 @@
+/**
+ * @file pins.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Display and switch pins of the Vanduino shield
+ */
+#ifndef PINS_HPP
+#define PINS_HPP
+
+#include "gpio.hpp"
+
+using SegmentDp = Pin<PortD, PD7>; // decimal point
+using Sw3 = Pin<PortB, PB3>;
+using Cc1 = Pin<PortB, PB0>;
+using Cc2 = Pin<PortB, PB1>;
+using Segments = PinGroup<PortD, 0, 1, 2, 3, 4, 5, 6, 7>;
+using SegmentBits = PinGroup<PortD, 0, 1, 2, 3, 4, 5, 6>; // segments a-g, no DP
+
+#endif // PINS_HPP
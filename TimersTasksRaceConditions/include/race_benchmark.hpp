@@ -0,0 +1,16 @@
+/**
+ * @file race_benchmark.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Stress test of the DP toggle race, built with -DRACE_BENCHMARK
+ */
+#ifndef RACE_BENCHMARK_HPP
+#define RACE_BENCHMARK_HPP
+
+#include <Arduino.h>
+
+const uint32_t BENCH_TOGGLES = 1000000; // toggles per method and ISR rate
+const unsigned long BENCH_BAUD = 115200;
+
+void runRaceBenchmark();
+
+#endif // RACE_BENCHMARK_HPP
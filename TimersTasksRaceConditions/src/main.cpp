@@ -2,14 +2,36 @@
  * @file main.cpp
  * @author Kevin Wing (wing5640@vandals.uidaho.edu)
  * @brief Timer, Tasks, Race Conditions, and Interrupts
+ *
+ * Built with -DRACE_BENCHMARK (pio run -e race_benchmark) it instead measures
+ * how often dpToggle() loses a Timer1 ISR update, see race_benchmark.cpp.
+ *
+ * Built with -DPROFILE_ENABLE (pio run -e profile) it times the display ISR and
+ * the main loop on Timer1, at its 1 ms tick prescaler, and prints the table at
+ * 115200 baud whenever a byte comes in.
+ *
+ * Built with -DLOOP_MONITOR_REPORT (pio run -e loop_report) it prints the loop
+ * period histogram and the SRAM high-water marks every 5 s, timed on Timer1
+ * since micros() and millis() do not run here. Other builds neither time the
+ * loop nor scan the SRAM, so the race loop runs bare.
  */
 #include <Arduino.h>
-
-// Define pins and masks
-const uint8_t SEGMENT_DP_PIN = PD7; // Assign the appropriate pin number
-const uint8_t SW3_PIN = PB3;        // Assign the appropriate pin number
-const uint8_t CC1 = PB0;
-const uint8_t CC2 = PB1;
+#include "timer_config.hpp"
+#include "pins.hpp"
+#include "profiler.hpp"
+#include "loop_monitor.hpp"
+#include "stack_paint.hpp"
+#ifdef RACE_BENCHMARK
+#include "race_benchmark.hpp"
+#endif
+
+// Timer1 ticks every ms, the counter steps about 3 times a second
+using TickConfig = TimerConfig<1, 1000>;
+const uint16_t COUNT_TICKS = 333; // ticks per counter step
+
+// Timer1 counts whole us, there is no init() so micros() does not run
+static_assert((TickConfig::TOP + 1) % 1000 == 0, "Timer1 period is not a whole number of us");
+volatile unsigned long milliseconds = 0; // Timer1 ticks since start
 
 // 7-segment hexfont
 const uint8_t hexfont[] = {
@@ -36,38 +58,88 @@ void configureTimer1();
 void dpAtomicToggle();
 void dpToggle();
 byte readSw3();
+unsigned long timer1Micros();
 
-// Global variables
-volatile uint8_t counter = 0;
-
+#ifndef RACE_BENCHMARK
 // ISR for Timer 1
 ISR(TIMER1_COMPA_vect) {
+    PROFILE("display ISR");
+
+    // only the ISR uses these, so they need no protection
+    static uint16_t ticks = 0;
+    static uint8_t counter = 0;
+
     // turn off cc2
-    PORTB &= ~(1 << CC1);
+    Cc1::clear();
 
     // Increment the 7-segment display on CC2
-    PORTB &= ~(1 << CC2); // Disable CC2
-    PORTD = hexfont[counter & 0x0F];
-    PORTB |= (1 << CC2);  // Enable CC2
+    Cc2::clear(); // Disable CC2
+    Segments::write(hexfont[counter & 0x0F]);
+    Cc2::set();   // Enable CC2
 
     // turn on cc2
-    PORTB |= (1 << CC1);
+    Cc1::set();
+
+    ++milliseconds;
 
     // Increment the 7-segment display on CC1
-    counter = (counter + 1) & 0x0F; // Increment and wrap around after 0xF
+    if (++ticks >= COUNT_TICKS)
+    {
+        ticks = 0;
+        counter = (counter + 1) & 0x0F; // Increment and wrap around after 0xF
+    }
 }
+#endif
 
 
 int main()
 {
+#ifdef RACE_BENCHMARK
+    runRaceBenchmark();
+#endif
+
     // Initialize ports and pins
-    DDRD = 0b11111111; // Set all PORTD pins as outputs
-    DDRB |= (1 << CC1) | (1 << CC2);
-    DDRB &= ~(1 << SW3_PIN); // Set SW3 pin as input
+    Segments::output(); // Set all PORTD pins as outputs
+    Cc1::output();
+    Cc2::output();
+    Sw3::input(); // Set SW3 pin as input
     configureTimer1();
+    profiler.begin();
+
+    // a switch read, a DP toggle and the tick itself, with room for one
+    // display ISR
+    loopMonitor.begin(50);
+
+    stackPaint.begin(STACK_RESET_MARGIN);
+
+#ifdef PROFILE_ENABLE
+    Serial.begin(115200);
+#endif
 
     while (1)
     {
+        // kept out of the default build, where they would change the timing
+        // of the race this loop demonstrates
+#ifdef LOOP_MONITOR_REPORT
+        loopMonitor.tick(timer1Micros());
+        loopMonitor.report();
+#endif
+#ifdef STACK_PAINT_REPORT
+        stackPaint.scan();
+        stackPaint.report(timer1Micros() / 1000);
+#endif
+
+#ifdef PROFILE_ENABLE
+        if (Serial.available())
+        {
+            Serial.read();
+            profiler.print(Serial);
+            profiler.reset();
+        }
+#endif
+
+        PROFILE("loop");
+
         if (readSw3() == 0)
         {
             dpAtomicToggle(); // Atomically toggle DP
@@ -91,37 +163,58 @@ void configureTimer1()
     TCCR1B = 0;             // Clear control register B
     TCCR1B |= (1 << WGM12); // Configure for CTC mode
 
-    // Set TOP value for Timer1 to 20832: ~1ms
-    OCR1A = 20832;
+    // Set TOP value for Timer1: 1ms
+    OCR1A = TickConfig::TOP;
 
     // Enable Timer1 compare interrupt
     TIMSK1 |= (1 << OCIE1A);
 
-    // Set prescaler to 256 and start the timer
-    TCCR1B |= (1 << CS12);
+    // Set the prescaler and start the timer
+    TCCR1B |= TickConfig::CLOCK_SELECT;
 
     // Re-enable interrupts
     sei();
 }
 
+/**
+ * @brief Microseconds since configureTimer1(), from the tick count and TCNT1
+ *
+ * @return unsigned long
+ */
+unsigned long timer1Micros()
+{
+    uint8_t oldSREG = SREG;
+    cli();
+    unsigned long ms = milliseconds;
+    uint16_t count = TCNT1;
+    // the counter wrapped after cli() and the ISR has not counted it yet
+    if ((TIFR1 & (1 << OCF1A)) && count < TickConfig::TOP / 2)
+    {
+        ++ms;
+    }
+    SREG = oldSREG;
+
+    return ms * 1000 + count / ((TickConfig::TOP + 1) / 1000);
+}
+
 void dpAtomicToggle()
 {
     // writing a 1 to PINx toggles the pin state atomically
-    PIND |= (1 << SEGMENT_DP_PIN); // atomically toggle DP pin
+    SegmentDp::toggle(); // atomically toggle DP pin
 }
 
 void dpToggle()
 {
-    PORTB |= (1 << CC1);
-    // Toggle DP pin
-    PORTD ^= (1 << SEGMENT_DP_PIN); // Toggle DP pin
+    Cc1::set();
+    // Toggle DP pin, a read-modify-write the ISR can interrupt
+    PORTD ^= SegmentDp::MASK; // Toggle DP pin
 
     // turn off cc2
-    PORTB &= ~(1 << CC1);
+    Cc1::clear();
 }
 
 byte readSw3()
 {
     // Read SW3 state and return it
-    return (PIND & (1 << SW3_PIN));
+    return Sw3::read();
 }
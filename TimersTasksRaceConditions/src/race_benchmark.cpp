@@ -0,0 +1,165 @@
+/**
+ * @file race_benchmark.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Measure how often the non-atomic DP toggle loses an ISR update
+ *
+ * Timer1 runs an ISR that writes a new pattern to the segment pins each time
+ * and keeps a shadow copy of it. The main loop toggles DP with dpToggle() or
+ * dpAtomicToggle(), then compares PORTD with the ISR's shadow and its own DP
+ * shadow. dpToggle() reads PORTD, flips DP and writes PORTD back, so an ISR
+ * landing between the read and the write has its pattern overwritten with the
+ * old one; that is counted as a lost update. The atomic toggle writes PIND and
+ * should never lose one.
+ *
+ * Output, one CSV line per ISR rate and method:
+ *     rate_hz,method,toggles,isrs,lost,lost_ppm,dp_errors
+ */
+#ifdef RACE_BENCHMARK
+
+#include "race_benchmark.hpp"
+#include "pins.hpp"
+#include "timer_config.hpp"
+#include "atomic.hpp"
+
+void dpToggle();
+void dpAtomicToggle();
+
+using ToggleFunction = void (*)();
+
+/**
+ * @brief Timer1 settings of one ISR rate
+ */
+struct BenchRate
+{
+    uint32_t hz;
+    uint8_t clockSelect;
+    uint16_t top;
+};
+
+template <uint32_t HZ>
+constexpr BenchRate benchRate()
+{
+    return {HZ, TimerConfig<1, HZ>::CLOCK_SELECT, TimerConfig<1, HZ>::TOP};
+}
+
+// the ISR takes about 40 cycles, so 100 kHz already spends a quarter of the CPU in it
+const BenchRate benchRates[] = {benchRate<1000>(), benchRate<10000>(), benchRate<50000>(), benchRate<100000>()};
+
+static volatile uint8_t isrSegments = 0;    // pattern the ISR last wrote
+static volatile unsigned long isrCount = 0; // read only while Timer1 is stopped
+
+// ISR for Timer 1, a new segment pattern each time
+ISR(TIMER1_COMPA_vect)
+{
+    uint8_t pattern = (isrSegments + 1) & SegmentBits::MASK;
+    SegmentBits::write(pattern);
+    isrSegments = pattern;
+    ++isrCount;
+}
+
+/**
+ * @brief Start Timer1 in CTC mode at a rate
+ *
+ * @param rate
+ */
+void startBenchTimer(const BenchRate &rate)
+{
+    InterruptLock lock;
+    TCCR1A = 0;
+    TCCR1B = (1 << WGM12);
+    TCNT1 = 0;
+    OCR1A = rate.top;
+    isrCount = 0;
+    TIFR1 = (1 << OCF1A);
+    TIMSK1 = (1 << OCIE1A);
+    TCCR1B |= rate.clockSelect;
+}
+
+void stopBenchTimer()
+{
+    TCCR1B = 0;
+    TIMSK1 = 0;
+}
+
+/**
+ * @brief Toggle DP BENCH_TOGGLES times with the ISR running and print what
+ * was lost
+ *
+ * @param rate ISR rate
+ * @param toggle dpToggle or dpAtomicToggle
+ * @param name method name for the report
+ */
+void benchToggles(const BenchRate &rate, ToggleFunction toggle, const char *name)
+{
+    unsigned long lost = 0;
+    unsigned long dpErrors = 0;
+    bool dp = SegmentDp::isHigh();
+
+    startBenchTimer(rate);
+
+    for (uint32_t i = 0; i < BENCH_TOGGLES; ++i)
+    {
+        toggle();
+        dp = !dp;
+
+        // compare with both shadows before the ISR can move on
+        InterruptLock lock;
+        uint8_t port = PORTD;
+        if ((port & SegmentBits::MASK) != isrSegments)
+        {
+            ++lost;
+            SegmentBits::write(isrSegments);
+        }
+        if (bool(port & SegmentDp::MASK) != dp)
+        {
+            ++dpErrors;
+            dp = !dp;
+        }
+    }
+
+    stopBenchTimer();
+
+    Serial.print(rate.hz);
+    Serial.print(',');
+    Serial.print(name);
+    Serial.print(',');
+    Serial.print(BENCH_TOGGLES);
+    Serial.print(',');
+    Serial.print(isrCount);
+    Serial.print(',');
+    Serial.print(lost);
+    Serial.print(',');
+    Serial.print((unsigned long)((uint64_t)lost * 1000000 / BENCH_TOGGLES));
+    Serial.print(',');
+    Serial.println(dpErrors);
+}
+
+/**
+ * @brief Run every ISR rate against both toggles, print the results and stop
+ *
+ */
+void runRaceBenchmark()
+{
+    Segments::output();
+    Cc1::output();
+    Cc2::output();
+    sei();
+
+    Serial.begin(BENCH_BAUD);
+    Serial.println(F("rate_hz,method,toggles,isrs,lost,lost_ppm,dp_errors"));
+
+    for (const BenchRate &rate : benchRates)
+    {
+        benchToggles(rate, dpToggle, "rmw");
+        benchToggles(rate, dpAtomicToggle, "atomic");
+    }
+
+    Serial.println(F("done"));
+    Serial.flush();
+
+    while (1)
+    {
+    }
+}
+
+#endif // RACE_BENCHMARK
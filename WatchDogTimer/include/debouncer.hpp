@@ -2,6 +2,7 @@
 #define DEBOUNCER_HPP
 
 #include <Arduino.h>
+#include "gpio.hpp"
 
 using TickType = unsigned long;
 
@@ -10,35 +11,40 @@ const TickType debounceDelay = 1000; // the debounce time
 /**
  * @brief Class for debouncing a digital input
  *
+ * @tparam PIN Pin type of the button
  */
+template <typename PIN>
 class Debouncer
 {
 private:
-    uint8_t btnPin;
     bool isPressed;
     bool lastState;
     unsigned long lastDebounceTime;
     const unsigned long debounceDelay = 50; // 50 ms debounce time
 
 public:
-    void begin(uint8_t btn)
+    void begin()
     {
-        btnPin = btn;
         isPressed = false;
         lastState = HIGH;
-        pinMode(btnPin, INPUT_PULLUP);
+        PIN::pullUp();
         lastDebounceTime = 0;
     }
 
     bool update()
     {
-        bool reading = digitalRead(btnPin);
+        return update(debounceDelay);
+    }
+
+    bool update(unsigned long delay)
+    {
+        bool reading = PIN::isHigh();
         if (reading != lastState)
         {
             lastDebounceTime = millis();
         }
 
-        if ((millis() - lastDebounceTime) > debounceDelay)
+        if ((millis() - lastDebounceTime) > delay)
         {
             if (reading != isPressed)
             {
@@ -50,6 +56,11 @@ public:
         return !isPressed; // Return true if button is pressed (considering INPUT_PULLUP)
     }
 
+    bool isSettling(unsigned long delay)
+    {
+        return (millis() - lastDebounceTime) <= delay; // input changed within the debounce time
+    }
+
     bool isButtonPressed()
     {
         return !isPressed; // Considering INPUT_PULLUP
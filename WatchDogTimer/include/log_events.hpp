@@ -0,0 +1,20 @@
+/**
+ * @file log_events.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Binary log event ids and their formats for tools/binlog_decode.py
+ */
+#ifndef LOG_EVENTS_HPP
+#define LOG_EVENTS_HPP
+
+#include <Arduino.h>
+
+// id 0 is BINLOG_DROPPED; the decoder reads the format after each id
+enum LogEvent : uint8_t
+{
+    EVT_HOLD = 1,     // "Button pressed for: %u ms"
+    EVT_RELEASED = 2, // "Button released"
+    EVT_SLEEP = 3,    // "Entering sleep mode"
+    EVT_WAKE = 4,     // "Woke up, wake source %u"
+};
+
+#endif // LOG_EVENTS_HPP
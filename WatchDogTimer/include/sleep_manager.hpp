@@ -0,0 +1,68 @@
+/**
+ * @file sleep_manager.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Tickless idle: sleep as deeply as the next deadline allows
+ */
+#ifndef SLEEP_MANAGER_HPP
+#define SLEEP_MANAGER_HPP
+
+#include <Arduino.h>
+#include "sleep_stats.hpp"
+
+const uint8_t SLEEP_TIMERS = 4;          // deadlines the manager can track
+const uint8_t NO_WDT = 0xFF;             // power down with no wake-up timer
+const unsigned long WDT_MIN_PERIOD = 16; // ms, shortest WDT period
+
+/**
+ * @brief What ended the last sleep
+ */
+enum WakeSource : uint8_t
+{
+    WAKE_NONE,   // did not sleep
+    WAKE_TICK,   // any interrupt in idle mode, normally the Timer0 millis() tick
+    WAKE_WDT,    // watchdog period elapsed in power-down
+    WAKE_PIN,    // button pin change (PCINT0)
+    WAKE_SERIAL, // RXD pin change (PCINT2)
+};
+
+/**
+ * @brief Picks the deepest sleep mode that still meets the earliest deadline.
+ *
+ * Deadlines under WDT_MIN_PERIOD, or anything that must be polled, use idle,
+ * where Timer0 keeps millis() running. Longer ones use power-down with the
+ * WDT interrupt set to the longest period that ends before the deadline. The
+ * clock stops in power-down, so now() adds the time spent there to millis().
+ * Power-save would need Timer2 clocked from a 32 kHz crystal, which the Uno
+ * does not have, so the WDT is the only timer that runs in deep sleep.
+ */
+class SleepManager
+{
+public:
+    void begin(uint8_t buttonPins, uint8_t serialPins);
+    unsigned long now() const;
+
+    void setDeadline(uint8_t timer, unsigned long at);
+    void clearDeadline(uint8_t timer);
+    void keepAwake();
+    void keepAwakeFor(unsigned long ms);
+
+    void sleep();
+    void sleepUntilPin(uint8_t buttonPins);
+    WakeSource lastWake() const;
+    SleepStats &stats();
+
+private:
+    void idle();
+    void powerDown(uint8_t prescaler, uint8_t buttonPins, uint8_t serialPins);
+
+    unsigned long deadlines[SLEEP_TIMERS];
+    uint8_t armed = 0;             // bit n set when deadlines[n] is pending
+    bool awake = false;            // poll this pass, idle only
+    unsigned long awakeUntil = 0;  // idle only until this time
+    unsigned long slept = 0;       // ms spent in power-down, not seen by millis()
+    uint8_t buttonPins = 0;        // PCMSK0 bits that wake the chip
+    uint8_t serialPins = 0;        // PCMSK2 bits that wake the chip
+    SleepStats sleepStats;
+};
+
+#endif // SLEEP_MANAGER_HPP
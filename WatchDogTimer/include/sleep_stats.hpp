@@ -0,0 +1,57 @@
+/**
+ * @file sleep_stats.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Sleep residency and wake ISR to resume time counters
+ */
+#ifndef SLEEP_STATS_HPP
+#define SLEEP_STATS_HPP
+
+#include <Arduino.h>
+
+/**
+ * @brief Sleep modes the manager uses
+ */
+enum SleepMode : uint8_t
+{
+    MODE_IDLE,       // idle, Timer0 running
+    MODE_POWER_DOWN, // power-down with a WDT period
+    MODE_DORMANT,    // power-down until a pin, no timer
+    SLEEP_MODES,
+};
+
+const uint8_t WAKE_SOURCES = 5; // entries of WakeSource
+
+/**
+ * @brief Counts where the time goes between reports: awake, idle and
+ * power-down, the number of sleeps and wake-ups of each kind, and the time
+ * from the stamp in the interrupt that woke the chip to the first instruction
+ * after sleep_cpu(): the rest of that ISR and its reti.
+ *
+ * Timestamps come from Timer1 running free at the CPU clock. It needs no
+ * interrupts and holds its count through power-down, so the times are exact
+ * in cycles. They are not the wake-up latency: the oscillator start-up (16K
+ * CK, ~1 ms with the Uno fuses) and the interrupt response come before the
+ * ISR runs its first instruction and are not counted.
+ */
+class SleepStats
+{
+public:
+    void begin();
+    void enter();
+    void exit(SleepMode mode, uint8_t source, unsigned long creditedMillis, uint16_t wakeStamp, uint16_t resumeStamp);
+    void reset();
+    void print(Print &out) const;
+
+private:
+    unsigned long lastReset = 0;      // micros() at the last reset
+    unsigned long lastExit = 0;       // micros() at the last wake-up
+    unsigned long enteredAt = 0;      // micros() at the last sleep entry
+    unsigned long activeMicros = 0;   // awake time since the last reset
+    unsigned long residency[SLEEP_MODES]; // us in each mode since the last reset
+    uint16_t sleeps[SLEEP_MODES];     // sleeps in each mode
+    uint16_t wakes[WAKE_SOURCES];     // wake-ups by WakeSource
+    uint16_t resumeMin;               // cycles from the stamp in the wake ISR to resume
+    uint16_t resumeMax;
+};
+
+#endif // SLEEP_STATS_HPP
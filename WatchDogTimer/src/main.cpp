@@ -2,114 +2,203 @@
  * @file main.cpp
  * @author Kevin Wing (wing5640@vandals.uidaho.edu)
  * @brief Watchdog Timer example
+ *
+ * The LED blinks, and holding the sleep button for the hold timeout turns the
+ * LED off and puts the chip to sleep until the wake button is pressed. Between
+ * events the sleep manager powers the chip down, with the watchdog timer as
+ * the wake-up clock, so the loop only runs when something is due.
+ *
+ * Serial commands: "c" lists and sets the tuning values, "s" prints the sleep
+ * residency and wake ISR to resume counters and starts a new measurement, "l"
+ * does the same for the loop period histogram, "m" prints the SRAM high-water
+ * marks. Events
+ * go out as binary log records at BINLOG_BAUD; read them with
+ *     python tools/binlog_decode.py --events WatchDogTimer/include/log_events.hpp <port>
  */
 #include <Arduino.h>
-#include <avr/sleep.h>
-#include <avr/wdt.h>
 #include "debouncer.hpp"
+#include "config_store.hpp"
+#include "sleep_manager.hpp"
+#include "bin_log.hpp"
+#include "log_events.hpp"
+#include "gpio.hpp"
+#include "loop_monitor.hpp"
+#include "stack_paint.hpp"
 
 void blinkLED();
-void handleWatchdogTimer();
-void wakeUpISR();
+void handleSleepButton();
+void enterDormant();
+void printSleepStats(const char *line, Stream &serial);
+
+using Led = Pin<PortB, PB5>; // D13
+using WakeButton = Pin<PortB, PB2>;  // D10, PCINT2
+using SleepButton = Pin<PortB, PB3>; // D11, PCINT3
+// PCINT0-7 are PB0-7, so port B masks are PCMSK0 masks
+const uint8_t buttonPinMask = WakeButton::MASK | SleepButton::MASK; // PCMSK0 bits of both buttons
+const uint8_t wakePinMask = WakeButton::MASK;                       // PCMSK0 bit of the wake button
+const uint8_t serialPinMask = (1 << PCINT16);                // PCMSK2 bit of RXD
+const unsigned long serialAwakeTime = 2000;                  // ms to stay awake for serial commands
+
+// sleep manager timers
+enum Timer : uint8_t
+{
+    TIMER_BLINK,
+    TIMER_HOLD,
+};
+
+Debouncer<WakeButton> buttonWake;
+Debouncer<SleepButton> buttonSleep;
+SleepManager sleeper;
+
+/**
+ * @brief Tuning values kept in EEPROM. Set over serial with "c <key> <value>".
+ *
+ */
+struct Config
+{
+    uint16_t blinkPeriod;   // LED toggle period in ms
+    uint16_t debounceDelay; // button debounce time in ms
+    uint16_t holdTimeout;   // ms the sleep button is held before sleeping
+};
 
-const int ledPin = 13;
-const int buttonWakePin = 10;  // Replace SW2 with actual pin number
-const int buttonSleepPin = 11; // Replace SW3 with actual pin number
+const ConfigField configFields[] PROGMEM = {
+    CONFIG_FIELD(Config, blinkPeriod),   // key 0
+    CONFIG_FIELD(Config, debounceDelay), // key 1
+    CONFIG_FIELD(Config, holdTimeout),   // key 2
+};
 
-Debouncer buttonWake;
-Debouncer buttonSleep;
+ConfigStore<Config> config({250, 50, 1000}, 2, configFields);
 
 void setup()
 {
-    pinMode(ledPin, OUTPUT);
-    buttonWake.begin(buttonWakePin);
-    buttonSleep.begin(buttonSleepPin);
+    // load tuning values from EEPROM
+    config.begin();
 
-    // Set up Watchdog Timer
-    wdt_reset();                                      // Reset the WDT
-    WDTCSR |= (1 << WDCE) | (1 << WDE);               // Start timed sequence
-    WDTCSR = (1 << WDIE) | (1 << WDP2) | (1 << WDP1); // Set interrupt mode, ~2s time-out
+    Led::output();
+    buttonWake.begin();
+    buttonSleep.begin();
 
-    // Set up sleep mode
-    set_sleep_mode(SLEEP_MODE_PWR_DOWN); // Power-down mode
-    sleep_enable();                      // Enable sleep mode
-    sei();                               // Enable global interrupts
+    // Wake on either button or serial input
+    sleeper.begin(buttonPinMask, serialPinMask);
+    sei();
 
-    // Set up wake-up interrupt
-    attachInterrupt(digitalPinToInterrupt(buttonWakePin), wakeUpISR, FALLING);
+    binlog.begin();
 
-    Serial.begin(9600);
+    // micros() stops in power-down, so a loop period is the time awake and
+    // idle; one stretch of it should never get near the shortest WDT sleep
+    loopMonitor.begin(20000);
+
+    stackPaint.begin(STACK_RESET_MARGIN);
 }
 
 void loop()
 {
+    loopMonitor.tick();
+    stackPaint.scan();
+
     blinkLED();
-    handleWatchdogTimer();
+    handleSleepButton();
+
+    // retune from serial and write back changed values
+    if (sleeper.lastWake() == WAKE_SERIAL || binlog.available())
+    {
+        sleeper.keepAwakeFor(serialAwakeTime);
+    }
+    config.poll(binlog, printSleepStats);
+    config.service();
+
+    // poll while anything is in flight, power down otherwise
+    if (config.isDirty() || binlog.isBusy() ||
+        buttonWake.isSettling(config.values().debounceDelay) || buttonSleep.isSettling(config.values().debounceDelay))
+    {
+        sleeper.keepAwake();
+    }
+    sleeper.sleep();
 }
 
 void blinkLED()
 {
-    static unsigned long lastToggleTime = 0; // Stores the last time the LED was toggled
-    unsigned long currentMillis = millis();  // Current time
+    static unsigned long lastToggleTime = 0;     // Stores the last time the LED was toggled
+    unsigned long currentMillis = sleeper.now(); // Current time, including time asleep
 
-    // Check if 250 milliseconds have passed
-    if (currentMillis - lastToggleTime >= 250)
+    // Check if the blink period has passed
+    if (currentMillis - lastToggleTime >= config.values().blinkPeriod)
     {
-        digitalWrite(ledPin, !digitalRead(ledPin)); // Toggle the LED state
+        Led::toggle();                              // Toggle the LED state
         lastToggleTime = currentMillis;             // Remember the toggle time
     }
+
+    sleeper.setDeadline(TIMER_BLINK, lastToggleTime + config.values().blinkPeriod);
 }
 
-void handleWatchdogTimer()
+void handleSleepButton()
 {
     static unsigned long pressStartTime = 0;
-    bool pressed = buttonSleep.update();
+    bool pressed = buttonSleep.update(config.values().debounceDelay);
+    buttonWake.update(config.values().debounceDelay);
 
     if (pressed)
     {
         if (pressStartTime == 0)
         { // Record the time when button is first pressed
-            pressStartTime = millis();
+            pressStartTime = sleeper.now();
+            sleeper.setDeadline(TIMER_HOLD, pressStartTime + config.values().holdTimeout);
         }
 
-        unsigned long pressDuration = millis() - pressStartTime;
-        Serial.print("Button pressed for: ");
-        Serial.print(pressDuration);
-        Serial.println(" ms");
+        unsigned long pressDuration = sleeper.now() - pressStartTime;
+        binlog.log(EVT_HOLD, pressDuration);
+
+        if (pressDuration >= config.values().holdTimeout)
+        {
+            enterDormant();
+            pressStartTime = 0;
+        }
     }
     else
     {
         if (pressStartTime != 0)
         {
-            Serial.println("Button released");
+            binlog.log(EVT_RELEASED);
             pressStartTime = 0;
+            sleeper.clearDeadline(TIMER_HOLD);
         }
     }
-
-    if (!pressed)
-    {
-        wdt_reset(); // Reset WDT if the button is not pressed
-    }
 }
 
-// ISR for WDT interrupt
-ISR(WDT_vect)
+/**
+ * @brief Sleep button held too long: turn the LED off and power down until the
+ * wake button is pressed
+ *
+ */
+void enterDormant()
 {
-    // Disable further WDT interrupts
-    wdt_disable();
+    sleeper.clearDeadline(TIMER_HOLD);
 
     // Prepare for sleep
-    digitalWrite(ledPin, LOW);
-
-    // Enter sleep mode
-    // Serial.println("Entering sleep mode");
-    sleep_mode();
+    Led::clear();
+    binlog.log(EVT_SLEEP);
+    binlog.flush();
 
-    // After waking up
-    // digitalWrite(ledPin, HIGH);
+    sleeper.sleepUntilPin(wakePinMask);
+    binlog.log(EVT_WAKE, sleeper.lastWake());
 }
 
-void wakeUpISR()
+/**
+ * @brief Handle the "s" serial command: print the sleep counters since the
+ * last "s" and clear them, "l": the same for the loop period histogram, and
+ * "m": print the SRAM high-water marks
+ *
+ * @param line command line
+ * @param serial
+ */
+void printSleepStats(const char *line, Stream &serial)
 {
-    // Wake up is handled. Nothing to do here
+    if (line[0] == 's')
+    {
+        sleeper.stats().print(serial);
+        sleeper.stats().reset();
+    }
+
+    loopMonitor.command(line, serial);
+    stackPaint.command(line, serial);
 }
@@ -0,0 +1,257 @@
+/**
+ * @file sleep_manager.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Definition of the tickless idle manager
+ */
+#include "sleep_manager.hpp"
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+#include "timing.hpp"
+#include "timer_config.hpp"
+#include "atomic.hpp"
+
+/**
+ * @brief The interrupt that woke the chip and the CycleStamp when it ran
+ */
+struct WakeEvent
+{
+    WakeSource source;
+    uint16_t stamp;
+};
+
+// written by the wake-up interrupts, a later pin change may overwrite it
+static SeqLock<WakeEvent> wakeEvent;
+
+/**
+ * @brief Set up the pin change interrupts that wake the chip
+ *
+ * @param buttonPins PCMSK0 bits of the buttons
+ * @param serialPins PCMSK2 bits of the serial receive pin
+ */
+void SleepManager::begin(uint8_t buttonPins, uint8_t serialPins)
+{
+    this->buttonPins = buttonPins;
+    this->serialPins = serialPins;
+
+    PCMSK0 = buttonPins;
+    PCMSK2 = serialPins;
+    PCIFR = (1 << PCIF0) | (1 << PCIF2);
+    PCICR |= (1 << PCIE0) | (1 << PCIE2);
+
+    this->sleepStats.begin();
+}
+
+/**
+ * @brief Milliseconds since boot, including time spent in power-down
+ *
+ * @return unsigned long
+ */
+unsigned long SleepManager::now() const
+{
+    return millis() + this->slept;
+}
+
+/**
+ * @brief Arm a timer
+ *
+ * @param timer 0 to SLEEP_TIMERS - 1
+ * @param at time in now() milliseconds
+ */
+void SleepManager::setDeadline(uint8_t timer, unsigned long at)
+{
+    this->deadlines[timer] = at;
+    this->armed |= (1 << timer);
+}
+
+/**
+ * @brief Disarm a timer
+ *
+ * @param timer
+ */
+void SleepManager::clearDeadline(uint8_t timer)
+{
+    this->armed &= ~(1 << timer);
+}
+
+/**
+ * @brief Only idle on the next sleep(), for work that has to be polled
+ *
+ */
+void SleepManager::keepAwake()
+{
+    this->awake = true;
+}
+
+/**
+ * @brief Only idle for a while, e.g. while a serial command may be arriving
+ *
+ * @param ms
+ */
+void SleepManager::keepAwakeFor(unsigned long ms)
+{
+    this->awakeUntil = now() + ms;
+}
+
+/**
+ * @brief Sleep until the earliest deadline or a wake-up pin, whichever is first.
+ * Returns at once if a deadline has passed. Call at the end of loop().
+ *
+ */
+void SleepManager::sleep()
+{
+    unsigned long time = now();
+    long remaining = 0x7FFFFFFF;
+
+    for (uint8_t timer = 0; timer < SLEEP_TIMERS; ++timer)
+    {
+        if (this->armed & (1 << timer))
+        {
+            long left = (long)(this->deadlines[timer] - time);
+            if (left < remaining)
+            {
+                remaining = left;
+            }
+        }
+    }
+
+    if (remaining <= 0)
+    {
+        wakeEvent.write({WAKE_NONE, 0});
+        return;
+    }
+
+    if (this->awake || (long)(this->awakeUntil - time) > 0 || remaining < (long)WDT_MIN_PERIOD)
+    {
+        this->awake = false;
+        idle();
+        return;
+    }
+
+    if (!this->armed)
+    {
+        // nothing to wait for but the pins
+        powerDown(NO_WDT, this->buttonPins, this->serialPins);
+        return;
+    }
+
+    // longest WDT period that ends before the deadline, 16 ms << prescaler
+    uint8_t prescaler = wdtPrescalerFor(remaining);
+
+    powerDown(prescaler, this->buttonPins, this->serialPins);
+}
+
+/**
+ * @brief Power down until one of the given button pins changes. There is no
+ * timer, so now() does not count the time spent here.
+ *
+ * @param buttonPins PCMSK0 bits that may wake the chip
+ */
+void SleepManager::sleepUntilPin(uint8_t buttonPins)
+{
+    powerDown(NO_WDT, buttonPins, 0);
+}
+
+/**
+ * @brief What ended the last sleep
+ *
+ * @return WakeSource
+ */
+WakeSource SleepManager::lastWake() const
+{
+    return wakeEvent.read().source;
+}
+
+/**
+ * @brief Residency and wake ISR to resume time counters
+ *
+ * @return SleepStats&
+ */
+SleepStats &SleepManager::stats()
+{
+    return this->sleepStats;
+}
+
+/**
+ * @brief Idle until the next interrupt. Timers and the UART keep running.
+ *
+ */
+void SleepManager::idle()
+{
+    wakeEvent.write({WAKE_TICK, 0});
+
+    this->sleepStats.enter();
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_mode();
+    this->sleepStats.exit(MODE_IDLE, wakeEvent.read().source, 0, 0, 0);
+}
+
+/**
+ * @brief Power down until the WDT period ends or a pin wakes the chip
+ *
+ * @param prescaler WDT prescaler 0-9, or NO_WDT to wake on pins only
+ * @param buttonPins PCMSK0 bits that may wake the chip
+ * @param serialPins PCMSK2 bits that may wake the chip
+ */
+void SleepManager::powerDown(uint8_t prescaler, uint8_t buttonPins, uint8_t serialPins)
+{
+    PCMSK0 = buttonPins;
+    PCMSK2 = serialPins;
+
+    this->sleepStats.enter();
+
+    cli();
+    wakeEvent.write({WAKE_NONE, 0});
+
+    if (prescaler != NO_WDT)
+    {
+        // interrupt mode only, the WDT must not reset the chip
+        uint8_t wdtBits = (1 << WDIE) | wdtPrescalerBits(prescaler);
+        wdt_reset();
+        WDTCSR |= (1 << WDCE) | (1 << WDE);
+        WDTCSR = wdtBits;
+    }
+
+    set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+    sleep_enable();
+    sleep_bod_disable();
+    sei();
+    sleep_cpu(); // sei() lets one more instruction run, so no wake-up is missed
+    uint16_t resumeStamp = CycleStamp::now();
+    sleep_disable();
+
+    wdt_disable();
+
+    PCMSK0 = this->buttonPins;
+    PCMSK2 = this->serialPins;
+
+    WakeEvent wake = wakeEvent.read();
+    unsigned long credited = 0;
+    if (prescaler != NO_WDT)
+    {
+        // a pin may end the period early at an unknown point; count half of it
+        unsigned long period = WDT_MIN_PERIOD << prescaler;
+        credited = wake.source == WAKE_WDT ? period : period / 2;
+        this->slept += credited;
+    }
+
+    this->sleepStats.exit(prescaler == NO_WDT ? MODE_DORMANT : MODE_POWER_DOWN, wake.source, credited, wake.stamp,
+                          resumeStamp);
+}
+
+// ISR for WDT interrupt, ends a power-down period
+ISR(WDT_vect)
+{
+    wakeEvent.write({WAKE_WDT, CycleStamp::now()});
+}
+
+// ISR for the button pins
+ISR(PCINT0_vect)
+{
+    wakeEvent.write({WAKE_PIN, CycleStamp::now()});
+}
+
+// ISR for the serial receive pin
+ISR(PCINT2_vect)
+{
+    wakeEvent.write({WAKE_SERIAL, CycleStamp::now()});
+}
@@ -0,0 +1,140 @@
+/**
+ * @file sleep_stats.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Definition of the sleep residency and wake ISR to resume time counters
+ */
+#include "sleep_stats.hpp"
+#include "timing.hpp"
+
+/**
+ * @brief Start Timer1 counting CPU cycles and clear the counters
+ *
+ */
+void SleepStats::begin()
+{
+    CycleStamp::begin();
+
+    reset();
+}
+
+/**
+ * @brief Note a sleep entry. Call right before sleeping.
+ *
+ */
+void SleepStats::enter()
+{
+    this->enteredAt = micros();
+    this->activeMicros += this->enteredAt - this->lastExit;
+}
+
+/**
+ * @brief Note a wake-up. Call right after waking.
+ *
+ * @param mode mode that just ended
+ * @param source WakeSource that ended it
+ * @param creditedMillis power-down time credited from the WDT period
+ * @param wakeStamp TCNT1 in the interrupt that woke the chip
+ * @param resumeStamp TCNT1 at the first instruction after sleep_cpu()
+ */
+void SleepStats::exit(SleepMode mode, uint8_t source, unsigned long creditedMillis, uint16_t wakeStamp, uint16_t resumeStamp)
+{
+    this->lastExit = micros();
+
+    // micros() stops in power-down, so only the credited WDT time covers it
+    this->residency[mode] += (this->lastExit - this->enteredAt) + creditedMillis * 1000;
+    ++this->sleeps[mode];
+
+    if (source < WAKE_SOURCES)
+    {
+        ++this->wakes[source];
+    }
+
+    // idle wakes are mostly the Timer0 tick, which is not stamped
+    if (mode != MODE_IDLE)
+    {
+        uint16_t resume = resumeStamp - wakeStamp;
+        if (resume < this->resumeMin)
+        {
+            this->resumeMin = resume;
+        }
+        if (resume > this->resumeMax)
+        {
+            this->resumeMax = resume;
+        }
+    }
+}
+
+/**
+ * @brief Clear the counters. The counters are 32 bit microseconds, so reset at
+ * least once an hour.
+ *
+ */
+void SleepStats::reset()
+{
+    this->lastReset = micros();
+    this->lastExit = this->lastReset;
+    this->activeMicros = 0;
+
+    for (uint8_t mode = 0; mode < SLEEP_MODES; ++mode)
+    {
+        this->residency[mode] = 0;
+        this->sleeps[mode] = 0;
+    }
+
+    for (uint8_t source = 0; source < WAKE_SOURCES; ++source)
+    {
+        this->wakes[source] = 0;
+    }
+
+    this->resumeMin = 0xFFFF;
+    this->resumeMax = 0;
+}
+
+/**
+ * @brief Print the counters, one line per item
+ *
+ * @param out
+ */
+void SleepStats::print(Print &out) const
+{
+    static const char *const modeNames[SLEEP_MODES] = {"idle", "power-down", "dormant"};
+    static const char *const wakeNames[WAKE_SOURCES] = {"none", "tick", "wdt", "pin", "serial"};
+
+    unsigned long total = this->activeMicros;
+    for (uint8_t mode = 0; mode < SLEEP_MODES; ++mode)
+    {
+        total += this->residency[mode];
+    }
+
+    out.print(F("active us "));
+    out.print(this->activeMicros);
+    out.print(F(" ("));
+    out.print(total ? this->activeMicros / (total / 100 + 1) : 0);
+    out.println(F("%)"));
+
+    for (uint8_t mode = 0; mode < SLEEP_MODES; ++mode)
+    {
+        out.print(modeNames[mode]);
+        out.print(F(" us "));
+        out.print(this->residency[mode]);
+        out.print(F(" ("));
+        out.print(total ? this->residency[mode] / (total / 100 + 1) : 0);
+        out.print(F("%) sleeps "));
+        out.println(this->sleeps[mode]);
+    }
+
+    out.print(F("wakes"));
+    for (uint8_t source = 1; source < WAKE_SOURCES; ++source)
+    {
+        out.print(' ');
+        out.print(wakeNames[source]);
+        out.print(' ');
+        out.print(this->wakes[source]);
+    }
+    out.println();
+
+    out.print(F("wake ISR to resume cycles min "));
+    out.print(this->resumeMax ? this->resumeMin : 0);
+    out.print(F(" max "));
+    out.println(this->resumeMax);
+}
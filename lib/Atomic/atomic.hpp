@@ -0,0 +1,203 @@
+/**
+ * @file atomic.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Values shared between interrupts and the main loop
+ *
+ * The AVR reads and writes one byte at a time, so an interrupt can land in the
+ * middle of a multi-byte access and the other side sees half an old and half a
+ * new value. Interrupts do not nest, so an ISR always runs to completion
+ * before the main loop continues.
+ */
+#ifndef ATOMIC_HPP
+#define ATOMIC_HPP
+
+#include <Arduino.h>
+
+/**
+ * @brief Stop the compiler from moving memory accesses across this point
+ */
+#define COMPILER_BARRIER() asm volatile("" ::: "memory")
+
+/**
+ * @brief Interrupts off for the life of the object, then back to how they were
+ */
+class InterruptLock
+{
+public:
+    InterruptLock() : oldSREG(SREG)
+    {
+        cli();
+    }
+
+    ~InterruptLock()
+    {
+        SREG = oldSREG;
+    }
+
+    InterruptLock(const InterruptLock &) = delete;
+    InterruptLock &operator=(const InterruptLock &) = delete;
+
+private:
+    uint8_t oldSREG;
+};
+
+/**
+ * @brief An integer that is read and written whole. Accesses of more than one
+ * byte mask interrupts for the few cycles they take.
+ *
+ * peek() reads without masking. That is safe in an ISR, and in the one context
+ * that writes the value, since nothing else can change it halfway.
+ *
+ * @tparam T integer type
+ */
+template <typename T>
+class Atomic
+{
+public:
+    Atomic() = default;
+    Atomic(T value) : value(value) {}
+
+    T load() const
+    {
+        if (sizeof(T) == 1)
+        {
+            return this->value;
+        }
+
+        InterruptLock lock;
+        return this->value;
+    }
+
+    void store(T value)
+    {
+        if (sizeof(T) == 1)
+        {
+            this->value = value;
+            return;
+        }
+
+        InterruptLock lock;
+        this->value = value;
+    }
+
+    /**
+     * @brief Store a value and return the one it replaced
+     */
+    T exchange(T value)
+    {
+        InterruptLock lock;
+        T old = this->value;
+        this->value = value;
+        return old;
+    }
+
+    /**
+     * @brief Add to the value and return the value before the add
+     */
+    T fetchAdd(T amount)
+    {
+        InterruptLock lock;
+        T old = this->value;
+        this->value = old + amount;
+        return old;
+    }
+
+    T peek() const
+    {
+        return this->value;
+    }
+
+private:
+    volatile T value = T();
+};
+
+/**
+ * @brief A value of any size that an ISR updates and the main loop reads
+ * without masking interrupts.
+ *
+ * The sequence number is odd while a write is in progress. A reader copies the
+ * value and retries if the sequence number was odd or changed, which only
+ * happens when an interrupt wrote in between. Writes mask interrupts, so they
+ * may come from the main loop as well, and an ISR can read too.
+ *
+ * @tparam T trivially copyable type
+ */
+template <typename T>
+class SeqLock
+{
+public:
+    SeqLock() = default;
+    SeqLock(const T &value) : data(value) {}
+
+    void write(const T &value)
+    {
+        InterruptLock lock;
+        this->sequence = this->sequence + 1;
+        COMPILER_BARRIER();
+        this->data = value;
+        COMPILER_BARRIER();
+        this->sequence = this->sequence + 1;
+    }
+
+    T read() const
+    {
+        T copy;
+        uint8_t before;
+        do
+        {
+            before = this->sequence;
+            COMPILER_BARRIER();
+            copy = this->data;
+            COMPILER_BARRIER();
+        } while ((before & 1) || before != this->sequence);
+
+        return copy;
+    }
+
+private:
+    T data = T();
+    volatile uint8_t sequence = 0;
+};
+
+/**
+ * @brief Two copies of a value the main loop fills in and an ISR uses. The
+ * main loop writes back() and publish() makes it the front() in one byte
+ * store, so an ISR never sees a half-written value and the writer never masks
+ * interrupts.
+ *
+ * Only for the main loop writing and ISRs reading: an ISR runs to completion,
+ * so the buffer it reads cannot be handed back to the writer while it reads.
+ *
+ * @tparam T
+ */
+template <typename T>
+class DoubleBuffer
+{
+public:
+    T &back()
+    {
+        return this->buffers[this->frontIndex ^ 1];
+    }
+
+    /**
+     * @brief Make back() the front, then start the new back() as a copy of it
+     */
+    void publish()
+    {
+        COMPILER_BARRIER();
+        this->frontIndex = this->frontIndex ^ 1;
+        COMPILER_BARRIER();
+        this->buffers[this->frontIndex ^ 1] = this->buffers[this->frontIndex];
+    }
+
+    const T &front() const
+    {
+        return this->buffers[this->frontIndex];
+    }
+
+private:
+    T buffers[2] = {};
+    volatile uint8_t frontIndex = 0;
+};
+
+#endif // ATOMIC_HPP
@@ -0,0 +1,282 @@
+/**
+ * @file arduino_mock.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Definition of the Arduino core functions on the mock registers
+ */
+#include "avr_mock.hpp"
+#include <stdio.h>
+
+// analogRead() results by channel, set with mockSetAnalog()
+static uint16_t analogInputs[8];
+
+/**
+ * @brief What the core's wiring.c does before setup(): enable interrupts,
+ * start Timer0, whose overflow drives millis() on the chip, and leave Timer1
+ * and Timer2 counting at clk/64 in 8 bit phase correct PWM for analogWrite()
+ */
+void init()
+{
+    TCCR0A = (1 << WGM01) | (1 << WGM00);
+    TCCR0B = (1 << CS01) | (1 << CS00);
+    TIMSK0 = (1 << TOIE0);
+
+    TCCR1A = (1 << WGM10);
+    TCCR1B = (1 << CS11) | (1 << CS10);
+
+    TCCR2A = (1 << WGM20);
+    TCCR2B = (1 << CS22);
+    sei();
+}
+
+unsigned long millis()
+{
+    mockAdvance(MOCK_CALL_CYCLES);
+    return (uint32_t)(mockCycles() / (F_CPU / 1000));
+}
+
+unsigned long micros()
+{
+    mockAdvance(MOCK_CALL_CYCLES);
+    return (uint32_t)(mockCycles() / (F_CPU / 1000000));
+}
+
+void delay(unsigned long ms)
+{
+    mockAdvance(ms * (F_CPU / 1000));
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    mockAdvance(us * (F_CPU / 1000000));
+}
+
+void mockDelayCycles(unsigned long cycles)
+{
+    mockAdvance(cycles);
+}
+
+/**
+ * @brief Port and bit of an Uno pin: D0-D7 on port D, D8-D13 on port B and
+ * A0-A5 on port C
+ *
+ * @param pin
+ * @param port
+ * @param mask
+ * @return true if the pin exists
+ */
+static bool pinBit(uint8_t pin, volatile uint8_t *&port, volatile uint8_t *&ddr, uint8_t &mask)
+{
+    if (pin < 8)
+    {
+        port = &PORTD;
+        ddr = &DDRD;
+        mask = 1 << pin;
+    }
+    else if (pin < 14)
+    {
+        port = &PORTB;
+        ddr = &DDRB;
+        mask = 1 << (pin - 8);
+    }
+    else if (pin < 20)
+    {
+        port = &PORTC;
+        ddr = &DDRC;
+        mask = 1 << (pin - 14);
+    }
+    else
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+    volatile uint8_t *port, *ddr;
+    uint8_t mask;
+    mockAdvance(MOCK_CALL_CYCLES);
+    if (!pinBit(pin, port, ddr, mask))
+    {
+        return;
+    }
+
+    if (mode == OUTPUT)
+    {
+        *ddr |= mask;
+    }
+    else
+    {
+        *ddr &= ~mask;
+        if (mode == INPUT_PULLUP)
+        {
+            *port |= mask;
+        }
+        else
+        {
+            *port &= ~mask;
+        }
+    }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value)
+{
+    volatile uint8_t *port, *ddr;
+    uint8_t mask;
+    mockAdvance(MOCK_CALL_CYCLES);
+    if (!pinBit(pin, port, ddr, mask))
+    {
+        return;
+    }
+
+    if (value == LOW)
+    {
+        *port &= ~mask;
+    }
+    else
+    {
+        *port |= mask;
+    }
+}
+
+int digitalRead(uint8_t pin)
+{
+    volatile uint8_t *port, *ddr;
+    uint8_t mask;
+    mockAdvance(MOCK_CALL_CYCLES);
+    if (!pinBit(pin, port, ddr, mask))
+    {
+        return LOW;
+    }
+
+    MockPort mockPort = port == &PORTB ? MOCK_PORT_B : port == &PORTC ? MOCK_PORT_C : MOCK_PORT_D;
+    return (mockPins(mockPort) & mask) ? HIGH : LOW;
+}
+
+/**
+ * @brief The value set with mockSetAnalog(), after one conversion time
+ *
+ * @param pin A0-A5, or a channel number
+ * @return int 0-1023
+ */
+int analogRead(uint8_t pin)
+{
+    mockAdvance(MOCK_ADC_CYCLES);
+    return analogInputs[(pin >= A0 ? pin - A0 : pin) & 7];
+}
+
+/**
+ * @brief PWM is not modelled: the pin is an output, high from a duty of half
+ * up
+ *
+ * @param pin
+ * @param value 0-255
+ */
+void analogWrite(uint8_t pin, int value)
+{
+    pinMode(pin, OUTPUT);
+    digitalWrite(pin, value >= 128 ? HIGH : LOW);
+}
+
+void mockSetAnalog(uint8_t channel, uint16_t value)
+{
+    analogInputs[channel & 7] = value & 0x3FF;
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+    size_t n = 0;
+    while (size--)
+    {
+        n += write(*buffer++);
+    }
+    return n;
+}
+
+size_t Print::print(const __FlashStringHelper *text)
+{
+    return write(reinterpret_cast<const char *>(text));
+}
+
+size_t Print::print(const char *text)
+{
+    return write(text);
+}
+
+size_t Print::print(char c)
+{
+    return write((uint8_t)c);
+}
+
+size_t Print::print(unsigned char value, int base)
+{
+    return printNumber(value, base);
+}
+
+size_t Print::print(int value, int base)
+{
+    return print((long long)value, base);
+}
+
+size_t Print::print(unsigned int value, int base)
+{
+    return printNumber(value, base);
+}
+
+size_t Print::print(long value, int base)
+{
+    return print((long long)value, base);
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+    return printNumber(value, base);
+}
+
+size_t Print::print(long long value, int base)
+{
+    if (value < 0 && base == DEC)
+    {
+        return print('-') + printNumber(-(unsigned long long)value, base);
+    }
+    return printNumber(value, base);
+}
+
+size_t Print::print(unsigned long long value, int base)
+{
+    return printNumber(value, base);
+}
+
+size_t Print::print(double value, int digits)
+{
+    char text[32];
+    snprintf(text, sizeof(text), "%.*f", digits, value);
+    return write(text);
+}
+
+size_t Print::println()
+{
+    return write("\r\n");
+}
+
+size_t Print::printNumber(unsigned long long value, int base)
+{
+    char text[65];
+    char *digit = &text[sizeof(text) - 1];
+    *digit = '\0';
+
+    if (base < 2)
+    {
+        base = DEC;
+    }
+
+    do
+    {
+        uint8_t remainder = value % base;
+        value /= base;
+        *--digit = remainder < 10 ? '0' + remainder : 'A' + remainder - 10;
+    } while (value);
+
+    return write(digit);
+}
@@ -0,0 +1,29 @@
+/**
+ * @file eeprom.h
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief EEPROM access for native builds. The 1 KB image is kept in memory,
+ * and in the file named by AVR_MOCK_EEPROM if it is set.
+ */
+#ifndef AVR_MOCK_EEPROM_H
+#define AVR_MOCK_EEPROM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <avr/io.h>
+
+#define EEMEM
+
+uint8_t eeprom_read_byte(const uint8_t *address);
+uint16_t eeprom_read_word(const uint16_t *address);
+void eeprom_read_block(void *destination, const void *source, size_t size);
+void eeprom_write_byte(uint8_t *address, uint8_t value);
+void eeprom_update_byte(uint8_t *address, uint8_t value);
+void eeprom_update_block(const void *source, void *destination, size_t size);
+
+#define eeprom_is_ready() (!(EECR & (1 << EEPE)))
+#define eeprom_busy_wait() \
+    do \
+    { \
+    } while (!eeprom_is_ready())
+
+#endif // AVR_MOCK_EEPROM_H
@@ -0,0 +1,22 @@
+/**
+ * @file interrupt.h
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Interrupt control and vectors for native builds
+ *
+ * An ISR is a plain function named after its vector. avr_mock.cpp refers to
+ * every vector weakly and calls the ones a program defines.
+ */
+#ifndef AVR_MOCK_INTERRUPT_H
+#define AVR_MOCK_INTERRUPT_H
+
+#include <avr/io.h>
+
+#define ISR(vector, ...) extern "C" void vector(void)
+#define ISR_BLOCK
+#define ISR_NOBLOCK
+#define ISR_NAKED
+
+#define sei() (SREG |= (1 << SREG_I))
+#define cli() (SREG &= (uint8_t)~(1 << SREG_I))
+
+#endif // AVR_MOCK_INTERRUPT_H
@@ -0,0 +1,202 @@
+/**
+ * @file io.h
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief ATmega328P registers as plain memory for native builds
+ *
+ * Most registers are variables. The ones whose accesses do something on the
+ * chip are small classes: a store to SREG runs pending ISRs, reading PINx
+ * takes a cycle and writing it toggles PORTx, writing 1 to a TIFRn or PCIFR
+ * flag clears it, UCSR0A has read-only flags, UDR0 sends and receives, and
+ * EECR starts EEPROM reads and writes. avr_mock.cpp moves the timers, watchdog, EEPROM and UART along
+ * in virtual time and calls the ISRs.
+ */
+#ifndef AVR_MOCK_IO_H
+#define AVR_MOCK_IO_H
+
+#include <stdint.h>
+
+#ifndef F_CPU
+#define F_CPU 16000000UL
+#endif
+
+// pins
+enum { PB0, PB1, PB2, PB3, PB4, PB5, PB6, PB7 };
+enum { PC0, PC1, PC2, PC3, PC4, PC5, PC6 };
+enum { PD0, PD1, PD2, PD3, PD4, PD5, PD6, PD7 };
+enum { PCINT0, PCINT1, PCINT2, PCINT3, PCINT4, PCINT5, PCINT6, PCINT7 };
+enum { PCINT8, PCINT9, PCINT10, PCINT11, PCINT12, PCINT13, PCINT14 };
+enum { PCINT16, PCINT17, PCINT18, PCINT19, PCINT20, PCINT21, PCINT22, PCINT23 };
+
+// status and sleep
+enum { SREG_C, SREG_Z, SREG_N, SREG_V, SREG_S, SREG_H, SREG_T, SREG_I };
+enum { SE, SM0, SM1, SM2 };
+enum { PORF, EXTRF, BORF, WDRF };
+enum { WDP0, WDP1, WDP2, WDE, WDCE, WDP3, WDIE, WDIF };
+
+// timers
+enum { WGM00, WGM01, COM0B0 = 4, COM0B1, COM0A0, COM0A1 };
+enum { CS00, CS01, CS02, WGM02 };
+enum { TOIE0, OCIE0A, OCIE0B };
+enum { TOV0, OCF0A, OCF0B };
+enum { WGM10, WGM11, COM1B0 = 4, COM1B1, COM1A0, COM1A1 };
+enum { CS10, CS11, CS12, WGM12, WGM13, ICES1 = 6, ICNC1 };
+enum { TOIE1, OCIE1A, OCIE1B, ICIE1 = 5 };
+enum { TOV1, OCF1A, OCF1B, ICF1 = 5 };
+enum { WGM20, WGM21, COM2B0 = 4, COM2B1, COM2A0, COM2A1 };
+enum { CS20, CS21, CS22, WGM22 };
+enum { TOIE2, OCIE2A, OCIE2B };
+enum { TOV2, OCF2A, OCF2B };
+enum { TCR2BUB, TCR2AUB, OCR2BUB, OCR2AUB, TCN2UB, AS2, EXCLK };
+
+// external and pin change interrupts
+enum { PCIE0, PCIE1, PCIE2 };
+enum { PCIF0, PCIF1, PCIF2 };
+enum { INT0, INT1 };
+enum { INTF0, INTF1 };
+enum { ISC00, ISC01, ISC10, ISC11 };
+
+// USART0
+enum { MPCM0, U2X0, UPE0, DOR0, FE0, UDRE0, TXC0, RXC0 };
+enum { TXB80, RXB80, UCSZ02, TXEN0, RXEN0, UDRIE0, TXCIE0, RXCIE0 };
+enum { UCPOL0, UCSZ00, UCSZ01, USBS0, UPM00, UPM01, UMSEL00, UMSEL01 };
+
+// EEPROM
+enum { EERE, EEPE, EEMPE, EERIE, EEPM0, EEPM1 };
+
+// ADC and power reduction
+enum { ADPS0, ADPS1, ADPS2, ADIE, ADIF, ADATE, ADSC, ADEN };
+enum { PRADC, PRUSART0, PRSPI, PRTIM1, PRTIM2 = 6, PRTWI };
+
+/**
+ * @brief SREG. A store takes a cycle, and if it sets the I bit the pending
+ * interrupts run, as when a saved SREG is restored on the chip. sei() and cli() use |= and &=,
+ * which only change the bits: after sei() the chip runs one more instruction
+ * before any ISR, here up to the next call into the mock.
+ */
+class MockStatusRegister
+{
+public:
+    operator uint8_t() const { return bits; }
+    MockStatusRegister &operator=(uint8_t value);
+    MockStatusRegister &operator|=(uint8_t value)
+    {
+        bits |= value;
+        return *this;
+    }
+    MockStatusRegister &operator&=(uint8_t value)
+    {
+        bits &= value;
+        return *this;
+    }
+
+    volatile uint8_t bits = 0;
+};
+
+/**
+ * @brief PINx: reads the pin levels, a 1 written toggles the PORTx bit
+ */
+class MockPinRegister
+{
+public:
+    explicit MockPinRegister(uint8_t port) : port(port) {}
+
+    operator uint8_t() const;
+    MockPinRegister &operator=(uint8_t toggles);
+
+    // SBI on PINx toggles just the one bit on the ATmega328P
+    MockPinRegister &operator|=(uint8_t toggles) { return *this = toggles; }
+
+private:
+    uint8_t port;
+};
+
+/**
+ * @brief Interrupt flag register, writing a 1 clears the flag
+ */
+class MockFlagRegister
+{
+public:
+    operator uint8_t() const { return flags; }
+    MockFlagRegister &operator=(uint8_t clear)
+    {
+        flags &= ~clear;
+        return *this;
+    }
+    MockFlagRegister &operator|=(uint8_t clear) { return *this = clear; }
+
+    volatile uint8_t flags = 0;
+};
+
+/**
+ * @brief UDR0: a write sends a byte, a read takes the received byte
+ */
+class MockUartData
+{
+public:
+    operator uint8_t() const;
+    MockUartData &operator=(uint8_t data);
+};
+
+/**
+ * @brief UCSR0A: RXC0 and UDRE0 are read only, a 1 written to TXC0 clears it
+ */
+class MockUartStatus
+{
+public:
+    operator uint8_t() const { return bits; }
+    MockUartStatus &operator=(uint8_t value)
+    {
+        const uint8_t writable = (1 << U2X0) | (1 << MPCM0);
+        bits = (bits & ~writable & ~(value & (1 << TXC0))) | (value & writable);
+        return *this;
+    }
+    MockUartStatus &operator|=(uint8_t value) { return *this = bits | value; }
+    MockUartStatus &operator&=(uint8_t value) { return *this = bits & value; }
+
+    volatile uint8_t bits = (1 << UDRE0);
+};
+
+/**
+ * @brief EECR: EERE reads EEDR from EEAR, EEPE after EEMPE writes it. A read
+ * takes a cycle, so polling EEPE lets the write finish.
+ */
+class MockEepromControl
+{
+public:
+    operator uint8_t() const;
+    MockEepromControl &operator=(uint8_t value);
+    MockEepromControl &operator|=(uint8_t value) { return *this = bits | value; }
+    MockEepromControl &operator&=(uint8_t value) { return *this = bits & value; }
+
+    volatile uint8_t bits = 0;
+};
+
+extern volatile uint8_t PORTB, PORTC, PORTD, DDRB, DDRC, DDRD;
+extern MockPinRegister PINB, PINC, PIND;
+
+extern volatile uint8_t TCCR0A, TCCR0B, TCNT0, OCR0A, OCR0B, TIMSK0;
+extern volatile uint8_t TCCR1A, TCCR1B, TCCR1C, TIMSK1;
+extern volatile uint16_t TCNT1, OCR1A, OCR1B, ICR1;
+extern volatile uint8_t TCCR2A, TCCR2B, TCNT2, OCR2A, OCR2B, TIMSK2, ASSR;
+extern MockFlagRegister TIFR0, TIFR1, TIFR2, PCIFR, EIFR;
+
+extern MockStatusRegister SREG;
+extern volatile uint8_t MCUSR, WDTCSR, SMCR, PRR, GPIOR0, GPIOR1, GPIOR2;
+extern volatile uint8_t PCICR, PCMSK0, PCMSK1, PCMSK2, EICRA, EIMSK;
+extern volatile uint8_t ADCSRA, ADCSRB, ADMUX;
+
+extern MockUartStatus UCSR0A;
+extern volatile uint8_t UCSR0B, UCSR0C, UBRR0H, UBRR0L;
+extern volatile uint16_t UBRR0;
+extern MockUartData UDR0;
+
+extern MockEepromControl EECR;
+extern volatile uint8_t EEDR;
+extern volatile uint16_t EEAR;
+
+#define _BV(bit) (1 << (bit))
+#define E2END 0x3FF
+#define RAMSTART 0x100
+#define RAMEND 0x8FF
+
+#endif // AVR_MOCK_IO_H
@@ -0,0 +1,26 @@
+/**
+ * @file pgmspace.h
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Flash access for native builds, where flash is ordinary memory
+ */
+#ifndef AVR_MOCK_PGMSPACE_H
+#define AVR_MOCK_PGMSPACE_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P const char *
+#define PSTR(s) (s)
+
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+#define pgm_read_dword(address) (*(const uint32_t *)(address))
+#define pgm_read_ptr(address) (*(void *const *)(address))
+
+#define memcpy_P memcpy
+#define strlen_P strlen
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+
+#endif // AVR_MOCK_PGMSPACE_H
@@ -0,0 +1,34 @@
+/**
+ * @file sleep.h
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Sleep modes for native builds. sleep_cpu() skips virtual time ahead
+ * to the next interrupt that can wake the chip in the selected mode.
+ */
+#ifndef AVR_MOCK_SLEEP_H
+#define AVR_MOCK_SLEEP_H
+
+#include <avr/io.h>
+
+#define SLEEP_MODE_IDLE (0)
+#define SLEEP_MODE_ADC (1 << SM0)
+#define SLEEP_MODE_PWR_DOWN (1 << SM1)
+#define SLEEP_MODE_PWR_SAVE ((1 << SM0) | (1 << SM1))
+#define SLEEP_MODE_STANDBY ((1 << SM1) | (1 << SM2))
+#define SLEEP_MODE_EXT_STANDBY ((1 << SM0) | (1 << SM1) | (1 << SM2))
+
+#define set_sleep_mode(mode) (SMCR = (SMCR & ~((1 << SM0) | (1 << SM1) | (1 << SM2))) | (mode))
+#define sleep_enable() (SMCR |= (1 << SE))
+#define sleep_disable() (SMCR &= ~(1 << SE))
+#define sleep_bod_disable()
+
+void sleep_cpu();
+
+#define sleep_mode() \
+    do \
+    { \
+        sleep_enable(); \
+        sleep_cpu(); \
+        sleep_disable(); \
+    } while (0)
+
+#endif // AVR_MOCK_SLEEP_H
@@ -0,0 +1,26 @@
+/**
+ * @file wdt.h
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Watchdog control for native builds
+ */
+#ifndef AVR_MOCK_WDT_H
+#define AVR_MOCK_WDT_H
+
+#include <avr/io.h>
+
+#define WDTO_15MS 0
+#define WDTO_30MS 1
+#define WDTO_60MS 2
+#define WDTO_120MS 3
+#define WDTO_250MS 4
+#define WDTO_500MS 5
+#define WDTO_1S 6
+#define WDTO_2S 7
+#define WDTO_4S 8
+#define WDTO_8S 9
+
+void wdt_reset();
+void wdt_enable(uint8_t timeout);
+void wdt_disable();
+
+#endif // AVR_MOCK_WDT_H
@@ -0,0 +1,1149 @@
+/**
+ * @file avr_mock.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Definition of the mock registers and the virtual hardware behind
+ * them
+ *
+ * Time only moves when the program calls into the mock: a core function, a
+ * PINx or EECR read, a delay or a sleep. mockAdvance() steps from one enabled
+ * interrupt to the next, so ISRs run at the cycle they would on the chip as
+ * far as the program's own cycles are counted, which they are not.
+ */
+#include <fcntl.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <deque>
+// after the standard library, which Arduino's min() and max() macros break
+#include "avr_mock.hpp"
+#include <avr/eeprom.h>
+#include <avr/sleep.h>
+#include <avr/wdt.h>
+
+const unsigned long long NEVER = ~0ULL;
+
+// WDT timeout at prescaler 0, 2048 cycles of the 128 kHz oscillator
+const unsigned long long WDT_BASE_CYCLES = F_CPU / 1000 * 16;
+
+// EEPROM erase and write, 3.4 ms
+const unsigned long long EEPROM_WRITE_CYCLES = F_CPU / 10000 * 34;
+
+// UART byte time when UBRR0 is not set, 10 bits at 115200 baud
+const unsigned long long UART_BYTE_CYCLES = F_CPU * 10 / 115200;
+
+// registers
+volatile uint8_t PORTB, PORTC, PORTD, DDRB, DDRC, DDRD;
+MockPinRegister PINB(MOCK_PORT_B), PINC(MOCK_PORT_C), PIND(MOCK_PORT_D);
+
+volatile uint8_t TCCR0A, TCCR0B, TCNT0, OCR0A, OCR0B, TIMSK0;
+volatile uint8_t TCCR1A, TCCR1B, TCCR1C, TIMSK1;
+volatile uint16_t TCNT1, OCR1A, OCR1B, ICR1;
+volatile uint8_t TCCR2A, TCCR2B, TCNT2, OCR2A, OCR2B, TIMSK2, ASSR;
+MockFlagRegister TIFR0, TIFR1, TIFR2, PCIFR, EIFR;
+
+MockStatusRegister SREG;
+volatile uint8_t MCUSR = (1 << PORF), WDTCSR, SMCR, PRR, GPIOR0, GPIOR1, GPIOR2;
+volatile uint8_t PCICR, PCMSK0, PCMSK1, PCMSK2, EICRA, EIMSK;
+volatile uint8_t ADCSRA, ADCSRB, ADMUX;
+
+MockUartStatus UCSR0A;
+volatile uint8_t UCSR0B, UCSR0C = (1 << UCSZ01) | (1 << UCSZ00), UBRR0H, UBRR0L;
+volatile uint16_t UBRR0;
+MockUartData UDR0;
+
+MockEepromControl EECR;
+volatile uint8_t EEDR;
+volatile uint16_t EEAR;
+
+// interrupt vectors, weak so only the ones a program defines are linked in
+#define MOCK_VECTOR(vector) extern "C" void vector(void) __attribute__((weak))
+MOCK_VECTOR(INT0_vect);
+MOCK_VECTOR(INT1_vect);
+MOCK_VECTOR(PCINT0_vect);
+MOCK_VECTOR(PCINT1_vect);
+MOCK_VECTOR(PCINT2_vect);
+MOCK_VECTOR(WDT_vect);
+MOCK_VECTOR(TIMER2_COMPA_vect);
+MOCK_VECTOR(TIMER2_COMPB_vect);
+MOCK_VECTOR(TIMER2_OVF_vect);
+MOCK_VECTOR(TIMER1_COMPA_vect);
+MOCK_VECTOR(TIMER1_COMPB_vect);
+MOCK_VECTOR(TIMER1_OVF_vect);
+MOCK_VECTOR(TIMER0_COMPA_vect);
+MOCK_VECTOR(TIMER0_COMPB_vect);
+MOCK_VECTOR(USART_RX_vect);
+MOCK_VECTOR(USART_UDRE_vect);
+MOCK_VECTOR(EE_READY_vect);
+
+/**
+ * @brief The core's Timer0 overflow interrupt. millis() and micros() count
+ * cycles here, so it only wakes the chip from idle.
+ */
+static void coreTimer0Overflow()
+{
+}
+
+/**
+ * @brief One of the 8-bit or 16-bit timers, counting in normal or CTC mode.
+ * The PWM modes count as normal mode.
+ *
+ * @tparam COUNT uint8_t or uint16_t
+ */
+template <typename COUNT>
+class MockTimer
+{
+public:
+    MockTimer(volatile uint8_t &controlB, volatile COUNT &count, volatile COUNT &compareA, volatile COUNT &compareB,
+              volatile uint8_t &mask, MockFlagRegister &flags, const uint16_t *prescalers, uint16_t (*top)())
+        : controlB(controlB), count(count), compareA(compareA), compareB(compareB), mask(mask), flags(flags),
+          prescalers(prescalers), top(top)
+    {
+    }
+
+    /**
+     * @brief CPU cycles until the timer raises an enabled interrupt
+     *
+     * @return unsigned long long cycles, or NEVER
+     */
+    unsigned long long cyclesToEvent() const
+    {
+        uint16_t prescaler = this->prescalers[this->controlB & 7];
+        if (!prescaler)
+        {
+            return NEVER;
+        }
+
+        unsigned long long ticks = NEVER;
+        if (this->mask & (1 << OCIE0A))
+        {
+            ticks = min(ticks, ticksTo(this->compareA));
+        }
+        if (this->mask & (1 << OCIE0B))
+        {
+            ticks = min(ticks, ticksTo(this->compareB));
+        }
+        if ((this->mask & (1 << TOIE0)) && this->top() == MAX)
+        {
+            ticks = min(ticks, ticksTo(0));
+        }
+
+        return ticks == NEVER ? NEVER : ticks * prescaler - this->phase;
+    }
+
+    /**
+     * @brief Count for some CPU cycles and raise the flags of every compare
+     * match and overflow passed
+     *
+     * @param cycles
+     */
+    void advance(unsigned long long cycles)
+    {
+        uint16_t prescaler = this->prescalers[this->controlB & 7];
+        if (!prescaler)
+        {
+            return;
+        }
+
+        unsigned long long total = this->phase + cycles;
+        unsigned long long ticks = total / prescaler;
+        this->phase = total % prescaler;
+
+        uint16_t top = this->top();
+        if (this->count > top)
+        {
+            // past a TOP that was lowered: run to the end of the range first
+            unsigned long long toWrap = MAX - this->count + 1;
+            if (ticks < toWrap)
+            {
+                this->count = this->count + ticks;
+                return;
+            }
+            ticks -= toWrap;
+            this->count = 0;
+            this->flags.flags |= (1 << TOV0);
+        }
+
+        if (ticksTo(this->compareA) <= ticks)
+        {
+            this->flags.flags |= (1 << OCF0A);
+        }
+        if (ticksTo(this->compareB) <= ticks)
+        {
+            this->flags.flags |= (1 << OCF0B);
+        }
+        if (top == MAX && ticksTo(0) <= ticks)
+        {
+            this->flags.flags |= (1 << TOV0);
+        }
+
+        this->count = (this->count + ticks) % (top + 1UL);
+    }
+
+private:
+    static const uint16_t MAX = (COUNT)~0;
+
+    /**
+     * @brief Timer ticks until the count next equals value
+     */
+    unsigned long long ticksTo(uint16_t value) const
+    {
+        uint16_t top = this->top();
+        COUNT count = this->count;
+
+        if (value > top)
+        {
+            return NEVER;
+        }
+        if (count > top)
+        {
+            return (unsigned long long)(MAX - count) + 1 + value;
+        }
+        return value > count ? value - count : (unsigned long long)(top - count) + 1 + value;
+    }
+
+    volatile uint8_t &controlB;
+    volatile COUNT &count;
+    volatile COUNT &compareA;
+    volatile COUNT &compareB;
+    volatile uint8_t &mask;
+    MockFlagRegister &flags;
+    const uint16_t *prescalers;
+    uint16_t (*top)();
+    unsigned long long phase = 0;
+};
+
+// prescalers by clock select value, 0 for stopped or an external clock
+static const uint16_t TIMER_PRESCALERS[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+static const uint16_t TIMER2_PRESCALERS[8] = {0, 1, 8, 32, 64, 128, 256, 1024};
+
+/**
+ * @brief TOP of an 8-bit timer: OCRnA in CTC mode, 0xFF otherwise
+ */
+static uint16_t timer0Top()
+{
+    uint8_t mode = (TCCR0A & 3) | ((TCCR0B >> 1) & 4);
+    return mode == 2 ? OCR0A : 0xFF;
+}
+
+static uint16_t timer2Top()
+{
+    uint8_t mode = (TCCR2A & 3) | ((TCCR2B >> 1) & 4);
+    return mode == 2 ? OCR2A : 0xFF;
+}
+
+/**
+ * @brief TOP of Timer1: OCR1A or ICR1 in CTC mode, 0xFFFF otherwise
+ */
+static uint16_t timer1Top()
+{
+    uint8_t mode = (TCCR1A & 3) | ((TCCR1B >> 1) & 0x0C);
+    return mode == 4 ? OCR1A : mode == 12 ? ICR1 : 0xFFFF;
+}
+
+static MockTimer<uint8_t> timer0(TCCR0B, TCNT0, OCR0A, OCR0B, TIMSK0, TIFR0, TIMER_PRESCALERS, timer0Top);
+static MockTimer<uint16_t> timer1(TCCR1B, TCNT1, OCR1A, OCR1B, TIMSK1, TIFR1, TIMER_PRESCALERS, timer1Top);
+static MockTimer<uint8_t> timer2(TCCR2B, TCNT2, OCR2A, OCR2B, TIMSK2, TIFR2, TIMER2_PRESCALERS, timer2Top);
+
+// clocks: wall time, and the I/O clock the timers count, which stops in the
+// sleep modes deeper than idle
+static unsigned long long wallCycles = 0;
+static unsigned long long ioCycles = 0;
+static unsigned long long stopAt = 0;
+
+// pins
+static volatile uint8_t *const portRegisters[MOCK_PORTS] = {&PORTB, &PORTC, &PORTD};
+static volatile uint8_t *const ddrRegisters[MOCK_PORTS] = {&DDRB, &DDRC, &DDRD};
+static volatile uint8_t *const pcmskRegisters[MOCK_PORTS] = {&PCMSK0, &PCMSK1, &PCMSK2};
+static uint8_t driven[MOCK_PORTS];
+static uint8_t drivenLevels[MOCK_PORTS];
+static uint8_t lastLevels[MOCK_PORTS];
+
+// keypad: a held key connects its row pin to its column pin
+static bool keypadConnected = false;
+static MockPin keypadRows[4], keypadCols[4];
+static int8_t heldRow = -1, heldCol = -1;
+
+// trace: the masked PORTx and DDRx values last written to it
+static FILE *traceFile = nullptr;
+static uint8_t traceMasks[MOCK_PORTS] = {0xFF, 0xFF, 0xFF};
+static uint8_t tracedPorts[MOCK_PORTS];
+static uint8_t tracedDdrs[MOCK_PORTS];
+
+// watchdog
+static unsigned long long wdtElapsed = 0;
+static uint8_t wdtSettings = 0;
+
+// EEPROM
+static uint8_t eeprom[E2END + 1];
+static unsigned long long eepromDoneAt = 0;
+
+// constructed before the constructors of the program, which may call mockAt()
+// or mockSerialInput()
+#define MOCK_EARLY __attribute__((init_priority(101)))
+
+// UART: bytes still to arrive, the byte in UDR0, and the timed events
+static std::deque<uint8_t> rxIncoming MOCK_EARLY;
+static uint8_t rxData = 0;
+static unsigned long long rxStartAt = NEVER;
+static unsigned long long rxDoneAt = NEVER;
+
+// HardwareSerial's receive buffer, used while RXCIE0 is clear
+static std::deque<uint8_t> serialReceived MOCK_EARLY;
+
+// stdin is read without blocking, once per millisecond of wall time
+static bool stdinOpen = false;
+static unsigned long long stdinPollAt = 0;
+
+// events set with mockAt()
+struct MockTimedEvent
+{
+    unsigned long long at;
+    MockEvent event;
+};
+static std::deque<MockTimedEvent> timedEvents MOCK_EARLY;
+
+static bool inInterrupt = false;
+
+/**
+ * @brief An interrupt vector, in priority order
+ */
+struct MockVector
+{
+    const char *name;
+    void (*isr)();
+    bool (*pending)();
+    void (*acknowledge)();
+    bool wakesFromPowerDown;
+};
+
+static bool flagged(MockFlagRegister &flags, volatile uint8_t &enable, uint8_t bit)
+{
+    return (flags.flags & (1 << bit)) && (enable & (1 << bit));
+}
+
+static const MockVector vectors[] = {
+    {"INT0_vect", INT0_vect, [] { return flagged(EIFR, EIMSK, INTF0); }, [] { EIFR.flags &= ~(1 << INTF0); }, true},
+    {"INT1_vect", INT1_vect, [] { return flagged(EIFR, EIMSK, INTF1); }, [] { EIFR.flags &= ~(1 << INTF1); }, true},
+    {"PCINT0_vect", PCINT0_vect, [] { return flagged(PCIFR, PCICR, PCIF0); }, [] { PCIFR.flags &= ~(1 << PCIF0); },
+     true},
+    {"PCINT1_vect", PCINT1_vect, [] { return flagged(PCIFR, PCICR, PCIF1); }, [] { PCIFR.flags &= ~(1 << PCIF1); },
+     true},
+    {"PCINT2_vect", PCINT2_vect, [] { return flagged(PCIFR, PCICR, PCIF2); }, [] { PCIFR.flags &= ~(1 << PCIF2); },
+     true},
+    {"WDT_vect", WDT_vect, [] { return (WDTCSR & (1 << WDIF)) && (WDTCSR & (1 << WDIE)); },
+     []
+     {
+         // in interrupt and reset mode the next timeout resets the chip
+         WDTCSR &= (WDTCSR & (1 << WDE)) ? ~((1 << WDIF) | (1 << WDIE)) : ~(1 << WDIF);
+         wdtSettings = WDTCSR;
+     },
+     true},
+    {"TIMER2_COMPA_vect", TIMER2_COMPA_vect, [] { return flagged(TIFR2, TIMSK2, OCF2A); },
+     [] { TIFR2.flags &= ~(1 << OCF2A); }, false},
+    {"TIMER2_COMPB_vect", TIMER2_COMPB_vect, [] { return flagged(TIFR2, TIMSK2, OCF2B); },
+     [] { TIFR2.flags &= ~(1 << OCF2B); }, false},
+    {"TIMER2_OVF_vect", TIMER2_OVF_vect, [] { return flagged(TIFR2, TIMSK2, TOV2); },
+     [] { TIFR2.flags &= ~(1 << TOV2); }, false},
+    {"TIMER1_COMPA_vect", TIMER1_COMPA_vect, [] { return flagged(TIFR1, TIMSK1, OCF1A); },
+     [] { TIFR1.flags &= ~(1 << OCF1A); }, false},
+    {"TIMER1_COMPB_vect", TIMER1_COMPB_vect, [] { return flagged(TIFR1, TIMSK1, OCF1B); },
+     [] { TIFR1.flags &= ~(1 << OCF1B); }, false},
+    {"TIMER1_OVF_vect", TIMER1_OVF_vect, [] { return flagged(TIFR1, TIMSK1, TOV1); },
+     [] { TIFR1.flags &= ~(1 << TOV1); }, false},
+    {"TIMER0_COMPA_vect", TIMER0_COMPA_vect, [] { return flagged(TIFR0, TIMSK0, OCF0A); },
+     [] { TIFR0.flags &= ~(1 << OCF0A); }, false},
+    {"TIMER0_COMPB_vect", TIMER0_COMPB_vect, [] { return flagged(TIFR0, TIMSK0, OCF0B); },
+     [] { TIFR0.flags &= ~(1 << OCF0B); }, false},
+    {"TIMER0_OVF_vect", coreTimer0Overflow, [] { return flagged(TIFR0, TIMSK0, TOV0); },
+     [] { TIFR0.flags &= ~(1 << TOV0); }, false},
+    {"USART_RX_vect", USART_RX_vect, [] { return (UCSR0A & (1 << RXC0)) && (UCSR0B & (1 << RXCIE0)); }, [] {},
+     false},
+    {"USART_UDRE_vect", USART_UDRE_vect, [] { return (UCSR0A & (1 << UDRE0)) && (UCSR0B & (1 << UDRIE0)); }, [] {},
+     false},
+    {"EE_READY_vect", EE_READY_vect, [] { return !(EECR.bits & (1 << EEPE)) && (EECR.bits & (1 << EERIE)); }, [] {},
+     false},
+};
+
+/**
+ * @brief Input levels of a port: outputs read back PORTx, inputs the level a
+ * test drives, or the pull-up if none
+ */
+static uint8_t pinLevels(uint8_t port)
+{
+    uint8_t outputs = *ddrRegisters[port];
+    uint8_t inputs = *portRegisters[port];
+    inputs = (inputs & ~driven[port]) | (drivenLevels[port] & driven[port]);
+    uint8_t levels = (*portRegisters[port] & outputs) | (inputs & ~outputs);
+
+    // the column of a held key reads low while the program drives its row low
+    if (keypadConnected && heldRow >= 0 && keypadCols[heldCol].port == port)
+    {
+        MockPin row = keypadRows[heldRow];
+        uint8_t rowBit = 1 << row.bit;
+        uint8_t colBit = 1 << keypadCols[heldCol].bit;
+        if ((*ddrRegisters[row.port] & rowBit) && !(*portRegisters[row.port] & rowBit) && !(outputs & colBit))
+        {
+            levels &= ~colBit;
+        }
+    }
+
+    return levels;
+}
+
+/**
+ * @brief Trace the ports written since the last call, at the current cycle
+ */
+static void tracePorts()
+{
+    for (uint8_t port = 0; port < MOCK_PORTS; ++port)
+    {
+        uint8_t value = *portRegisters[port] & traceMasks[port];
+        uint8_t ddr = *ddrRegisters[port] & traceMasks[port];
+        if (value != tracedPorts[port] || ddr != tracedDdrs[port])
+        {
+            tracedPorts[port] = value;
+            tracedDdrs[port] = ddr;
+            fprintf(traceFile, "%llu port %c %u %u\n", wallCycles, "BCD"[port], value, ddr);
+        }
+    }
+}
+
+/**
+ * @brief Trace a byte sent on the UART
+ */
+static void traceUart(uint8_t data)
+{
+    if (traceFile)
+    {
+        tracePorts();
+        fprintf(traceFile, "%llu uart %u\n", wallCycles, data);
+    }
+}
+
+/**
+ * @brief Raise the pin change flags of the ports whose masked pins changed
+ */
+static void detectPinChanges()
+{
+    for (uint8_t port = 0; port < MOCK_PORTS; ++port)
+    {
+        uint8_t levels = pinLevels(port);
+        if ((levels ^ lastLevels[port]) & *pcmskRegisters[port])
+        {
+            PCIFR.flags |= (1 << port);
+        }
+        lastLevels[port] = levels;
+    }
+}
+
+static unsigned long long wdtPeriod()
+{
+    uint8_t prescaler = (WDTCSR & 7) | ((WDTCSR >> 2) & 8);
+    return WDT_BASE_CYCLES << (prescaler > 9 ? 9 : prescaler);
+}
+
+static bool wdtRunning()
+{
+    return WDTCSR & ((1 << WDE) | (1 << WDIE));
+}
+
+static unsigned long long uartByteCycles()
+{
+    // UBRR0 and UBRR0H:UBRR0L are the same register on the chip
+    uint16_t ubrr = UBRR0 ? UBRR0 : (UBRR0H << 8) | UBRR0L;
+    if (!ubrr)
+    {
+        return UART_BYTE_CYCLES;
+    }
+    return 10ULL * (ubrr + 1) * ((UCSR0A & (1 << U2X0)) ? 8 : 16);
+}
+
+/**
+ * @brief Start the next incoming byte if the line is idle
+ */
+static void scheduleReceive()
+{
+    if (rxStartAt == NEVER && rxDoneAt == NEVER && !rxIncoming.empty())
+    {
+        rxStartAt = wallCycles;
+    }
+}
+
+/**
+ * @brief Queue what has come in on stdin as serial input
+ */
+static void pollStdin()
+{
+    stdinPollAt = wallCycles + F_CPU / 1000;
+
+    uint8_t buffer[256];
+    ssize_t size = ::read(STDIN_FILENO, buffer, sizeof(buffer));
+    if (size > 0)
+    {
+        mockSerialInput(buffer, size);
+    }
+    else if (size == 0)
+    {
+        stdinOpen = false;
+    }
+}
+
+/**
+ * @brief Cycles until the next event of any source that runs
+ *
+ * @param ioRunning false in the sleep modes that stop the timers
+ */
+static unsigned long long cyclesToEvent(bool ioRunning)
+{
+    unsigned long long next = stopAt - wallCycles;
+
+    if (ioRunning)
+    {
+        next = min(next, timer0.cyclesToEvent());
+        next = min(next, timer1.cyclesToEvent());
+        next = min(next, timer2.cyclesToEvent());
+    }
+    if (wdtRunning())
+    {
+        next = min(next, wdtPeriod() - min(wdtElapsed, wdtPeriod() - 1));
+    }
+    if (EECR.bits & (1 << EEPE))
+    {
+        next = min(next, eepromDoneAt - min(eepromDoneAt - 1, wallCycles));
+    }
+    if (rxStartAt != NEVER)
+    {
+        next = min(next, rxStartAt > wallCycles ? rxStartAt - wallCycles : 1);
+    }
+    if (rxDoneAt != NEVER)
+    {
+        next = min(next, rxDoneAt > wallCycles ? rxDoneAt - wallCycles : 1);
+    }
+    if (!timedEvents.empty())
+    {
+        next = min(next, timedEvents.front().at > wallCycles ? timedEvents.front().at - wallCycles : 1);
+    }
+    if (stdinOpen)
+    {
+        next = min(next, stdinPollAt > wallCycles ? stdinPollAt - wallCycles : 1);
+    }
+
+    return next ? next : 1;
+}
+
+/**
+ * @brief Let time pass, raising the flags of everything that happened. Steps
+ * must not pass an event of an enabled interrupt.
+ *
+ * @param cycles
+ * @param ioRunning
+ */
+static void step(unsigned long long cycles, bool ioRunning)
+{
+    // the program wrote the ports before this time passed
+    if (traceFile)
+    {
+        tracePorts();
+    }
+
+    wallCycles += cycles;
+
+    if (ioRunning)
+    {
+        ioCycles += cycles;
+        timer0.advance(cycles);
+        timer1.advance(cycles);
+        timer2.advance(cycles);
+    }
+
+    if ((WDTCSR & ~(1 << WDIF)) != (wdtSettings & ~(1 << WDIF)))
+    {
+        wdtSettings = WDTCSR;
+        wdtElapsed = 0;
+    }
+    if (wdtRunning())
+    {
+        wdtElapsed += cycles;
+        if (wdtElapsed >= wdtPeriod())
+        {
+            wdtElapsed = 0;
+            if (WDTCSR & (1 << WDIE))
+            {
+                WDTCSR |= (1 << WDIF);
+                wdtSettings = WDTCSR;
+            }
+            else
+            {
+                fprintf(stderr, "avr_mock: watchdog reset at %llu ms\n", wallCycles / (F_CPU / 1000));
+                mockStop(2);
+            }
+        }
+    }
+
+    if ((EECR.bits & (1 << EEPE)) && wallCycles >= eepromDoneAt)
+    {
+        EECR.bits &= ~(1 << EEPE);
+    }
+
+    // a byte pulls RXD low for its start bit and arrives at its stop bit
+    if (rxStartAt != NEVER && wallCycles >= rxStartAt)
+    {
+        rxStartAt = NEVER;
+        rxDoneAt = wallCycles + uartByteCycles();
+        driven[MOCK_PORT_D] |= (1 << PD0);
+        drivenLevels[MOCK_PORT_D] &= ~(1 << PD0);
+    }
+    if (rxDoneAt != NEVER && wallCycles >= rxDoneAt)
+    {
+        rxDoneAt = NEVER;
+        drivenLevels[MOCK_PORT_D] |= (1 << PD0);
+
+        uint8_t data = rxIncoming.front();
+        rxIncoming.pop_front();
+        if (UCSR0B & (1 << RXCIE0))
+        {
+            rxData = data;
+            UCSR0A.bits |= (1 << RXC0);
+        }
+        else
+        {
+            serialReceived.push_back(data);
+        }
+        scheduleReceive();
+    }
+
+    while (!timedEvents.empty() && timedEvents.front().at <= wallCycles)
+    {
+        MockEvent event = timedEvents.front().event;
+        timedEvents.pop_front();
+        event();
+    }
+
+    if (stdinOpen && wallCycles >= stdinPollAt)
+    {
+        pollStdin();
+    }
+
+    detectPinChanges();
+
+    if (wallCycles >= stopAt)
+    {
+        fprintf(stderr, "avr_mock: stopped after %llu ms\n", wallCycles / (F_CPU / 1000));
+        mockStop(0);
+    }
+}
+
+/**
+ * @brief First pending interrupt, or nullptr
+ *
+ * @param powerDown only the ones that wake the chip from power-down
+ */
+static const MockVector *pendingVector(bool powerDown)
+{
+    for (const MockVector &vector : vectors)
+    {
+        if ((!powerDown || vector.wakesFromPowerDown) && vector.pending())
+        {
+            return &vector;
+        }
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Run the pending ISRs, highest priority first, while interrupts are
+ * enabled. An ISR runs with the I bit clear and costs MOCK_ISR_CYCLES.
+ */
+static void runInterrupts()
+{
+    while (!inInterrupt && (SREG.bits & (1 << SREG_I)))
+    {
+        const MockVector *vector = pendingVector(false);
+        if (!vector)
+        {
+            return;
+        }
+
+        if (!vector->isr)
+        {
+            // the chip jumps to __bad_interrupt, which resets it
+            fprintf(stderr, "avr_mock: %s is enabled but has no ISR\n", vector->name);
+            mockStop(1);
+        }
+
+        vector->acknowledge();
+        inInterrupt = true;
+        SREG.bits &= ~(1 << SREG_I);
+        vector->isr();
+        step(MOCK_ISR_CYCLES, true);
+        SREG.bits |= (1 << SREG_I);
+        inInterrupt = false;
+    }
+}
+
+/**
+ * @brief Let time pass, running every interrupt when it happens
+ *
+ * @param cycles
+ */
+void mockAdvance(unsigned long long cycles)
+{
+    unsigned long long end = wallCycles + cycles;
+
+    runInterrupts();
+    while (wallCycles < end)
+    {
+        step(min(end - wallCycles, cyclesToEvent(true)), true);
+        runInterrupts();
+    }
+}
+
+/**
+ * @brief CPU cycles the timers have counted, which excludes power-down
+ *
+ * @return unsigned long long
+ */
+unsigned long long mockCycles()
+{
+    return ioCycles;
+}
+
+/**
+ * @brief Cycles since the start, including power-down
+ *
+ * @return unsigned long long
+ */
+unsigned long long mockWallCycles()
+{
+    return wallCycles;
+}
+
+/**
+ * @brief Stop the run after some more cycles of wall time
+ *
+ * @param cycles
+ */
+void mockRunFor(unsigned long long cycles)
+{
+    stopAt = wallCycles + cycles;
+}
+
+/**
+ * @brief End the run: flush the output and save the EEPROM image
+ *
+ * @param status exit status
+ */
+void mockStop(int status)
+{
+    fflush(stdout);
+
+    if (traceFile)
+    {
+        tracePorts();
+        fprintf(traceFile, "%llu end %s\n", wallCycles, status ? "crashed" : "running");
+        fclose(traceFile);
+        traceFile = nullptr;
+    }
+
+    const char *path = getenv("AVR_MOCK_EEPROM");
+    FILE *file = path ? fopen(path, "wb") : nullptr;
+    if (file)
+    {
+        fwrite(eeprom, 1, sizeof(eeprom), file);
+        fclose(file);
+    }
+
+    exit(status);
+}
+
+/**
+ * @brief Drive an input pin, as a switch or another chip would
+ *
+ * @param port
+ * @param bit
+ * @param level
+ */
+void mockDrive(MockPort port, uint8_t bit, bool level)
+{
+    driven[port] |= (1 << bit);
+    if (level)
+    {
+        drivenLevels[port] |= (1 << bit);
+    }
+    else
+    {
+        drivenLevels[port] &= ~(1 << bit);
+    }
+    detectPinChanges();
+}
+
+/**
+ * @brief Stop driving a pin, it reads its pull-up again
+ *
+ * @param port
+ * @param bit
+ */
+void mockRelease(MockPort port, uint8_t bit)
+{
+    driven[port] &= ~(1 << bit);
+    detectPinChanges();
+}
+
+/**
+ * @brief Levels of a port's pins, without the cycle a PINx read costs
+ *
+ * @param port
+ * @return uint8_t
+ */
+uint8_t mockPins(MockPort port)
+{
+    return pinLevels(port);
+}
+
+/**
+ * @brief Queue bytes to arrive on RXD, one byte time apart
+ *
+ * @param data
+ * @param size
+ */
+void mockSerialInput(const uint8_t *data, size_t size)
+{
+    rxIncoming.insert(rxIncoming.end(), data, data + size);
+    scheduleReceive();
+}
+
+/**
+ * @brief Call a function when wall time reaches a cycle count, to drive pins
+ * or send input in the middle of a run
+ *
+ * @param at wall cycles
+ * @param event
+ */
+void mockAt(unsigned long long at, MockEvent event)
+{
+    auto position = timedEvents.begin();
+    while (position != timedEvents.end() && position->at <= at)
+    {
+        ++position;
+    }
+    timedEvents.insert(position, {at, event});
+}
+
+/**
+ * @brief Wire up a 4x4 keypad: a held key pulls its column pin low while the
+ * program drives its row pin low, and the column floats to its pull-up
+ * otherwise
+ *
+ * @param rows row pins, top first
+ * @param cols column pins, left first
+ */
+void mockKeypad(const MockPin rows[4], const MockPin cols[4])
+{
+    for (uint8_t i = 0; i < 4; ++i)
+    {
+        keypadRows[i] = rows[i];
+        keypadCols[i] = cols[i];
+    }
+    keypadConnected = true;
+}
+
+/**
+ * @brief Hold a key of the keypad down, or release it
+ *
+ * @param row 0-3, or -1 to release the key
+ * @param col 0-3
+ */
+void mockHoldKey(int8_t row, int8_t col)
+{
+    heldRow = row >= 0 && row < 4 && col >= 0 && col < 4 ? row : -1;
+    heldCol = heldRow >= 0 ? col : -1;
+    detectPinChanges();
+}
+
+/**
+ * @brief Trace only some pins of a port, to leave out one the program toggles
+ * in a tight loop
+ *
+ * @param port
+ * @param mask bits of PORTx and DDRx to trace
+ */
+void mockTraceMask(MockPort port, uint8_t mask)
+{
+    traceMasks[port] = mask;
+}
+
+/**
+ * @brief Write a named mark to the trace at the current cycle
+ *
+ * @param name
+ */
+void mockMark(const char *name)
+{
+    if (traceFile)
+    {
+        fprintf(traceFile, "%llu mark %s\n", wallCycles, name);
+    }
+}
+
+/**
+ * @brief The EEPROM image
+ *
+ * @return uint8_t* E2END + 1 bytes
+ */
+uint8_t *mockEeprom()
+{
+    return eeprom;
+}
+
+/**
+ * @brief Set up the run before any constructor of the program: the stop time,
+ * the EEPROM image, the trace file, the scripted inputs, and serial input from
+ * stdin when it is not a terminal
+ */
+__attribute__((constructor(102))) static void mockStart()
+{
+    const char *seconds = getenv("AVR_MOCK_SECONDS");
+    stopAt = (seconds ? strtoull(seconds, nullptr, 10) : 10) * F_CPU;
+
+    memset(eeprom, 0xFF, sizeof(eeprom));
+    const char *path = getenv("AVR_MOCK_EEPROM");
+    FILE *file = path ? fopen(path, "rb") : nullptr;
+    if (file)
+    {
+        size_t loaded = fread(eeprom, 1, sizeof(eeprom), file);
+        (void)loaded;
+        fclose(file);
+    }
+
+    // output shows up as the program runs, as it would on a serial monitor
+    setvbuf(stdout, nullptr, _IOLBF, 0);
+
+    const char *tracePath = getenv("AVR_MOCK_TRACE");
+    if (tracePath)
+    {
+        traceFile = fopen(tracePath, "w");
+        if (!traceFile)
+        {
+            perror(tracePath);
+            exit(1);
+        }
+    }
+
+    const char *inputPath = getenv("AVR_MOCK_INPUT");
+    if (inputPath)
+    {
+        mockScript(inputPath);
+    }
+
+    if (!isatty(STDIN_FILENO))
+    {
+        fcntl(STDIN_FILENO, F_SETFL, fcntl(STDIN_FILENO, F_GETFL) | O_NONBLOCK);
+        stdinOpen = true;
+    }
+}
+
+MockStatusRegister &MockStatusRegister::operator=(uint8_t value)
+{
+    this->bits = value;
+    mockAdvance(1);
+    return *this;
+}
+
+MockPinRegister::operator uint8_t() const
+{
+    mockAdvance(MOCK_PIN_CYCLES);
+    return pinLevels(this->port);
+}
+
+MockPinRegister &MockPinRegister::operator=(uint8_t toggles)
+{
+    *portRegisters[this->port] ^= toggles;
+    return *this;
+}
+
+MockUartData::operator uint8_t() const
+{
+    UCSR0A.bits &= ~(1 << RXC0);
+    return rxData;
+}
+
+/**
+ * @brief Send a byte. It goes to stdout at once and the transmitter is ready
+ * for the next one.
+ */
+MockUartData &MockUartData::operator=(uint8_t data)
+{
+    putchar(data);
+    traceUart(data);
+    UCSR0A.bits |= (1 << UDRE0) | (1 << TXC0);
+    return *this;
+}
+
+MockEepromControl::operator uint8_t() const
+{
+    mockAdvance(MOCK_PIN_CYCLES);
+    return this->bits;
+}
+
+/**
+ * @brief EERE reads a byte at once. EEPE with EEMPE already set starts an
+ * erase and write, erase only or write only, by EEPM1:0.
+ */
+MockEepromControl &MockEepromControl::operator=(uint8_t value)
+{
+    uint16_t address = EEAR & E2END;
+    bool busy = this->bits & (1 << EEPE);
+
+    if ((value & (1 << EERE)) && !busy)
+    {
+        EEDR = eeprom[address];
+    }
+
+    if ((value & (1 << EEPE)) && (this->bits & (1 << EEMPE)) && !busy)
+    {
+        switch ((value >> EEPM0) & 3)
+        {
+        case 0:
+            eeprom[address] = EEDR;
+            eepromDoneAt = wallCycles + EEPROM_WRITE_CYCLES;
+            break;
+        case 1:
+            eeprom[address] = 0xFF;
+            eepromDoneAt = wallCycles + EEPROM_WRITE_CYCLES / 2;
+            break;
+        default:
+            eeprom[address] &= EEDR;
+            eepromDoneAt = wallCycles + EEPROM_WRITE_CYCLES / 2;
+            break;
+        }
+        busy = true;
+        value &= ~(1 << EEMPE);
+    }
+
+    this->bits = (value & ~((1 << EERE) | (1 << EEPE))) | (busy ? (1 << EEPE) : 0);
+    return *this;
+}
+
+int HardwareSerial::available()
+{
+    mockAdvance(MOCK_CALL_CYCLES);
+    return serialReceived.size();
+}
+
+int HardwareSerial::read()
+{
+    mockAdvance(MOCK_CALL_CYCLES);
+    if (serialReceived.empty())
+    {
+        return -1;
+    }
+
+    uint8_t c = serialReceived.front();
+    serialReceived.pop_front();
+    return c;
+}
+
+int HardwareSerial::peek()
+{
+    mockAdvance(MOCK_CALL_CYCLES);
+    return serialReceived.empty() ? -1 : serialReceived.front();
+}
+
+size_t HardwareSerial::write(uint8_t c)
+{
+    mockAdvance(MOCK_CALL_CYCLES);
+    putchar(c);
+    traceUart(c);
+    return 1;
+}
+
+void HardwareSerial::flush()
+{
+    fflush(stdout);
+}
+
+HardwareSerial Serial;
+
+uint8_t eeprom_read_byte(const uint8_t *address)
+{
+    eeprom_busy_wait();
+    return eeprom[(uintptr_t)address & E2END];
+}
+
+uint16_t eeprom_read_word(const uint16_t *address)
+{
+    const uint8_t *bytes = (const uint8_t *)address;
+    return eeprom_read_byte(bytes) | (eeprom_read_byte(bytes + 1) << 8);
+}
+
+void eeprom_read_block(void *destination, const void *source, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        ((uint8_t *)destination)[i] = eeprom_read_byte((const uint8_t *)source + i);
+    }
+}
+
+void eeprom_write_byte(uint8_t *address, uint8_t value)
+{
+    eeprom_busy_wait();
+    eeprom[(uintptr_t)address & E2END] = value;
+    eepromDoneAt = wallCycles + EEPROM_WRITE_CYCLES;
+    EECR.bits |= (1 << EEPE);
+}
+
+void eeprom_update_byte(uint8_t *address, uint8_t value)
+{
+    if (eeprom_read_byte(address) != value)
+    {
+        eeprom_write_byte(address, value);
+    }
+}
+
+void eeprom_update_block(const void *source, void *destination, size_t size)
+{
+    for (size_t i = 0; i < size; ++i)
+    {
+        eeprom_update_byte((uint8_t *)destination + i, ((const uint8_t *)source)[i]);
+    }
+}
+
+void wdt_reset()
+{
+    wdtElapsed = 0;
+}
+
+void wdt_enable(uint8_t timeout)
+{
+    WDTCSR = (1 << WDE) | (timeout & 7) | ((timeout & 8) << 2);
+    wdt_reset();
+}
+
+void wdt_disable()
+{
+    WDTCSR = 0;
+}
+
+/**
+ * @brief Sleep until an interrupt that can wake the chip in the selected mode
+ * is pending, then run it. Idle keeps the timers counting; the deeper modes
+ * stop them and only the watchdog, pin changes and external interrupts wake
+ * the chip.
+ */
+void sleep_cpu()
+{
+    if (!(SMCR & (1 << SE)))
+    {
+        return;
+    }
+
+    bool idle = (SMCR & ((1 << SM0) | (1 << SM1) | (1 << SM2))) == SLEEP_MODE_IDLE;
+
+    while (!pendingVector(!idle))
+    {
+        step(cyclesToEvent(idle), idle);
+    }
+
+    // wake-up: 4 cycles to the ISR from idle, the oscillator start-up otherwise
+    step(idle ? 4 : 16 * 1024, idle);
+    runInterrupts();
+}
@@ -0,0 +1,65 @@
+/**
+ * @file avr_mock.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Control of the native build's virtual hardware, for tests and host
+ * benchmarks
+ *
+ * Two clocks run: the wall clock, and the CPU clock that the timers, millis()
+ * and micros() count, which stops in power-down as it does on the chip. The
+ * run ends after AVR_MOCK_SECONDS of wall time (10 by default), or whatever
+ * mockRunFor() sets.
+ *
+ * AVR_MOCK_TRACE names a file for a trace of the port writes, UART output and
+ * marks, and AVR_MOCK_INPUT a file of timed inputs, both in the formats of
+ * tools/simbench/simbench.c (see mock_script.cpp).
+ */
+#ifndef AVR_MOCK_HPP
+#define AVR_MOCK_HPP
+
+#include <Arduino.h>
+
+enum MockPort : uint8_t
+{
+    MOCK_PORT_B,
+    MOCK_PORT_C,
+    MOCK_PORT_D,
+    MOCK_PORTS,
+};
+
+struct MockPin
+{
+    MockPort port;
+    uint8_t bit;
+};
+
+using MockEvent = void (*)();
+
+// cycles charged for things the mock cannot time
+const unsigned long MOCK_CALL_CYCLES = 16;  // a call to micros(), millis() or another core function
+const unsigned long MOCK_PIN_CYCLES = 1;    // a PINx access
+const unsigned long MOCK_ISR_CYCLES = 20;   // entry and exit of an interrupt
+const unsigned long MOCK_LOOP_CYCLES = 8;   // one pass of the core's main loop
+const unsigned long MOCK_ADC_CYCLES = 1664; // one conversion at clk/128
+
+void mockAdvance(unsigned long long cycles);
+unsigned long long mockCycles();
+unsigned long long mockWallCycles();
+void mockRunFor(unsigned long long cycles);
+void mockStop(int status);
+
+void mockDrive(MockPort port, uint8_t bit, bool level);
+void mockRelease(MockPort port, uint8_t bit);
+uint8_t mockPins(MockPort port);
+void mockSetAnalog(uint8_t channel, uint16_t value);
+void mockSerialInput(const uint8_t *data, size_t size);
+void mockAt(unsigned long long wallCycles, MockEvent event);
+void mockKeypad(const MockPin rows[4], const MockPin cols[4]);
+void mockHoldKey(int8_t row, int8_t col);
+
+void mockScript(const char *path);
+void mockTraceMask(MockPort port, uint8_t mask);
+void mockMark(const char *name);
+
+uint8_t *mockEeprom();
+
+#endif // AVR_MOCK_HPP
@@ -0,0 +1,19 @@
+/**
+ * @file mock_main.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief The core's main(), for sketches with setup() and loop(). A program
+ * with its own main() does not link this file in.
+ */
+#include "avr_mock.hpp"
+
+int main()
+{
+    init();
+    setup();
+
+    for (;;)
+    {
+        loop();
+        mockAdvance(MOCK_LOOP_CYCLES);
+    }
+}
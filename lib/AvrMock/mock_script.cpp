@@ -0,0 +1,199 @@
+/**
+ * @file mock_script.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Timed inputs from a command file, for scripted runs of the native
+ * build
+ *
+ * When AVR_MOCK_INPUT names a file, mockStart() passes it to mockScript() and
+ * its commands drive the run. It is the
+ * command format of tools/simbench/simbench.c, so tools/port_trace.py runs the
+ * same scenarios on the host as under simavr. Times are wall cycles:
+ *
+ *   stop <cycle>
+ *   keypad <rows> <cols>            4 row and 4 column pins, like D0D7D6D4
+ *   trace <B|C|D> <mask>            pins of the port to trace
+ *   at <cycle> pin <port> <bit> <0|1>
+ *   at <cycle> adc <channel> <millivolts>
+ *   at <cycle> key <row> <col>      hold a key; row -1 releases it
+ *   at <cycle> uart <hex bytes>
+ *   at <cycle> mark <name>
+ *
+ * Other lines, like the harness's mcu, loop and isr, are ignored.
+ */
+#include <stdio.h>
+#include <algorithm>
+#include <deque>
+#include <string>
+// after the standard library, which Arduino's min() and max() macros break
+#include "avr_mock.hpp"
+
+/**
+ * @brief An input, applied when wall time reaches its cycle
+ */
+struct ScriptInput
+{
+    unsigned long long at;
+    std::string kind;
+    std::string args;
+};
+
+// constructed before mockStart() fills it
+static std::deque<ScriptInput> inputs __attribute__((init_priority(101)));
+
+/**
+ * @brief Port of a port letter
+ *
+ * @return int MockPort, or -1
+ */
+static int portOf(char name)
+{
+    const char *found = name ? strchr("BCD", name) : nullptr;
+    return found ? found - "BCD" : -1;
+}
+
+/**
+ * @brief Pins written as port letter and bit, four in a row: D0D7D6D4
+ *
+ * @return true if all four are valid
+ */
+static bool parsePins(const char *text, MockPin *pins)
+{
+    if (strlen(text) != 8)
+    {
+        return false;
+    }
+
+    for (uint8_t i = 0; i < 4; ++i)
+    {
+        int port = portOf(text[2 * i]);
+        int bit = text[2 * i + 1] - '0';
+        if (port < 0 || bit < 0 || bit > 7)
+        {
+            return false;
+        }
+        pins[i] = {(MockPort)port, (uint8_t)bit};
+    }
+    return true;
+}
+
+static void apply(const ScriptInput &input)
+{
+    const char *args = input.args.c_str();
+
+    if (input.kind == "pin")
+    {
+        char port;
+        int bit, level;
+        if (sscanf(args, " %c %d %d", &port, &bit, &level) == 3 && portOf(port) >= 0)
+        {
+            mockDrive((MockPort)portOf(port), bit, level);
+        }
+    }
+    else if (input.kind == "adc")
+    {
+        int channel, millivolts;
+        if (sscanf(args, "%d %d", &channel, &millivolts) == 2)
+        {
+            mockSetAnalog(channel, constrain(millivolts * 1024L / 5000, 0, 1023));
+        }
+    }
+    else if (input.kind == "key")
+    {
+        int row, col;
+        if (sscanf(args, "%d %d", &row, &col) == 2)
+        {
+            mockHoldKey(row, col);
+        }
+    }
+    else if (input.kind == "uart")
+    {
+        unsigned int byte;
+        int length;
+        while (sscanf(args, "%2x%n", &byte, &length) == 1)
+        {
+            uint8_t data = byte;
+            mockSerialInput(&data, 1);
+            args += length;
+        }
+    }
+    else if (input.kind == "mark")
+    {
+        mockMark(args);
+    }
+}
+
+/**
+ * @brief Apply the inputs that are due and wait for the next one
+ */
+static void applyDue()
+{
+    while (!inputs.empty() && inputs.front().at <= mockWallCycles())
+    {
+        apply(inputs.front());
+        inputs.pop_front();
+    }
+
+    if (!inputs.empty())
+    {
+        mockAt(inputs.front().at, applyDue);
+    }
+}
+
+/**
+ * @brief Read a command file and schedule its inputs
+ *
+ * @param path
+ */
+void mockScript(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        perror(path);
+        exit(1);
+    }
+
+    char line[512];
+    while (fgets(line, sizeof(line), file))
+    {
+        line[strcspn(line, "\n")] = '\0';
+
+        char kind[8], rows[16], cols[16], port;
+        unsigned long long cycle;
+        unsigned int mask;
+        int length;
+        MockPin rowPins[4], colPins[4];
+
+        if (sscanf(line, "stop %llu", &cycle) == 1)
+        {
+            mockRunFor(cycle);
+        }
+        else if (sscanf(line, "keypad %15s %15s", rows, cols) == 2)
+        {
+            if (!parsePins(rows, rowPins) || !parsePins(cols, colPins))
+            {
+                fprintf(stderr, "avr_mock: bad keypad pins: %s\n", line);
+                exit(1);
+            }
+            mockKeypad(rowPins, colPins);
+        }
+        else if (sscanf(line, "trace %c %u", &port, &mask) == 2 && portOf(port) >= 0)
+        {
+            mockTraceMask((MockPort)portOf(port), mask);
+        }
+        else if (sscanf(line, "at %llu %7s %n", &cycle, kind, &length) == 2)
+        {
+            inputs.push_back({cycle, kind, line + length});
+        }
+    }
+    fclose(file);
+
+    // the file is sorted, but a stable sort keeps it working if it is not
+    std::stable_sort(inputs.begin(), inputs.end(),
+                     [](const ScriptInput &a, const ScriptInput &b) { return a.at < b.at; });
+
+    if (!inputs.empty())
+    {
+        mockAt(inputs.front().at, applyDue);
+    }
+}
@@ -0,0 +1,370 @@
+/**
+ * @file bin_log.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Definition of the interrupt driven UART logger
+ */
+#include "bin_log.hpp"
+
+BinLog binlog;
+
+// longest record: header, id, then a delta and three arguments of 5 bytes each
+const uint8_t MAX_RECORD = 2 + 5 * (1 + BINLOG_MAX_ARGS);
+
+/**
+ * @brief Write a value as an LEB128 varint, 7 bits per byte, low bits first
+ *
+ * @param out
+ * @param value
+ * @return uint8_t bytes written
+ */
+static uint8_t putVarint(uint8_t *out, uint32_t value)
+{
+    uint8_t length = 0;
+
+    while (value >= 0x80)
+    {
+        out[length++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    out[length++] = value;
+
+    return length;
+}
+
+/**
+ * @brief Set up USART0 at the given baud rate, 8N1, with U2X
+ *
+ * @param baud
+ */
+void BinLog::begin(unsigned long baud)
+{
+    uint16_t ubrr = (F_CPU / 8 + baud / 2) / baud - 1;
+
+    UBRR0H = ubrr >> 8;
+    UBRR0L = ubrr;
+    UCSR0A = (1 << U2X0);
+    UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);
+    UCSR0B = (1 << RXEN0) | (1 << TXEN0) | (1 << RXCIE0);
+
+    this->lastStamp = micros();
+}
+
+/**
+ * @brief Log an event with no arguments
+ *
+ * @param event event id, 1-255
+ * @return true if the record was queued, false if it was dropped
+ */
+bool BinLog::log(uint8_t event)
+{
+    return record(event, 0, nullptr);
+}
+
+/**
+ * @brief Log an event with one argument
+ *
+ * @param event
+ * @param a
+ * @return true if the record was queued, false if it was dropped
+ */
+bool BinLog::log(uint8_t event, uint32_t a)
+{
+    return record(event, 1, &a);
+}
+
+/**
+ * @brief Log an event with two arguments
+ *
+ * @param event
+ * @param a
+ * @param b
+ * @return true if the record was queued, false if it was dropped
+ */
+bool BinLog::log(uint8_t event, uint32_t a, uint32_t b)
+{
+    uint32_t args[] = {a, b};
+    return record(event, 2, args);
+}
+
+/**
+ * @brief Log an event with three arguments
+ *
+ * @param event
+ * @param a
+ * @param b
+ * @param c
+ * @return true if the record was queued, false if it was dropped
+ */
+bool BinLog::log(uint8_t event, uint32_t a, uint32_t b, uint32_t c)
+{
+    uint32_t args[] = {a, b, c};
+    return record(event, 3, args);
+}
+
+/**
+ * @brief Number of records dropped since begin()
+ *
+ * @return uint16_t
+ */
+uint16_t BinLog::dropped() const
+{
+    return this->totalDrops;
+}
+
+/**
+ * @brief True while anything is queued or still shifting out, so the caller
+ * must not power down yet
+ *
+ * @return true
+ * @return false
+ */
+bool BinLog::isBusy() const
+{
+    return this->txHead != this->txTail || (this->sending && !(UCSR0A & (1 << TXC0)));
+}
+
+/**
+ * @brief Bytes received and not read yet
+ *
+ * @return int
+ */
+int BinLog::available()
+{
+    return (uint8_t)(this->rxHead - this->rxTail) & (BINLOG_RX_SIZE - 1);
+}
+
+/**
+ * @brief Read one received byte
+ *
+ * @return int byte, or -1 if none
+ */
+int BinLog::read()
+{
+    if (this->rxHead == this->rxTail)
+    {
+        return -1;
+    }
+
+    uint8_t c = this->rxBuffer[this->rxTail];
+    this->rxTail = (this->rxTail + 1) & (BINLOG_RX_SIZE - 1);
+    return c;
+}
+
+/**
+ * @brief Look at the next received byte without reading it
+ *
+ * @return int byte, or -1 if none
+ */
+int BinLog::peek()
+{
+    if (this->rxHead == this->rxTail)
+    {
+        return -1;
+    }
+
+    return this->rxBuffer[this->rxTail];
+}
+
+/**
+ * @brief Queue one text character. Waits for room while interrupts are on,
+ * drops it otherwise. Bytes 0x80 and up start records, so they go out as '?'.
+ *
+ * @param c
+ * @return size_t 1 if queued
+ */
+size_t BinLog::write(uint8_t c)
+{
+    if (c & 0x80)
+    {
+        c = '?';
+    }
+
+    while (txFree() == 0)
+    {
+        if (!(SREG & (1 << SREG_I)))
+        {
+            return 0;
+        }
+    }
+
+    uint8_t oldSREG = SREG;
+    cli();
+    push(&c, 1);
+    SREG = oldSREG;
+
+    return 1;
+}
+
+/**
+ * @brief Wait until everything queued has been sent
+ *
+ */
+void BinLog::flush()
+{
+    while (isBusy())
+    {
+    }
+}
+
+/**
+ * @brief Queue a record, preceded by a BINLOG_DROPPED record if any were
+ * dropped. Safe to call from interrupts.
+ *
+ * @param event
+ * @param argc
+ * @param args
+ * @return true if the record was queued
+ */
+bool BinLog::record(uint8_t event, uint8_t argc, const uint32_t *args)
+{
+    uint8_t data[2 * MAX_RECORD];
+
+    // micros() can miss a Timer0 overflow with interrupts off, so stamp first
+    unsigned long stamp = micros();
+
+    uint8_t oldSREG = SREG;
+    cli();
+
+    // timestamps are deltas in queue order; an interrupt that logged after
+    // the stamp above is queued first, so never go back in time
+    if ((long)(stamp - this->lastStamp) < 0)
+    {
+        stamp = this->lastStamp;
+    }
+    uint32_t delta = stamp - this->lastStamp;
+    uint8_t length = 0;
+
+    if (this->pendingDrops)
+    {
+        uint32_t drops = this->pendingDrops;
+        length = encode(data, BINLOG_DROPPED, delta, 1, &drops);
+        delta = 0;
+    }
+    length += encode(data + length, event, delta, argc, args);
+
+    bool queued = length <= txFree();
+    if (queued)
+    {
+        push(data, length);
+        this->lastStamp = stamp;
+        this->pendingDrops = 0;
+    }
+    else
+    {
+        if (this->pendingDrops < 0xFFFF)
+        {
+            ++this->pendingDrops;
+        }
+        if (this->totalDrops < 0xFFFF)
+        {
+            ++this->totalDrops;
+        }
+    }
+
+    SREG = oldSREG;
+    return queued;
+}
+
+/**
+ * @brief Encode one record
+ *
+ * @param out at least MAX_RECORD bytes
+ * @param event
+ * @param delta microseconds since the previous record
+ * @param argc
+ * @param args
+ * @return uint8_t bytes written
+ */
+uint8_t BinLog::encode(uint8_t *out, uint8_t event, uint32_t delta, uint8_t argc, const uint32_t *args)
+{
+    uint8_t length = 0;
+
+    out[length++] = 0x80 | argc;
+    out[length++] = event;
+    length += putVarint(out + length, delta);
+
+    for (uint8_t arg = 0; arg < argc; ++arg)
+    {
+        length += putVarint(out + length, args[arg]);
+    }
+
+    return length;
+}
+
+/**
+ * @brief Free bytes in the transmit buffer. Call with interrupts off.
+ *
+ * @return uint8_t
+ */
+uint8_t BinLog::txFree() const
+{
+    return (uint8_t)(this->txTail - this->txHead - 1) & (BINLOG_TX_SIZE - 1);
+}
+
+/**
+ * @brief Copy bytes into the transmit buffer and start the UDRE interrupt.
+ * Call with interrupts off and room checked.
+ *
+ * @param data
+ * @param length
+ */
+void BinLog::push(const uint8_t *data, uint8_t length)
+{
+    uint8_t head = this->txHead;
+
+    for (uint8_t i = 0; i < length; ++i)
+    {
+        this->txBuffer[head] = data[i];
+        head = (head + 1) & (BINLOG_TX_SIZE - 1);
+    }
+
+    this->txHead = head;
+    UCSR0B |= (1 << UDRIE0);
+}
+
+/**
+ * @brief Send the next byte, or stop the interrupt when the buffer is empty
+ *
+ */
+void binLogTransmit()
+{
+    if (binlog.txHead == binlog.txTail)
+    {
+        UCSR0B &= ~(1 << UDRIE0);
+        return;
+    }
+
+    // clear TXC so isBusy() sees this byte until it has shifted out
+    UCSR0A = (UCSR0A & ((1 << U2X0) | (1 << MPCM0))) | (1 << TXC0);
+    UDR0 = binlog.txBuffer[binlog.txTail];
+    binlog.txTail = (binlog.txTail + 1) & (BINLOG_TX_SIZE - 1);
+    binlog.sending = true;
+}
+
+/**
+ * @brief Store a received byte, dropping it if the buffer is full
+ *
+ */
+void binLogReceive()
+{
+    uint8_t c = UDR0;
+    uint8_t next = (binlog.rxHead + 1) & (BINLOG_RX_SIZE - 1);
+
+    if (next != binlog.rxTail)
+    {
+        binlog.rxBuffer[binlog.rxHead] = c;
+        binlog.rxHead = next;
+    }
+}
+
+// ISR for the USART data register empty interrupt
+ISR(USART_UDRE_vect)
+{
+    binLogTransmit();
+}
+
+// ISR for USART receive complete
+ISR(USART_RX_vect)
+{
+    binLogReceive();
+}
@@ -0,0 +1,83 @@
+/**
+ * @file bin_log.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Interrupt driven UART logger with compact binary records
+ */
+#ifndef BIN_LOG_HPP
+#define BIN_LOG_HPP
+
+#include <Arduino.h>
+
+#ifndef BINLOG_BAUD
+#define BINLOG_BAUD 500000 // exact at 16 MHz with U2X
+#endif
+
+const uint8_t BINLOG_TX_SIZE = 128; // bytes, power of two
+const uint8_t BINLOG_RX_SIZE = 32;  // bytes, power of two
+const uint8_t BINLOG_DROPPED = 0;   // event id of the "records dropped" record
+const uint8_t BINLOG_MAX_ARGS = 3;
+
+/**
+ * @brief Logger that owns USART0, use it in place of Serial.
+ *
+ * log() encodes an event id, the microseconds since the previous record and
+ * up to three arguments into a RAM ring buffer, and the UDRE interrupt sends
+ * it. A record is a header byte 0x80 | argument count, the event id, then the
+ * time delta and the arguments as LEB128 varints, so most records are 4-8
+ * bytes. log() never waits: when the buffer is full the record is counted as
+ * dropped, and a BINLOG_DROPPED record with the count goes out once there is
+ * room again.
+ *
+ * Text printed through the Stream interface goes out as plain 7-bit ASCII
+ * between records, so command replies still read as text. Text waits for room
+ * in the buffer like Serial does, so keep it off hot paths.
+ *
+ * tools/binlog_decode.py turns the stream back into text using the event
+ * list of the project.
+ */
+class BinLog : public Stream
+{
+public:
+    void begin(unsigned long baud = BINLOG_BAUD);
+
+    bool log(uint8_t event);
+    bool log(uint8_t event, uint32_t a);
+    bool log(uint8_t event, uint32_t a, uint32_t b);
+    bool log(uint8_t event, uint32_t a, uint32_t b, uint32_t c);
+
+    uint16_t dropped() const;
+    bool isBusy() const;
+
+    int available() override;
+    int read() override;
+    int peek() override;
+    size_t write(uint8_t c) override;
+    void flush() override;
+    using Print::write;
+
+    friend void binLogTransmit();
+    friend void binLogReceive();
+
+private:
+    bool record(uint8_t event, uint8_t argc, const uint32_t *args);
+    uint8_t encode(uint8_t *out, uint8_t event, uint32_t delta, uint8_t argc, const uint32_t *args);
+    uint8_t txFree() const;
+    void push(const uint8_t *data, uint8_t length);
+
+    volatile uint8_t txBuffer[BINLOG_TX_SIZE];
+    volatile uint8_t txHead = 0; // next byte to write
+    volatile uint8_t txTail = 0; // next byte to send
+    volatile bool sending = false; // a byte went out since the buffer last ran dry
+
+    volatile uint8_t rxBuffer[BINLOG_RX_SIZE];
+    volatile uint8_t rxHead = 0;
+    volatile uint8_t rxTail = 0;
+
+    unsigned long lastStamp = 0; // micros() of the last record
+    uint16_t pendingDrops = 0;   // dropped since the last BINLOG_DROPPED record
+    uint16_t totalDrops = 0;
+};
+
+extern BinLog binlog;
+
+#endif // BIN_LOG_HPP
@@ -0,0 +1,346 @@
+/**
+ * @file config_store.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Definition of the EEPROM backed configuration store
+ */
+#include "config_store.hpp"
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <stdlib.h>
+
+/**
+ * @brief Construct a new Config Store Base:: Config Store Base object
+ *
+ * @param shadow RAM copy of the values, already holding the defaults
+ * @param size size of the values in bytes
+ * @param version layout version, bump when the struct changes
+ * @param fields field table, must be in PROGMEM
+ * @param count number of fields
+ */
+ConfigStoreBase::ConfigStoreBase(void *shadow, uint8_t size, uint8_t version, const ConfigField *fields, uint8_t count)
+    : shadow((uint8_t *)shadow), size(size), version(version), fields(fields), count(count)
+{
+}
+
+/**
+ * @brief Load the values from the newest valid EEPROM image. The defaults are
+ * kept if neither image is there, from this layout version and passes its
+ * CRC.
+ *
+ */
+void ConfigStoreBase::begin()
+{
+    bool found = false;
+
+    for (uint8_t image = 0; image < CONFIG_IMAGES; ++image)
+    {
+        const uint8_t *base = (const uint8_t *)CONFIG_EEPROM_BASE + image * CONFIG_IMAGE_SIZE;
+        uint8_t imageSequence = eeprom_read_byte(base);
+
+        // sequence numbers wrap, so compare by signed difference
+        if ((!found || (int8_t)(imageSequence - this->sequence) > 0) && readImage(image))
+        {
+            found = true;
+            this->sequence = imageSequence;
+            this->writeImage = (image + 1) % CONFIG_IMAGES;
+        }
+    }
+}
+
+/**
+ * @brief Load the values from one image if it is valid
+ *
+ * @param image 0 to CONFIG_IMAGES - 1
+ * @return true if the shadow was loaded
+ */
+bool ConfigStoreBase::readImage(uint8_t image)
+{
+    const uint8_t *base = (const uint8_t *)CONFIG_EEPROM_BASE + image * CONFIG_IMAGE_SIZE;
+
+    if (eeprom_read_byte(base + 1) != this->version || eeprom_read_byte(base + 2) != this->size)
+    {
+        return false;
+    }
+
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 0; i < this->size + 3; ++i)
+    {
+        crc = _crc_ccitt_update(crc, eeprom_read_byte(base + i));
+    }
+
+    uint16_t stored = eeprom_read_byte(base + this->size + 3) | (eeprom_read_byte(base + this->size + 4) << 8);
+    if (crc != stored)
+    {
+        return false;
+    }
+
+    eeprom_read_block(this->shadow, base + 3, this->size);
+    return true;
+}
+
+/**
+ * @brief Write back pending changes. Call from loop(). Writes at most one byte
+ * per call and returns at once if the EEPROM is busy.
+ *
+ */
+void ConfigStoreBase::service()
+{
+    if (!this->dirty || millis() - this->lastChange < CONFIG_WRITE_DELAY)
+    {
+        return;
+    }
+
+    if (this->writePos == 0)
+    {
+        this->writeCrc = imageCrc();
+    }
+
+    uint8_t oldSREG = SREG;
+    cli();
+
+    // other EEPROM users may write from interrupts, so check and start the
+    // write with interrupts off
+    if (!(EECR & (1 << EEPE)))
+    {
+        uint8_t data = imageByte(this->writePos);
+
+        EEAR = CONFIG_EEPROM_BASE + this->writeImage * CONFIG_IMAGE_SIZE + this->writePos;
+        EECR |= (1 << EERE);
+        if (EEDR != data)
+        {
+            EEDR = data;
+            EECR |= (1 << EEMPE);
+            EECR |= (1 << EEPE);
+        }
+
+        if (++this->writePos == imageSize())
+        {
+            // the image is complete once its CRC is written, and the other
+            // one is now the older
+            this->writePos = 0;
+            this->dirty = false;
+            ++this->sequence;
+            this->writeImage = (this->writeImage + 1) % CONFIG_IMAGES;
+        }
+    }
+
+    SREG = oldSREG;
+}
+
+/**
+ * @brief Read serial commands without blocking. Call from loop().
+ *
+ *   c                 list every key and value
+ *   c <key> <value>   set a value
+ *
+ * @param serial
+ * @param other called with any other line, so a sketch can add its own commands
+ * @return true if a value was set
+ */
+bool ConfigStoreBase::poll(Stream &serial, void (*other)(const char *line, Stream &serial))
+{
+    bool set = false;
+
+    while (serial.available() > 0)
+    {
+        char c = serial.read();
+
+        if (c == '\n' || c == '\r')
+        {
+            if (this->lineLength > 0)
+            {
+                this->line[this->lineLength] = '\0';
+                this->lineLength = 0;
+
+                if (this->line[0] == 'c')
+                {
+                    set |= command();
+
+                    for (uint8_t key = 0; key < this->count; ++key)
+                    {
+                        serial.print(key);
+                        serial.print('=');
+                        serial.println(getField(key));
+                    }
+                }
+                else if (other)
+                {
+                    other(this->line, serial);
+                }
+            }
+        }
+        else if (this->lineLength < sizeof(this->line) - 1)
+        {
+            this->line[this->lineLength++] = c;
+        }
+    }
+
+    return set;
+}
+
+/**
+ * @brief Apply a "c <key> <value>" command line, if it has a key and value
+ *
+ * @return true if a value was set
+ */
+bool ConfigStoreBase::command()
+{
+    char *end;
+    unsigned long key = strtoul(this->line + 1, &end, 10);
+
+    if (end == this->line + 1)
+    {
+        return false;
+    }
+
+    char *valueStart = end;
+    unsigned long value = strtoul(valueStart, &end, 10);
+
+    return end != valueStart && setField(key, value);
+}
+
+/**
+ * @brief Set a value by key
+ *
+ * @param key index into the field table
+ * @param value truncated to the size of the field
+ * @return true if the key exists
+ */
+bool ConfigStoreBase::setField(uint8_t key, uint32_t value)
+{
+    if (key >= this->count)
+    {
+        return false;
+    }
+
+    uint8_t offset = pgm_read_byte(&this->fields[key].offset);
+    uint8_t fieldSize = pgm_read_byte(&this->fields[key].size);
+
+    // little endian, like the values in the struct; bytes past the 32 bits of
+    // value are zero, for fields wider than on the AVR in a native build
+    for (uint8_t i = 0; i < fieldSize; ++i)
+    {
+        this->shadow[offset + i] = i < sizeof(value) ? value >> (8 * i) : 0;
+    }
+
+    changed();
+    return true;
+}
+
+/**
+ * @brief Get a value by key
+ *
+ * @param key index into the field table
+ * @return uint32_t value, or 0 if the key does not exist
+ */
+uint32_t ConfigStoreBase::getField(uint8_t key) const
+{
+    if (key >= this->count)
+    {
+        return 0;
+    }
+
+    uint8_t offset = pgm_read_byte(&this->fields[key].offset);
+    uint8_t fieldSize = pgm_read_byte(&this->fields[key].size);
+    uint32_t value = 0;
+
+    for (uint8_t i = 0; i < fieldSize && i < sizeof(value); ++i)
+    {
+        value |= (uint32_t)this->shadow[offset + i] << (8 * i);
+    }
+
+    return value;
+}
+
+/**
+ * @brief Number of keys in the field table
+ *
+ * @return uint8_t
+ */
+uint8_t ConfigStoreBase::fieldCount() const
+{
+    return this->count;
+}
+
+/**
+ * @brief Check if changes are waiting to be written to EEPROM
+ *
+ * @return true
+ * @return false
+ */
+bool ConfigStoreBase::isDirty() const
+{
+    return this->dirty;
+}
+
+/**
+ * @brief Note a change to the shadow. Restarts the write back, so a burst of
+ * changes costs one EEPROM pass.
+ *
+ */
+void ConfigStoreBase::changed()
+{
+    this->dirty = true;
+    this->writePos = 0;
+    this->lastChange = millis();
+}
+
+/**
+ * @brief Size of an EEPROM image: sequence, version, size, values and CRC
+ *
+ * @return uint8_t
+ */
+uint8_t ConfigStoreBase::imageSize() const
+{
+    return this->size + CONFIG_IMAGE_OVERHEAD;
+}
+
+/**
+ * @brief Byte of the EEPROM image for the current shadow, with the sequence
+ * after the newest image's
+ *
+ * @param index
+ * @return uint8_t
+ */
+uint8_t ConfigStoreBase::imageByte(uint8_t index) const
+{
+    if (index == 0)
+    {
+        return this->sequence + 1;
+    }
+
+    if (index == 1)
+    {
+        return this->version;
+    }
+
+    if (index == 2)
+    {
+        return this->size;
+    }
+
+    if (index < this->size + 3)
+    {
+        return this->shadow[index - 3];
+    }
+
+    return index == this->size + 3 ? this->writeCrc : this->writeCrc >> 8;
+}
+
+/**
+ * @brief CRC-16 of the sequence, version, size and values of the image for
+ * the current shadow
+ *
+ * @return uint16_t
+ */
+uint16_t ConfigStoreBase::imageCrc() const
+{
+    uint16_t crc = 0xFFFF;
+
+    for (uint8_t i = 0; i < this->size + 3; ++i)
+    {
+        crc = _crc_ccitt_update(crc, imageByte(i));
+    }
+
+    return crc;
+}
@@ -0,0 +1,114 @@
+/**
+ * @file config_store.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Typed configuration kept in EEPROM with a RAM shadow copy
+ */
+#ifndef CONFIG_STORE_HPP
+#define CONFIG_STORE_HPP
+
+#include <Arduino.h>
+#include <avr/pgmspace.h>
+
+const uint16_t CONFIG_EEPROM_SIZE = 128;                             // bytes reserved at the top of EEPROM
+const uint16_t CONFIG_EEPROM_BASE = E2END + 1 - CONFIG_EEPROM_SIZE;  // first byte of the first config image
+const uint8_t CONFIG_IMAGES = 2;                                     // images written in turn
+const uint8_t CONFIG_IMAGE_SIZE = CONFIG_EEPROM_SIZE / CONFIG_IMAGES; // bytes reserved per image
+const uint8_t CONFIG_IMAGE_OVERHEAD = 5;                             // sequence, version, size and CRC
+const unsigned long CONFIG_WRITE_DELAY = 2000;                       // ms without changes before writing back
+
+/**
+ * @brief Offset and size of one config value, indexed by its key
+ */
+struct ConfigField
+{
+    uint8_t offset;
+    uint8_t size; // 1, 2 or 4 bytes, unsigned
+};
+
+// field table entry for member of struct type
+#define CONFIG_FIELD(type, member) {offsetof(type, member), sizeof(((type *)0)->member)}
+
+/**
+ * @brief Untyped part of ConfigStore. Handles the EEPROM images, each of which
+ * is a sequence number, version, size, the values and a CRC-16 over all of
+ * them. A write back goes to the older image, so a reset part way through it
+ * leaves the newer one to load at boot.
+ */
+class ConfigStoreBase
+{
+public:
+    void begin();
+    void service();
+    bool poll(Stream &serial, void (*other)(const char *line, Stream &serial) = nullptr);
+
+    bool setField(uint8_t key, uint32_t value);
+    uint32_t getField(uint8_t key) const;
+    uint8_t fieldCount() const;
+    bool isDirty() const;
+
+protected:
+    ConfigStoreBase(void *shadow, uint8_t size, uint8_t version, const ConfigField *fields, uint8_t count);
+    void changed();
+
+private:
+    uint8_t imageSize() const;
+    uint8_t imageByte(uint8_t index) const;
+    uint16_t imageCrc() const;
+    bool readImage(uint8_t image);
+    bool command();
+
+    uint8_t *shadow;
+    uint8_t size;
+    uint8_t version;
+    const ConfigField *fields; // in PROGMEM
+    uint8_t count;
+
+    // lazy write back
+    bool dirty = false;
+    uint8_t sequence = 0;    // sequence of the newest image in EEPROM
+    uint8_t writeImage = 0;  // image the next write back goes to, the older one
+    uint8_t writePos = 0;
+    uint16_t writeCrc = 0;
+    unsigned long lastChange = 0;
+
+    // serial command line
+    char line[24];
+    uint8_t lineLength = 0;
+};
+
+/**
+ * @brief Configuration of type T. values() reads the RAM shadow, so a value is
+ * one load on the hot path. set() changes the shadow and the EEPROM copy is
+ * written later by service(), after changes have stopped for
+ * CONFIG_WRITE_DELAY, one byte per call so the caller never waits on EEPROM.
+ *
+ * @tparam T plain struct of config values
+ */
+template <typename T>
+class ConfigStore : public ConfigStoreBase
+{
+public:
+    template <uint8_t N>
+    ConfigStore(const T &defaults, uint8_t version, const ConfigField (&fields)[N])
+        : ConfigStoreBase(&shadow, sizeof(T), version, fields, N), shadow(defaults)
+    {
+        static_assert(sizeof(T) + CONFIG_IMAGE_OVERHEAD <= CONFIG_IMAGE_SIZE, "config does not fit in CONFIG_IMAGE_SIZE");
+    }
+
+    const T &values() const
+    {
+        return shadow;
+    }
+
+    template <typename V>
+    void set(V T::*member, V value)
+    {
+        shadow.*member = value;
+        changed();
+    }
+
+private:
+    T shadow;
+};
+
+#endif // CONFIG_STORE_HPP
@@ -0,0 +1,116 @@
+/**
+ * @file coroutine.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Stackless coroutines (protothreads) for long running sequences
+ */
+#ifndef COROUTINE_HPP
+#define COROUTINE_HPP
+
+#include <Arduino.h>
+#include "atomic.hpp"
+
+// tick source of CO_AWAIT_TICKS, in milliseconds like the scheduler tick
+#ifndef CO_TICKS
+#define CO_TICKS() millis()
+#endif
+
+/**
+ * @brief What a coroutine step returned
+ */
+enum CoStatus : uint8_t
+{
+    CO_WAITING, // stopped at an await, call again
+    CO_DONE,    // ran to CO_END, the next call starts over
+};
+
+/**
+ * @brief Resume point and timer of one coroutine, 6 bytes
+ *
+ * A coroutine is a function that takes its Coroutine and returns CoStatus,
+ * with its body between CO_BEGIN and CO_END. Each call runs it from the last
+ * await to the next one, so a blocking loop keeps its shape but returns
+ * instead of waiting. The resume point is a switch case label (Duff's device),
+ * so locals do not survive an await: keep state in members or statics, and do
+ * not await inside a switch statement of your own.
+ */
+struct Coroutine
+{
+    uint16_t line = 0;        // __LINE__ of the await to resume at, 0 at the start
+    unsigned long wakeAt = 0; // CO_TICKS() value CO_AWAIT_TICKS waits for
+
+    void reset()
+    {
+        line = 0;
+    }
+
+    bool isRunning() const
+    {
+        return line != 0;
+    }
+};
+
+/**
+ * @brief Flag an interrupt or another coroutine raises and CO_AWAIT_EVENT
+ * waits for. Signals that come before the wait are kept, several signals
+ * count once.
+ */
+struct CoEvent
+{
+    Atomic<bool> pending;
+
+    void signal()
+    {
+        pending.store(true);
+    }
+
+    bool take()
+    {
+        return pending.exchange(false);
+    }
+};
+
+#define CO_BEGIN(co) \
+    switch ((co).line) \
+    { \
+    case 0:
+
+#define CO_END(co) \
+    } \
+    (co).line = 0; \
+    return CO_DONE
+
+// return until cond is true, then carry on. The first pass falls through into
+// its own case label; the attribute, not [[fallthrough]], so C++11 builds take it
+#define CO_AWAIT(co, cond) \
+    do \
+    { \
+        (co).line = __LINE__; \
+        __attribute__((fallthrough)); \
+    case __LINE__: \
+        if (!(cond)) \
+        { \
+            return CO_WAITING; \
+        } \
+    } while (0)
+
+// return until n ticks have passed
+#define CO_AWAIT_TICKS(co, n) \
+    do \
+    { \
+        (co).wakeAt = CO_TICKS() + (n); \
+        CO_AWAIT(co, (long)(CO_TICKS() - (co).wakeAt) >= 0); \
+    } while (0)
+
+// return until the CoEvent e is signalled, and clear it
+#define CO_AWAIT_EVENT(co, e) CO_AWAIT(co, (e).take())
+
+// give the other coroutines a turn
+#define CO_YIELD(co) \
+    do \
+    { \
+        (co).line = __LINE__; \
+        return CO_WAITING; \
+    case __LINE__:; \
+    } while (0)
+
+#endif // COROUTINE_HPP
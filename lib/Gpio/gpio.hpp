@@ -0,0 +1,190 @@
+/**
+ * @file gpio.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Typed pins and pin groups on the ATmega328P I/O ports
+ *
+ * A pin is a type, Pin<PortB, 3>, not a number, so a pin can only be used on
+ * the port it belongs to and every mask is known at compile time. Single pin
+ * operations compile to one SBI, CBI, SBIS/SBIC or OUT instruction.
+ */
+#ifndef GPIO_HPP
+#define GPIO_HPP
+
+#include <Arduino.h>
+
+/**
+ * @brief Registers of I/O port B, C and D. The return types follow the
+ * register declarations, so the mock registers of a native build fit too.
+ */
+struct PortB
+{
+    static auto pin() -> decltype((PINB)) { return PINB; }
+    static auto ddr() -> decltype((DDRB)) { return DDRB; }
+    static auto port() -> decltype((PORTB)) { return PORTB; }
+};
+
+struct PortC
+{
+    static auto pin() -> decltype((PINC)) { return PINC; }
+    static auto ddr() -> decltype((DDRC)) { return DDRC; }
+    static auto port() -> decltype((PORTC)) { return PORTC; }
+};
+
+struct PortD
+{
+    static auto pin() -> decltype((PIND)) { return PIND; }
+    static auto ddr() -> decltype((DDRD)) { return DDRD; }
+    static auto port() -> decltype((PORTD)) { return PORTD; }
+};
+
+/**
+ * @brief Mask of a list of bits
+ */
+constexpr uint8_t pinMask()
+{
+    return 0;
+}
+
+template <typename... BITS>
+constexpr uint8_t pinMask(uint8_t bit, BITS... bits)
+{
+    return (1 << bit) | pinMask(bits...);
+}
+
+constexpr bool pinsValid()
+{
+    return true;
+}
+
+template <typename... BITS>
+constexpr bool pinsValid(uint8_t bit, BITS... bits)
+{
+    return bit < 8 && pinsValid(bits...);
+}
+
+/**
+ * @brief Several pins of one port, read and written together
+ *
+ * write() stores to PINx, where a 1 toggles the pin and a 0 leaves it, so the
+ * other pins of the port are never written and an interrupt changing them
+ * cannot be undone. The group's own pins must not change between the read of
+ * PORTx and the store.
+ *
+ * @tparam PORT PortB, PortC or PortD
+ * @tparam BITS pin numbers in the port
+ */
+template <typename PORT, uint8_t... BITS>
+struct PinGroup
+{
+    static constexpr uint8_t MASK = pinMask(BITS...);
+    static_assert(sizeof...(BITS) > 0, "a pin group needs at least one pin");
+    static_assert(pinsValid(BITS...), "ports have 8 pins");
+
+    /**
+     * @brief Make the pins outputs
+     */
+    static void output()
+    {
+        if (MASK == 0xFF)
+        {
+            PORT::ddr() = 0xFF;
+        }
+        else
+        {
+            PORT::ddr() |= MASK;
+        }
+    }
+
+    /**
+     * @brief Make the pins inputs, leaving the pull-ups as they are
+     */
+    static void input()
+    {
+        if (MASK == 0xFF)
+        {
+            PORT::ddr() = 0;
+        }
+        else
+        {
+            PORT::ddr() &= ~MASK;
+        }
+    }
+
+    /**
+     * @brief Make the pins inputs with pull-ups
+     */
+    static void pullUp()
+    {
+        input();
+        set();
+    }
+
+    static void set() { PORT::port() |= MASK; }
+    static void clear() { PORT::port() &= ~MASK; }
+
+    /**
+     * @brief Set the group's pins to value, in port bit positions; bits outside
+     * the group are ignored
+     *
+     * @param value
+     */
+    static void write(uint8_t value)
+    {
+        if (MASK == 0xFF)
+        {
+            PORT::port() = value;
+        }
+        else
+        {
+            PORT::pin() = (PORT::port() ^ value) & MASK;
+        }
+    }
+
+    /**
+     * @brief Toggle every pin of the group in one store
+     */
+    static void toggle() { PORT::pin() = MASK; }
+
+    /**
+     * @brief Input levels of the group's pins, in port bit positions
+     *
+     * @return uint8_t
+     */
+    static uint8_t read() { return PORT::pin() & MASK; }
+};
+
+/**
+ * @brief One pin
+ *
+ * @tparam PORT PortB, PortC or PortD
+ * @tparam BIT pin number in the port
+ */
+template <typename PORT, uint8_t BIT>
+struct Pin : PinGroup<PORT, BIT>
+{
+    using Port = PORT;
+    static constexpr uint8_t NUMBER = BIT;
+
+    static void write(bool high)
+    {
+        if (high)
+        {
+            PORT::port() |= PinGroup<PORT, BIT>::MASK;
+        }
+        else
+        {
+            PORT::port() &= ~PinGroup<PORT, BIT>::MASK;
+        }
+    }
+
+    /**
+     * @brief Toggle the pin. SBI on PINx toggles just that pin on the
+     * ATmega328P, so this is one atomic instruction.
+     */
+    static void toggle() { PORT::pin() |= PinGroup<PORT, BIT>::MASK; }
+
+    static bool isHigh() { return PORT::pin() & PinGroup<PORT, BIT>::MASK; }
+    static bool isLow() { return !isHigh(); }
+};
+
+#endif // GPIO_HPP
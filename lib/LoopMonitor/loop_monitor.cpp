@@ -0,0 +1,224 @@
+/**
+ * @file loop_monitor.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Definition of the loop period monitor
+ */
+#include "loop_monitor.hpp"
+
+LoopMonitor loopMonitor;
+
+/**
+ * @brief log2 of a period, in a few shifts instead of a bit at a time
+ *
+ * @param period us
+ * @return uint8_t 0 to LOOP_BUCKETS - 1
+ */
+static uint8_t bucketOf(unsigned long period)
+{
+    if (period >> LOOP_BUCKETS)
+    {
+        return LOOP_BUCKETS - 1;
+    }
+
+    uint16_t value = period;
+    uint8_t bucket = 0;
+    if (value & 0xFF00)
+    {
+        bucket = 8;
+        value >>= 8;
+    }
+    if (value & 0xF0)
+    {
+        bucket += 4;
+        value >>= 4;
+    }
+    if (value & 0x0C)
+    {
+        bucket += 2;
+        value >>= 2;
+    }
+    if (value & 0x02)
+    {
+        bucket += 1;
+    }
+
+    return bucket < LOOP_BUCKETS ? bucket : LOOP_BUCKETS - 1;
+}
+
+/**
+ * @brief Set the deadline and clear the histogram
+ *
+ * @param budget longest expected time between two loop() entries, in us
+ */
+void LoopMonitor::begin(unsigned long budget)
+{
+    this->budget = budget;
+    reset();
+}
+
+/**
+ * @brief Stamp a loop() entry with micros(). Call first thing in loop().
+ *
+ */
+void LoopMonitor::tick()
+{
+    tick(micros());
+}
+
+/**
+ * @brief Stamp a loop() entry with another clock, for a project where
+ * micros() does not run
+ *
+ * @param now us
+ */
+void LoopMonitor::tick(unsigned long now)
+{
+    if (this->started)
+    {
+        unsigned long period = now - this->last;
+
+        ++this->buckets[bucketOf(period)];
+
+        if (period > this->budget)
+        {
+            ++this->missCount;
+        }
+
+        if (period > this->longest)
+        {
+            this->longest = period;
+        }
+    }
+    else
+    {
+        this->started = true;
+        this->lastReport = now;
+    }
+
+    this->last = now;
+}
+
+/**
+ * @brief Iterations that fell into a bucket
+ *
+ * @param bucket
+ * @return unsigned long
+ */
+unsigned long LoopMonitor::count(uint8_t bucket) const
+{
+    return this->buckets[bucket];
+}
+
+/**
+ * @brief Iterations longer than the budget
+ *
+ * @return unsigned long
+ */
+unsigned long LoopMonitor::misses() const
+{
+    return this->missCount;
+}
+
+/**
+ * @brief Longest iteration
+ *
+ * @return unsigned long us
+ */
+unsigned long LoopMonitor::worst() const
+{
+    return this->longest;
+}
+
+/**
+ * @brief Clear the counts. The next tick() only stamps, so the time spent
+ * until then is not counted.
+ *
+ */
+void LoopMonitor::reset()
+{
+    for (uint8_t bucket = 0; bucket < LOOP_BUCKETS; ++bucket)
+    {
+        this->buckets[bucket] = 0;
+    }
+    this->missCount = 0;
+    this->longest = 0;
+    this->started = false;
+}
+
+/**
+ * @brief Print the non-empty buckets, the misses and the longest iteration
+ *
+ * @param out
+ */
+void LoopMonitor::print(Print &out) const
+{
+    out.println(F("loop period us: count"));
+
+    for (uint8_t bucket = 0; bucket < LOOP_BUCKETS; ++bucket)
+    {
+        if (this->buckets[bucket])
+        {
+            out.print(bucket ? 1UL << bucket : 0);
+            if (bucket == LOOP_BUCKETS - 1)
+            {
+                out.print(F("+"));
+            }
+            else
+            {
+                out.print('-');
+                out.print((2UL << bucket) - 1);
+            }
+            out.print(F(": "));
+            out.println(this->buckets[bucket]);
+        }
+    }
+
+    out.print(F("over "));
+    out.print(this->budget);
+    out.print(F(" us: "));
+    out.print(this->missCount);
+    out.print(F(", worst "));
+    out.println(this->longest);
+}
+
+/**
+ * @brief Serial command "l": print the histogram and start a new one
+ *
+ * @param line command line
+ * @param out
+ * @return true if the line was the command
+ */
+bool LoopMonitor::command(const char *line, Print &out)
+{
+    if (line[0] != 'l')
+    {
+        return false;
+    }
+
+    print(out);
+    reset();
+    return true;
+}
+
+/**
+ * @brief Print the histogram every LOOP_MONITOR_REPORT ms and start a new one,
+ * for projects whose UART pins do other things. Does nothing unless
+ * LOOP_MONITOR_REPORT is defined. Call from loop() after tick().
+ *
+ */
+void LoopMonitor::report()
+{
+#ifdef LOOP_MONITOR_REPORT
+    if (!this->started || this->last - this->lastReport < LOOP_MONITOR_REPORT * 1000UL)
+    {
+        return;
+    }
+
+    Serial.begin(LOOP_MONITOR_BAUD);
+    print(Serial);
+    Serial.flush();
+    Serial.end(); // give the RX and TX pins back
+
+    reset();
+#endif
+}
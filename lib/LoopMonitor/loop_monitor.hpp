@@ -0,0 +1,54 @@
+/**
+ * @file loop_monitor.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Histogram of loop() periods and a count of missed deadlines
+ */
+#ifndef LOOP_MONITOR_HPP
+#define LOOP_MONITOR_HPP
+
+#include <Arduino.h>
+
+const uint8_t LOOP_BUCKETS = 16; // bucket n: periods of 2^n to 2^(n+1) - 1 us, the last one is open ended
+
+#ifndef LOOP_MONITOR_BAUD
+#define LOOP_MONITOR_BAUD 115200 // report() baud rate
+#endif
+
+/**
+ * @brief Stamps each loop() entry and sorts the time since the last one into a
+ * log2 histogram, counting the periods over budget as missed deadlines. A
+ * tick() costs a micros() call and a few dozen cycles more.
+ *
+ * Projects with a serial console print it with command(). The others call
+ * report() from loop(), which prints it every LOOP_MONITOR_REPORT ms when
+ * that is defined, turning the UART on only while printing.
+ */
+class LoopMonitor
+{
+public:
+    void begin(unsigned long budget);
+    void tick();
+    void tick(unsigned long now);
+
+    unsigned long count(uint8_t bucket) const;
+    unsigned long misses() const;
+    unsigned long worst() const;
+
+    void reset();
+    void print(Print &out) const;
+    bool command(const char *line, Print &out);
+    void report();
+
+private:
+    unsigned long buckets[LOOP_BUCKETS]; // a tight loop fills 16 bits in a second
+    unsigned long missCount = 0;
+    unsigned long budget = 0;      // us per iteration
+    unsigned long last = 0;        // us at the last tick
+    unsigned long longest = 0;     // us
+    unsigned long lastReport = 0;  // us
+    bool started = false;          // last is valid
+};
+
+extern LoopMonitor loopMonitor;
+
+#endif // LOOP_MONITOR_HPP
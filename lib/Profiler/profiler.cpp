@@ -0,0 +1,236 @@
+/**
+ * @file profiler.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Definition of the section profiler
+ */
+#include "profiler.hpp"
+
+Profiler profiler;
+
+#ifdef PROFILE_ENABLE
+
+#include "timing.hpp"
+
+// log2 of the Timer1 prescaler by clock select; external clocks count as 1
+static const uint8_t PRESCALER_SHIFTS[8] = {0, 0, 3, 6, 8, 10, 0, 0};
+
+/**
+ * @brief Find out how Timer1 counts, taking it over if no project code uses
+ * it, and measure the cost of an empty section. Call after the project has
+ * set up its timers.
+ *
+ */
+void Profiler::begin()
+{
+    uint8_t oldSREG = SREG;
+    cli();
+
+    uint8_t clock = TCCR1B & ((1 << CS12) | (1 << CS11) | (1 << CS10));
+    uint8_t mode = (((TCCR1B >> WGM12) & 0x03) << 2) | (TCCR1A & ((1 << WGM11) | (1 << WGM10)));
+
+    // the core's init() leaves Timer1 in 8 bit phase correct PWM at clk/64
+    // for analogWrite(); with no pin and no interrupt on it, nothing uses it
+    bool coreDefault = TCCR1A == (1 << WGM10) && TCCR1B == ((1 << CS11) | (1 << CS10)) && !TIMSK1;
+
+    if (!clock || coreDefault)
+    {
+        CycleStamp::begin();
+        mode = 0;
+    }
+
+    this->usable = true;
+
+    switch (mode)
+    {
+    case 4: // CTC to OCR1A
+    case 15: // fast PWM to OCR1A
+        this->top = OCR1A;
+        break;
+    case 12: // CTC to ICR1
+    case 14: // fast PWM to ICR1
+        this->top = ICR1;
+        break;
+    case 5: // fast PWM, 8 bit
+        this->top = 0x00FF;
+        break;
+    case 6: // fast PWM, 9 bit
+        this->top = 0x01FF;
+        break;
+    case 7: // fast PWM, 10 bit
+        this->top = 0x03FF;
+        break;
+    case 0: // normal
+        this->top = 0;
+        break;
+    default: // phase correct modes count down too, so a difference means nothing
+        this->top = 0;
+        this->usable = false;
+        break;
+    }
+    this->shift = PRESCALER_SHIFTS[TCCR1B & 0x07];
+
+    // the stamps of an empty section, taken the way ProfileScope takes them
+    uint16_t start = now();
+    uint16_t end = now();
+    this->overhead = end - start;
+    if (this->top && end < start)
+    {
+        this->overhead = end + (this->top + 1) - start;
+    }
+
+    SREG = oldSREG;
+
+    reset();
+}
+
+/**
+ * @brief Take a slot for a marker
+ *
+ * @param name in flash
+ * @return uint8_t slot, or NO_PROFILE_SLOT if the table is full
+ */
+uint8_t Profiler::add(const char *name)
+{
+    uint8_t oldSREG = SREG;
+    cli();
+
+    uint8_t slot = NO_PROFILE_SLOT;
+    if (this->count < PROFILE_SECTIONS)
+    {
+        slot = this->count++;
+        this->sections[slot] = {name, 0, 0xFFFF, 0, 0};
+    }
+
+    SREG = oldSREG;
+    return slot;
+}
+
+/**
+ * @brief Timer1 counter
+ *
+ * @return uint16_t
+ */
+uint16_t Profiler::now() const
+{
+    return CycleStamp::now();
+}
+
+/**
+ * @brief Add a run of a section
+ *
+ * @param slot
+ * @param start counter at the entry
+ * @param end counter at the exit
+ */
+void Profiler::record(uint8_t slot, uint16_t start, uint16_t end)
+{
+    if (slot == NO_PROFILE_SLOT || !this->usable)
+    {
+        return;
+    }
+
+    // a counter with a TOP wraps to 0 after TOP, not after 0xFFFF
+    uint16_t ticks = end - start;
+    if (this->top && end < start)
+    {
+        ticks = end + (this->top + 1) - start;
+    }
+    ticks = ticks > this->overhead ? ticks - this->overhead : 0;
+
+    // a section may run in an ISR as well as in loop()
+    uint8_t oldSREG = SREG;
+    cli();
+
+    ProfileSection &section = this->sections[slot];
+    if (section.count != 0xFFFF)
+    {
+        ++section.count;
+        section.sum += ticks;
+    }
+    if (ticks < section.min)
+    {
+        section.min = ticks;
+    }
+    if (ticks > section.max)
+    {
+        section.max = ticks;
+    }
+
+    SREG = oldSREG;
+}
+
+/**
+ * @brief Clear the counters, keeping the sections
+ *
+ */
+void Profiler::reset()
+{
+    uint8_t oldSREG = SREG;
+    cli();
+
+    for (uint8_t slot = 0; slot < this->count; ++slot)
+    {
+        this->sections[slot] = {this->sections[slot].name, 0, 0xFFFF, 0, 0};
+    }
+
+    SREG = oldSREG;
+}
+
+/**
+ * @brief True once every period, for a periodic dump from loop()
+ *
+ * @param period ms
+ * @return true if period has passed since the last time it returned true
+ */
+bool Profiler::due(unsigned long period)
+{
+    unsigned long now = millis();
+    if (now - this->lastPrint < period)
+    {
+        return false;
+    }
+
+    this->lastPrint = now;
+    return true;
+}
+
+/**
+ * @brief Print every section in cycles: runs, min, average and max
+ *
+ * @param out
+ */
+void Profiler::print(Print &out) const
+{
+    if (!this->usable)
+    {
+        out.println(F("profiler: Timer1 is in a phase correct mode, no timings"));
+        return;
+    }
+
+    out.println(F("section runs min avg max (cycles)"));
+
+    for (uint8_t slot = 0; slot < this->count; ++slot)
+    {
+        // copy under cli(), an ISR may be adding to it
+        uint8_t oldSREG = SREG;
+        cli();
+        ProfileSection section = this->sections[slot];
+        SREG = oldSREG;
+
+        out.print(reinterpret_cast<const __FlashStringHelper *>(section.name));
+        out.print(' ');
+        out.print(section.count);
+        if (section.count)
+        {
+            out.print(' ');
+            out.print((uint32_t)section.min << this->shift);
+            out.print(' ');
+            out.print((section.sum / section.count) << this->shift);
+            out.print(' ');
+            out.print((uint32_t)section.max << this->shift);
+        }
+        out.println();
+    }
+}
+
+#endif // PROFILE_ENABLE
@@ -0,0 +1,127 @@
+/**
+ * @file profiler.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Section profiler on the Timer1 counter, compiled in with
+ * -DPROFILE_ENABLE
+ */
+#ifndef PROFILER_HPP
+#define PROFILER_HPP
+
+#include <Arduino.h>
+
+#ifndef PROFILE_SECTIONS
+#define PROFILE_SECTIONS 8 // sections the table can hold, 12 bytes of RAM each
+#endif
+
+const uint8_t NO_PROFILE_SLOT = 0xFF; // marker not in the table yet, or the table is full
+
+#ifdef PROFILE_ENABLE
+
+#define PROFILE_JOIN2(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN2(a, b)
+
+/**
+ * @brief Time from here to the end of the enclosing block as the section
+ * name. Each marker is its own section, even if two share a name. Not for
+ * coroutine bodies, whose case labels cannot jump past the scope object.
+ */
+#define PROFILE(name)                                                                                          \
+    static uint8_t PROFILE_JOIN(profileSlot, __LINE__) = NO_PROFILE_SLOT;                                     \
+    ProfileScope PROFILE_JOIN(profileScope, __LINE__)(PROFILE_JOIN(profileSlot, __LINE__), PSTR(name))
+
+/**
+ * @brief Count, min, max and sum of the Timer1 ticks of one section
+ */
+struct ProfileSection
+{
+    const char *name; // in flash
+    uint16_t count;   // stops at 0xFFFF
+    uint16_t min;
+    uint16_t max;
+    uint32_t sum;
+};
+
+/**
+ * @brief Table of the sections the PROFILE() markers have run through, timed
+ * with the Timer1 counter. If Timer1 is stopped, or still as the core's
+ * init() left it for analogWrite() with no pin using it, begin() runs it free
+ * at one tick per cycle, for sections up to 4 ms at 16 MHz. If the project
+ * already runs it in normal, CTC or fast PWM mode, the profiler shares it: a
+ * tick is then the project's prescaler and a section must end within one
+ * period. In a phase correct mode the counter runs down as well as up, so
+ * nothing is recorded and print() says so.
+ *
+ * Results are dumped with print(), on request or every so often with due().
+ */
+class Profiler
+{
+public:
+    void begin();
+    uint8_t add(const char *name);
+    uint16_t now() const;
+    void record(uint8_t slot, uint16_t start, uint16_t end);
+
+    void reset();
+    bool due(unsigned long period);
+    void print(Print &out) const;
+
+private:
+    ProfileSection sections[PROFILE_SECTIONS];
+    uint8_t count = 0;     // sections in use
+    uint16_t top = 0;      // Timer1 TOP, 0 when it wraps at 0xFFFF
+    uint8_t shift = 0;     // log2 of the Timer1 prescaler
+    uint16_t overhead = 0; // ticks of an empty section
+    bool usable = false;   // Timer1 counts up only, set by begin()
+    unsigned long lastPrint = 0;
+};
+
+extern Profiler profiler;
+
+/**
+ * @brief Stamps the entry in its constructor and records the section in its
+ * destructor. Made by PROFILE().
+ */
+class ProfileScope
+{
+public:
+    ProfileScope(uint8_t &slot, const char *name)
+    {
+        if (slot == NO_PROFILE_SLOT)
+        {
+            slot = profiler.add(name);
+        }
+        this->slot = slot;
+        this->start = profiler.now();
+    }
+
+    ~ProfileScope()
+    {
+        profiler.record(this->slot, this->start, profiler.now());
+    }
+
+private:
+    uint8_t slot;
+    uint16_t start;
+};
+
+#else
+
+#define PROFILE(name)
+
+/**
+ * @brief Stand-in without PROFILE_ENABLE, every call compiles to nothing
+ */
+class Profiler
+{
+public:
+    void begin() {}
+    void reset() {}
+    bool due(unsigned long) { return false; }
+    void print(Print &) const {}
+};
+
+extern Profiler profiler;
+
+#endif // PROFILE_ENABLE
+
+#endif // PROFILER_HPP
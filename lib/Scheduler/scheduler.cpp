@@ -0,0 +1,171 @@
+/**
+ * @file scheduler.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Definition of the time-triggered scheduler
+ */
+#include "scheduler.hpp"
+#include <avr/sleep.h>
+#include "timer_config.hpp"
+
+// Timer2 settings of the tick
+using TickConfig = TimerConfig<2, SCHEDULER_TICK_HZ>;
+
+Scheduler scheduler;
+
+/**
+ * @brief Start the 1 kHz tick: Timer2 in CTC mode
+ *
+ */
+void Scheduler::begin()
+{
+    uint8_t oldSREG = SREG;
+    cli();
+
+    TCCR2A = (1 << WGM21);
+    TCCR2B = TickConfig::CLOCK_SELECT;
+    OCR2A = TickConfig::TOP;
+    TCNT2 = 0;
+    TIMSK2 = (1 << OCIE2A);
+
+    this->tickCount.write(0);
+    this->processed = 0;
+
+    SREG = oldSREG;
+}
+
+/**
+ * @brief Add a task
+ *
+ * @param function called once per release
+ * @param period ticks between releases
+ * @param offset tick of the first release, counting the first tick as 0, to
+ * keep tasks with the same period from landing on the same tick
+ * @return uint8_t task number, or NO_SCHEDULED_TASK if the table is full
+ */
+uint8_t Scheduler::addTask(TaskFunction function, uint16_t period, uint16_t offset)
+{
+    if (this->count == SCHEDULER_TASKS)
+    {
+        return NO_SCHEDULED_TASK;
+    }
+
+    uint8_t task = this->count++;
+    this->functions[task] = function;
+    this->periods[task] = period ? period : 1;
+    this->countdowns[task] = offset + 1;
+    this->overrunCounts[task] = 0;
+
+    return task;
+}
+
+/**
+ * @brief Change the period of a task, from its next release on
+ *
+ * @param task
+ * @param period ticks between releases
+ */
+void Scheduler::setPeriod(uint8_t task, uint16_t period)
+{
+    this->periods[task] = period ? period : 1;
+}
+
+/**
+ * @brief Run every released task once, or idle until the next tick if none
+ * is released. Call from loop().
+ *
+ */
+void Scheduler::run()
+{
+    release();
+
+    if (!this->ready)
+    {
+        // sleep only if no tick came in since release(); sei() lets
+        // sleep_cpu() run before any interrupt, so a tick cannot be missed
+        set_sleep_mode(SLEEP_MODE_IDLE);
+        cli();
+        if (this->tickCount.read() == this->processed)
+        {
+            sleep_enable();
+            sei();
+            sleep_cpu();
+            sleep_disable();
+        }
+        sei();
+        return;
+    }
+
+    for (uint8_t task = 0; task < this->count; ++task)
+    {
+        if (this->ready & (1 << task))
+        {
+            this->ready &= ~(1 << task);
+            this->functions[task]();
+        }
+    }
+}
+
+/**
+ * @brief Ticks since begin()
+ *
+ * @return unsigned long
+ */
+unsigned long Scheduler::ticks() const
+{
+    return this->tickCount.read();
+}
+
+/**
+ * @brief Releases of a task that came before its previous release ran
+ *
+ * @param task
+ * @return uint16_t
+ */
+uint16_t Scheduler::overruns(uint8_t task) const
+{
+    return this->overrunCounts[task];
+}
+
+/**
+ * @brief Count down every task for each tick since the last call and release
+ * the ones that reach zero
+ *
+ */
+void Scheduler::release()
+{
+    unsigned long now = ticks();
+
+    while (this->processed != now)
+    {
+        ++this->processed;
+
+        for (uint8_t task = 0; task < this->count; ++task)
+        {
+            if (--this->countdowns[task] == 0)
+            {
+                this->countdowns[task] = this->periods[task];
+
+                if (this->ready & (1 << task))
+                {
+                    ++this->overrunCounts[task];
+                }
+                this->ready |= (1 << task);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Count one tick
+ *
+ */
+void schedulerTick()
+{
+    scheduler.tickCount.write(scheduler.tickCount.read() + 1);
+}
+
+// ISR for the Timer2 compare match, the scheduler tick
+ISR(TIMER2_COMPA_vect)
+{
+    schedulerTick();
+}
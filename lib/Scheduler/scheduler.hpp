@@ -0,0 +1,58 @@
+/**
+ * @file scheduler.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Cooperative time-triggered scheduler on a 1 kHz Timer2 tick
+ */
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <Arduino.h>
+#include "atomic.hpp"
+
+const uint8_t SCHEDULER_TASKS = 8;         // tasks the scheduler can hold
+const uint16_t SCHEDULER_TICK_HZ = 1000;   // one tick per millisecond
+const uint8_t NO_SCHEDULED_TASK = 0xFF;    // addTask() result when the table is full
+
+using TaskFunction = void (*)();
+
+/**
+ * @brief Time-triggered cooperative scheduler. Timer2 ticks once a millisecond
+ * and the tick interrupt only counts. run(), called from loop(), releases each
+ * task whose period has come up and calls the released tasks in the order they
+ * were added, each to completion. With nothing released it idles the CPU until
+ * the next tick.
+ *
+ * A task released again before its last release ran has overrun; the release
+ * is merged and counted in overruns(). Tasks must not block: anything that
+ * used to wait in a delay loop becomes a task, or a step of one, that runs
+ * when its time comes.
+ */
+class Scheduler
+{
+public:
+    void begin();
+    uint8_t addTask(TaskFunction function, uint16_t period, uint16_t offset = 0);
+    void setPeriod(uint8_t task, uint16_t period);
+    void run();
+
+    unsigned long ticks() const;
+    uint16_t overruns(uint8_t task) const;
+
+    friend void schedulerTick();
+
+private:
+    void release();
+
+    TaskFunction functions[SCHEDULER_TASKS];
+    uint16_t periods[SCHEDULER_TASKS];       // ticks between releases
+    uint16_t countdowns[SCHEDULER_TASKS];    // ticks until the next release
+    uint16_t overrunCounts[SCHEDULER_TASKS];
+    uint8_t count = 0;                       // tasks added
+    uint8_t ready = 0;                       // bit n set while task n is released and not run
+    unsigned long processed = 0;             // ticks release() has handled
+    SeqLock<unsigned long> tickCount;        // ticks since begin()
+};
+
+extern Scheduler scheduler;
+
+#endif // SCHEDULER_HPP
@@ -0,0 +1,254 @@
+/**
+ * @file stack_paint.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Definition of the SRAM painting and the incremental scan
+ */
+#include "stack_paint.hpp"
+#include <avr/wdt.h>
+#include "warm_restart.hpp"
+
+StackPaint stackPaint;
+
+/**
+ * @brief Free gap that made resetChip() reset the chip, kept across the reset
+ */
+struct LowMemoryRecord
+{
+    uint16_t gap;
+};
+
+static WarmState<LowMemoryRecord> lowMemoryRecord WARM_NOINIT;
+
+#ifdef __AVR__
+extern uint8_t __heap_start; // first byte past .bss and .noinit
+extern char *__brkval;       // end of the heap, 0 until the first malloc()
+
+void paintSram() __attribute__((naked, used, section(".init3")));
+
+/**
+ * @brief Runs after .init2 has set the stack pointer and cleared r1, and
+ * before anything is pushed, so all of the SRAM above .noinit is free. Being
+ * naked it has no frame of its own; the loop stays in registers.
+ *
+ */
+void paintSram()
+{
+    for (uint8_t *byte = &__heap_start; byte <= (uint8_t *)RAMEND; ++byte)
+    {
+        *byte = STACK_CANARY;
+    }
+}
+#endif
+
+/**
+ * @brief Start scanning from the bottom of the free SRAM and read back a low
+ * memory reset
+ *
+ * @param margin least free gap in bytes before the chip is reset, 0 to never
+ * reset it
+ */
+void StackPaint::begin(uint16_t margin)
+{
+    this->margin = margin;
+
+    this->lowMemory = lowMemoryRecord.restore() && (resetFlags() & (1 << WDRF));
+    lowMemoryRecord.clear();
+
+#ifdef __AVR__
+    this->heapTop = &__heap_start;
+    this->stackEdge = (uint8_t *)RAMEND + 1;
+    this->cursor = this->heapTop;
+#endif
+}
+
+/**
+ * @brief Check the next STACK_SLICE bytes of the gap. Call from loop().
+ *
+ */
+void StackPaint::scan()
+{
+#ifdef __AVR__
+    uint8_t *heapEnd = __brkval ? (uint8_t *)__brkval : &__heap_start;
+    if (heapEnd > this->heapTop)
+    {
+        this->heapTop = heapEnd;
+    }
+    if (this->cursor < this->heapTop)
+    {
+        this->cursor = this->heapTop;
+    }
+
+    // the stack in use right now, whether its frames wrote every byte or not
+    uint8_t *stackPointer = (uint8_t *)SP + 1;
+    if (stackPointer < this->stackEdge)
+    {
+        this->stackEdge = stackPointer;
+    }
+
+    for (uint8_t count = STACK_SLICE; count && this->cursor < this->stackEdge; --count, ++this->cursor)
+    {
+        if (*this->cursor != STACK_CANARY)
+        {
+            this->stackEdge = this->cursor;
+        }
+    }
+
+    if (this->cursor >= this->stackEdge)
+    {
+        this->cursor = this->heapTop;
+        ++this->passes;
+    }
+
+    if (this->margin && freeGap() < this->margin)
+    {
+        resetChip();
+    }
+#endif
+}
+
+/**
+ * @brief Least SRAM left between the heap and the stack since boot
+ *
+ * @return uint16_t bytes
+ */
+uint16_t StackPaint::freeGap() const
+{
+    return this->stackEdge > this->heapTop ? this->stackEdge - this->heapTop : 0;
+}
+
+/**
+ * @brief Deepest the stack has been, as far as the scan has got
+ *
+ * @return uint16_t bytes
+ */
+uint16_t StackPaint::stackPeak() const
+{
+#ifdef __AVR__
+    return (uint8_t *)RAMEND + 1 - this->stackEdge;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief Largest the heap has been
+ *
+ * @return uint16_t bytes
+ */
+uint16_t StackPaint::heapPeak() const
+{
+#ifdef __AVR__
+    return this->heapTop - &__heap_start;
+#else
+    return 0;
+#endif
+}
+
+/**
+ * @brief True if the last reset came from the free gap falling under the
+ * margin
+ *
+ * @return true
+ * @return false
+ */
+bool StackPaint::lowMemoryReset() const
+{
+    return this->lowMemory;
+}
+
+/**
+ * @brief Save the gap and let the watchdog reset the chip, before the stack
+ * writes over the heap or .bss. Reset mode only, so the task supervisor's WDT
+ * interrupt does not blame a task for it.
+ *
+ */
+void StackPaint::resetChip()
+{
+    lowMemoryRecord.data.gap = freeGap();
+    lowMemoryRecord.save();
+
+    cli();
+    wdt_enable(WDTO_15MS);
+    for (;;)
+    {
+    }
+}
+
+/**
+ * @brief Print the free gap, the stack and heap peaks and whether the last
+ * reset was for low memory
+ *
+ * @param out
+ */
+void StackPaint::print(Print &out) const
+{
+    out.print(F("sram free "));
+    out.print(freeGap());
+    out.print(F(" bytes, stack "));
+    out.print(stackPeak());
+    out.print(F(", heap "));
+    out.print(heapPeak());
+    out.print(F(", passes "));
+    out.println(this->passes);
+
+    if (this->lowMemory)
+    {
+        out.print(F("last reset: "));
+        out.print(lowMemoryRecord.data.gap);
+        out.println(F(" bytes free"));
+    }
+}
+
+/**
+ * @brief Serial command "m": print the SRAM high-water marks
+ *
+ * @param line command line
+ * @param out
+ * @return true if the line was the command
+ */
+bool StackPaint::command(const char *line, Print &out)
+{
+    if (line[0] != 'm')
+    {
+        return false;
+    }
+
+    print(out);
+    return true;
+}
+
+/**
+ * @brief Print the marks every STACK_PAINT_REPORT ms, for projects whose UART
+ * pins do other things. Does nothing unless STACK_PAINT_REPORT is defined.
+ *
+ */
+void StackPaint::report()
+{
+#ifdef STACK_PAINT_REPORT
+    report(millis());
+#endif
+}
+
+/**
+ * @brief report() with another clock, for a project where millis() does not
+ * run
+ *
+ * @param now ms
+ */
+void StackPaint::report(unsigned long now)
+{
+#ifdef STACK_PAINT_REPORT
+    if (now - this->lastReport < STACK_PAINT_REPORT)
+    {
+        return;
+    }
+    this->lastReport = now;
+
+    Serial.begin(STACK_PAINT_BAUD);
+    print(Serial);
+    Serial.flush();
+    Serial.end(); // give the RX and TX pins back
+#else
+    (void)now;
+#endif
+}
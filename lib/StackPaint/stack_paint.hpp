@@ -0,0 +1,71 @@
+/**
+ * @file stack_paint.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief High-water marks of the stack and the heap from SRAM painted at boot
+ */
+#ifndef STACK_PAINT_HPP
+#define STACK_PAINT_HPP
+
+#include <Arduino.h>
+
+const uint8_t STACK_CANARY = 0xC5; // painted over the free SRAM at boot
+const uint8_t STACK_SLICE = 16;    // bytes checked per scan()
+
+// margin for begin() that resets the chip before the stack can run into the
+// heap, with room left for an ISR frame and a call or two
+const uint16_t STACK_RESET_MARGIN = 32;
+
+#ifndef STACK_PAINT_BAUD
+#define STACK_PAINT_BAUD 115200 // report() baud rate
+#endif
+
+/**
+ * @brief The startup code paints the SRAM between the end of .bss and the
+ * top of the stack with STACK_CANARY. The heap grows into it from below and
+ * the stack from above, and whatever they reach stops being the canary.
+ * scan() walks the gap up from the heap's peak, STACK_SLICE bytes a call, to
+ * the first byte the stack has written; a pass over the free SRAM takes a few
+ * dozen loop() iterations and a call under 10 us. Both marks only move
+ * inward, so the gap is the least free SRAM since boot.
+ *
+ * With a margin, a gap smaller than it resets the chip through the watchdog
+ * before the stack runs into the heap, and lowMemoryReset() reports it after
+ * the restart. Stack use between two passes is only caught on the next one.
+ *
+ * Projects with a serial console print the marks with command(). The others
+ * call report() from loop(), which prints them every STACK_PAINT_REPORT ms
+ * when that is defined, turning the UART on only while printing.
+ *
+ * The native build has no SRAM layout to paint, so all sizes read 0 there.
+ */
+class StackPaint
+{
+public:
+    void begin(uint16_t margin);
+    void scan();
+
+    uint16_t freeGap() const;
+    uint16_t stackPeak() const;
+    uint16_t heapPeak() const;
+    bool lowMemoryReset() const;
+
+    void print(Print &out) const;
+    bool command(const char *line, Print &out);
+    void report();
+    void report(unsigned long now);
+
+private:
+    void resetChip();
+
+    uint8_t *heapTop = nullptr;  // highest end of the heap seen
+    uint8_t *stackEdge = nullptr; // lowest byte the stack is known to have written
+    uint8_t *cursor = nullptr;   // next byte scan() checks
+    uint16_t margin = 0;         // least free gap before resetChip(), 0 for never
+    uint16_t passes = 0;         // full passes over the gap
+    bool lowMemory = false;      // the last reset was resetChip()
+    unsigned long lastReport = 0; // ms
+};
+
+extern StackPaint stackPaint;
+
+#endif // STACK_PAINT_HPP
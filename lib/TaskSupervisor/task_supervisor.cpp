@@ -0,0 +1,231 @@
+/**
+ * @file task_supervisor.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Definition of the watchdog task supervisor
+ */
+#include "task_supervisor.hpp"
+#include "warm_restart.hpp"
+#include "timer_config.hpp"
+
+/**
+ * @brief Task blamed for a watchdog timeout, written by the WDT interrupt just
+ * before the reset
+ */
+struct SupervisorFailure
+{
+    uint8_t task;
+};
+
+static WarmState<SupervisorFailure> failureRecord WARM_NOINIT;
+
+// supervisor the WDT interrupt reports for
+static TaskSupervisor *activeSupervisor = nullptr;
+
+/**
+ * @brief Read the task blamed for the last reset and start the watchdog in
+ * interrupt and reset mode. Call after addTask().
+ *
+ * @param timeout WDTO_15MS to WDTO_8S
+ */
+void TaskSupervisor::begin(uint8_t timeout)
+{
+    if (failureRecord.restore() && (resetFlags() & (1 << WDRF)))
+    {
+        this->failure = failureRecord.data.task;
+    }
+    failureRecord.clear();
+
+    activeSupervisor = this;
+
+    uint8_t wdtBits = (1 << WDIE) | (1 << WDE) | wdtPrescalerBits(timeout);
+
+    uint8_t oldSREG = SREG;
+    cli();
+    wdt_reset();
+    WDTCSR |= (1 << WDCE) | (1 << WDE);
+    WDTCSR = wdtBits;
+    SREG = oldSREG;
+}
+
+/**
+ * @brief Register a task
+ *
+ * @param task 0 to SUPERVISOR_TASKS - 1
+ * @param period longest time between check-ins in ms, or NO_PERIOD
+ * @param budget longest run from start() to checkIn() in ms
+ */
+void TaskSupervisor::addTask(uint8_t task, uint16_t period, uint16_t budget)
+{
+    this->periods[task] = period;
+    this->budgets[task] = budget;
+    this->checkIns[task].store(millis());
+    this->worstCases[task] = 0;
+    this->tasks |= (1 << task);
+}
+
+/**
+ * @brief Mark the start of a run
+ *
+ * @param task
+ */
+void TaskSupervisor::start(uint8_t task)
+{
+    this->starts[task].store(micros());
+    this->running |= (1 << task);
+}
+
+/**
+ * @brief Heartbeat: mark the end of a run and record its execution time
+ *
+ * @param task
+ */
+void TaskSupervisor::checkIn(uint8_t task)
+{
+    if (this->running & (1 << task))
+    {
+        unsigned long elapsed = micros() - this->starts[task].peek();
+        if (elapsed > this->worstCases[task])
+        {
+            this->worstCases[task] = elapsed;
+        }
+        this->running &= ~(1 << task);
+    }
+
+    this->checkIns[task].store(millis());
+}
+
+/**
+ * @brief Reset the watchdog if no task is late. Call from loop() and from
+ * inside long runs.
+ *
+ * @return true if the watchdog was reset
+ */
+bool TaskSupervisor::service()
+{
+    if (lateTask() != NO_TASK)
+    {
+        return false;
+    }
+
+    wdt_reset();
+
+    // a timeout ran the WDT interrupt, which cleared WDIE, and the loop got
+    // through it: arm the interrupt for the next one and drop its blame, so
+    // a later reset is not put down to it. Setting WDIE needs no WDCE.
+    if (!(WDTCSR & (1 << WDIE)))
+    {
+        WDTCSR |= (1 << WDIE);
+        failureRecord.clear();
+    }
+
+    return true;
+}
+
+/**
+ * @brief First task that is over its budget or has missed its heartbeat
+ *
+ * @return uint8_t task, or NO_TASK
+ */
+uint8_t TaskSupervisor::lateTask() const
+{
+    unsigned long nowMillis = millis();
+    unsigned long nowMicros = micros();
+
+    for (uint8_t task = 0; task < SUPERVISOR_TASKS; ++task)
+    {
+        if (!(this->tasks & (1 << task)))
+        {
+            continue;
+        }
+
+        if ((this->running & (1 << task)) && nowMicros - this->starts[task].peek() > this->budgets[task] * 1000UL)
+        {
+            return task;
+        }
+
+        if (this->periods[task] != NO_PERIOD && nowMillis - this->checkIns[task].peek() > this->periods[task])
+        {
+            return task;
+        }
+    }
+
+    return NO_TASK;
+}
+
+/**
+ * @brief Longest run of a task so far
+ *
+ * @param task
+ * @return unsigned long us
+ */
+unsigned long TaskSupervisor::worstCase(uint8_t task) const
+{
+    return this->worstCases[task];
+}
+
+/**
+ * @brief Task blamed for the watchdog reset that started this run
+ *
+ * @return uint8_t task, or NO_TASK if the last reset was not a watchdog timeout
+ */
+uint8_t TaskSupervisor::lastFailure() const
+{
+    return this->failure;
+}
+
+/**
+ * @brief Print the worst case execution time of every task and the task blamed
+ * for the last watchdog reset
+ *
+ * @param out
+ */
+void TaskSupervisor::print(Print &out) const
+{
+    for (uint8_t task = 0; task < SUPERVISOR_TASKS; ++task)
+    {
+        if (this->tasks & (1 << task))
+        {
+            out.print(F("task "));
+            out.print(task);
+            out.print(F(" worst us "));
+            out.println(this->worstCases[task]);
+        }
+    }
+
+    if (this->failure != NO_TASK)
+    {
+        out.print(F("watchdog reset by task "));
+        out.println(this->failure);
+    }
+}
+
+/**
+ * @brief Save the task to blame for the coming watchdog reset: the first late
+ * task, or else a task stuck inside its run without calling service()
+ *
+ */
+void blameLateTask()
+{
+    TaskSupervisor *supervisor = activeSupervisor;
+    uint8_t task = supervisor->lateTask();
+
+    for (uint8_t running = 0; task == NO_TASK && running < SUPERVISOR_TASKS; ++running)
+    {
+        if (supervisor->running & (1 << running))
+        {
+            task = running;
+        }
+    }
+
+    failureRecord.data.task = task;
+    failureRecord.save();
+}
+
+// ISR for the first WDT timeout, the next one resets the chip
+ISR(WDT_vect)
+{
+    if (activeSupervisor)
+    {
+        blameLateTask();
+    }
+}
@@ -0,0 +1,60 @@
+/**
+ * @file task_supervisor.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Watchdog supervisor that feeds the WDT only while every task is on time
+ */
+#ifndef TASK_SUPERVISOR_HPP
+#define TASK_SUPERVISOR_HPP
+
+#include <Arduino.h>
+#include <avr/wdt.h>
+#include "atomic.hpp"
+
+const uint8_t SUPERVISOR_TASKS = 4; // tasks the supervisor can track
+const uint8_t NO_TASK = 0xFF;       // no task is late
+const uint16_t NO_PERIOD = 0;       // task runs on demand, no heartbeat deadline
+
+/**
+ * @brief Each task marks its runs with start() and checkIn(). A task is late
+ * when a run takes longer than its budget, or when it has not checked in for
+ * longer than its period. service() resets the watchdog only while no task is
+ * late, so a stuck task resets the chip instead of silently adding latency.
+ *
+ * The WDT runs in interrupt and reset mode. The first timeout runs the WDT
+ * interrupt, which saves the task to blame in .noinit RAM; the second one
+ * resets the chip. After the reset lastFailure() names that task. If the loop
+ * gets through the first timeout and service() feeds the watchdog again, it
+ * arms the interrupt again and drops the blame.
+ *
+ * Long operations that are part of a task call service() as they go, so the
+ * watchdog period only has to cover the longest gap between service() calls.
+ */
+class TaskSupervisor
+{
+public:
+    void begin(uint8_t timeout);
+    void addTask(uint8_t task, uint16_t period, uint16_t budget);
+    void start(uint8_t task);
+    void checkIn(uint8_t task);
+    bool service();
+
+    uint8_t lateTask() const;
+    unsigned long worstCase(uint8_t task) const;
+    uint8_t lastFailure() const;
+    void print(Print &out) const;
+
+    friend void blameLateTask();
+
+private:
+    uint16_t periods[SUPERVISOR_TASKS];        // ms between check-ins
+    uint16_t budgets[SUPERVISOR_TASKS];        // ms per run
+    // the WDT interrupt reads these, so they are written whole
+    Atomic<unsigned long> checkIns[SUPERVISOR_TASKS]; // millis() at the last check-in
+    Atomic<unsigned long> starts[SUPERVISOR_TASKS];   // micros() at the start of the running run
+    unsigned long worstCases[SUPERVISOR_TASKS]; // longest run in us
+    uint8_t tasks = 0;                          // bit n set when task n is registered
+    uint8_t running = 0;                        // bit n set while task n is between start() and checkIn()
+    uint8_t failure = NO_TASK;                  // task blamed for the last watchdog reset
+};
+
+#endif // TASK_SUPERVISOR_HPP
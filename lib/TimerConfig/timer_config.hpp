@@ -0,0 +1,143 @@
+/**
+ * @file timer_config.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Compile-time prescaler and TOP calculator for Timer0/1/2 and the WDT
+ */
+#ifndef TIMER_CONFIG_HPP
+#define TIMER_CONFIG_HPP
+
+#include <Arduino.h>
+
+const uint8_t NO_PRESCALER = 0xFF;        // no prescaler reaches the frequency
+const uint32_t TIMER_MAX_ERROR_PPM = 1000; // default limit, 0.1 %
+
+/**
+ * @brief Prescaler of a clock select setting. Timer2 has the extra /32 and
+ * /128 steps.
+ *
+ * @param timer 0, 1 or 2
+ * @param index clock select bits - 1
+ * @return constexpr uint16_t
+ */
+constexpr uint16_t timerPrescaler(uint8_t timer, uint8_t index)
+{
+    return timer == 2 ? (index == 0 ? 1 : index == 1 ? 8 : index == 2 ? 32 : index == 3 ? 64 : index == 4 ? 128 : index == 5 ? 256 : 1024)
+                      : (index == 0 ? 1 : index == 1 ? 8 : index == 2 ? 64 : index == 3 ? 256 : 1024);
+}
+
+constexpr uint8_t timerPrescalerCount(uint8_t timer)
+{
+    return timer == 2 ? 7 : 5;
+}
+
+constexpr uint32_t timerMaxTop(uint8_t timer)
+{
+    return timer == 1 ? 0xFFFF : 0xFF;
+}
+
+/**
+ * @brief Timer counts per period, rounded to nearest
+ */
+constexpr uint32_t timerCounts(uint8_t timer, uint32_t hz, uint8_t index)
+{
+    return (F_CPU + (uint64_t)timerPrescaler(timer, index) * hz / 2) / ((uint64_t)timerPrescaler(timer, index) * hz);
+}
+
+/**
+ * @brief Period error of a setting in parts per million
+ */
+constexpr uint32_t timerErrorPpm(uint8_t timer, uint32_t hz, uint8_t index)
+{
+    return ((uint64_t)timerPrescaler(timer, index) * timerCounts(timer, hz, index) * hz > F_CPU
+                ? (uint64_t)timerPrescaler(timer, index) * timerCounts(timer, hz, index) * hz - F_CPU
+                : F_CPU - (uint64_t)timerPrescaler(timer, index) * timerCounts(timer, hz, index) * hz) *
+           1000000 / F_CPU;
+}
+
+constexpr bool timerFits(uint8_t timer, uint32_t hz, uint8_t index)
+{
+    return timerCounts(timer, hz, index) >= 1 && timerCounts(timer, hz, index) - 1 <= timerMaxTop(timer);
+}
+
+/**
+ * @brief Setting with the lowest error from index on; on a tie the smaller
+ * prescaler wins, for the finer resolution
+ */
+constexpr uint8_t timerBestPrescaler(uint8_t timer, uint32_t hz, uint8_t index = 0, uint8_t best = NO_PRESCALER)
+{
+    return index == timerPrescalerCount(timer)
+               ? best
+               : timerBestPrescaler(timer, hz, index + 1,
+                                    timerFits(timer, hz, index) &&
+                                            (best == NO_PRESCALER || timerErrorPpm(timer, hz, index) < timerErrorPpm(timer, hz, best))
+                                        ? index
+                                        : best);
+}
+
+/**
+ * @brief CTC settings for a periodic interrupt at HZ on timer TIMER, worked
+ * out at compile time. Fails to compile if no prescaler reaches HZ or the
+ * best one is off by more than MAX_ERROR_PPM.
+ *
+ * Load CLOCK_SELECT into the CSn2:0 bits of TCCRnB and TOP into OCRnA.
+ *
+ * @tparam TIMER 0, 1 or 2
+ * @tparam HZ interrupt frequency
+ * @tparam MAX_ERROR_PPM largest period error allowed
+ */
+template <uint8_t TIMER, uint32_t HZ, uint32_t MAX_ERROR_PPM = TIMER_MAX_ERROR_PPM>
+struct TimerConfig
+{
+    static_assert(TIMER <= 2, "the ATmega328P has Timer0, Timer1 and Timer2");
+    static_assert(HZ > 0 && HZ <= F_CPU, "frequency must be between 1 Hz and F_CPU");
+
+    static constexpr uint8_t INDEX = timerBestPrescaler(TIMER, HZ);
+    static_assert(INDEX != NO_PRESCALER, "no prescaler reaches this frequency on this timer");
+
+    static constexpr uint8_t CLOCK_SELECT = INDEX + 1;
+    static constexpr uint16_t PRESCALER = timerPrescaler(TIMER, INDEX);
+    static constexpr uint16_t TOP = INDEX == NO_PRESCALER ? 0 : timerCounts(TIMER, HZ, INDEX) - 1;
+    static constexpr uint32_t ERROR_PPM = INDEX == NO_PRESCALER ? 0 : timerErrorPpm(TIMER, HZ, INDEX);
+    static_assert(ERROR_PPM <= MAX_ERROR_PPM, "timer frequency is off by more than the allowed error");
+};
+
+const uint16_t WDT_BASE_PERIOD = 16; // ms, 2K cycles of the 128 kHz WDT oscillator
+const uint8_t WDT_MAX_PRESCALER = 9; // 8 s
+
+/**
+ * @brief WDTCSR prescaler bits of a 0-9 WDT prescaler; WDP3 is not next to
+ * WDP2:0
+ *
+ * @param prescaler
+ * @return constexpr uint8_t
+ */
+constexpr uint8_t wdtPrescalerBits(uint8_t prescaler)
+{
+    return ((prescaler & 0x08) ? (1 << WDP3) : 0) | (prescaler & 0x07);
+}
+
+/**
+ * @brief Largest WDT prescaler whose period is at most ms
+ */
+constexpr uint8_t wdtPrescalerFor(unsigned long ms, uint8_t prescaler = 0)
+{
+    return prescaler < WDT_MAX_PRESCALER && (uint32_t)WDT_BASE_PERIOD << (prescaler + 1) <= ms
+               ? wdtPrescalerFor(ms, prescaler + 1)
+               : prescaler;
+}
+
+/**
+ * @brief WDT settings for a period of MS milliseconds. The WDT only has
+ * 16 ms << n periods, so MS must be one of them.
+ *
+ * @tparam MS
+ */
+template <uint16_t MS>
+struct WdtConfig
+{
+    static constexpr uint8_t PRESCALER = wdtPrescalerFor(MS);
+    static constexpr uint8_t BITS = wdtPrescalerBits(PRESCALER);
+    static_assert((uint32_t)WDT_BASE_PERIOD << PRESCALER == MS, "WDT periods are 16 ms << 0-9");
+};
+
+#endif // TIMER_CONFIG_HPP
@@ -0,0 +1,139 @@
+/**
+ * @file timing.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Cycle exact compile-time delays and a Timer1 timestamp
+ */
+#ifndef TIMING_HPP
+#define TIMING_HPP
+
+#include <Arduino.h>
+
+#ifndef F_CPU
+#error "F_CPU must be defined for cycle exact delays"
+#endif
+
+static_assert(F_CPU % 1000000UL == 0, "timing assumes a whole number of CPU cycles per microsecond");
+
+const uint32_t CYCLES_PER_US = F_CPU / 1000000UL;
+
+/**
+ * @brief CPU cycles needed to wait at least ns nanoseconds
+ *
+ * @param ns
+ * @return constexpr uint32_t
+ */
+constexpr uint32_t nanosToCycles(uint32_t ns)
+{
+    return ((uint64_t)ns * CYCLES_PER_US + 999) / 1000;
+}
+
+/**
+ * @brief Nanoseconds taken by a number of CPU cycles, rounded down
+ *
+ * @param cycles
+ * @return constexpr uint32_t
+ */
+constexpr uint32_t cyclesToNanos(uint32_t cycles)
+{
+    return (uint64_t)cycles * 1000 / CYCLES_PER_US;
+}
+
+/**
+ * @brief Busy-wait exactly the cycles for NS nanoseconds, rounded up to a
+ * whole cycle. Fails to compile if rounding would stretch the delay by more
+ * than a quarter, i.e. the delay is too short for F_CPU.
+ *
+ * @tparam NS
+ */
+template <uint32_t NS>
+inline void delayNanos()
+{
+    static_assert(NS > 0, "delay must be at least one nanosecond");
+    static_assert((cyclesToNanos(nanosToCycles(NS)) - NS) * 4 <= NS, "delay is too short to meet at this F_CPU");
+
+    __builtin_avr_delay_cycles(nanosToCycles(NS));
+}
+
+/**
+ * @brief Busy-wait exactly US microseconds. Anything near a second or more
+ * belongs to a timer or a coroutine, not a busy-wait.
+ *
+ * @tparam US
+ */
+template <uint32_t US>
+inline void delayMicros()
+{
+    static_assert(US > 0, "delay must be at least one microsecond");
+    static_assert(US <= 1000000UL, "use a timer or a coroutine for delays over a second");
+
+    __builtin_avr_delay_cycles(US * CYCLES_PER_US);
+}
+
+/**
+ * @brief Timer1 clock select bits for the timestamp
+ */
+enum StampClock : uint8_t
+{
+    STAMP_CLK_1 = (1 << CS10),                // one tick per cycle, wraps in 4.1 ms at 16 MHz
+    STAMP_CLK_8 = (1 << CS11),                // 0.5 us ticks at 16 MHz, wraps in 32.8 ms
+    STAMP_CLK_64 = (1 << CS11) | (1 << CS10), // 4 us ticks at 16 MHz, wraps in 262 ms
+};
+
+/**
+ * @brief 16-bit timestamp read straight from Timer1 running free. Reading it
+ * costs a few cycles, needs no interrupt and keeps counting with interrupts
+ * off, so it can stamp events inside ISRs and critical sections where
+ * micros() would miss its overflow. Differences of two stamps are exact as
+ * long as they are less than one wrap apart.
+ *
+ * Timer1 is taken over, so this does not mix with a project that uses Timer1
+ * for something else.
+ *
+ * @tparam Clock StampClock
+ */
+template <uint8_t Clock>
+class Timer1Stamp
+{
+public:
+    static constexpr uint8_t SHIFT = Clock == STAMP_CLK_1 ? 0 : Clock == STAMP_CLK_8 ? 3 : 6; // log2 of the prescaler
+
+    static void begin()
+    {
+        // normal mode, no interrupts
+        TCCR1A = 0;
+        TCCR1B = Clock;
+        TIMSK1 = 0;
+    }
+
+    static uint16_t now()
+    {
+        // the two byte read goes through the shared TEMP register, so keep
+        // an interrupt that reads Timer1 from splitting it
+        uint8_t oldSREG = SREG;
+        cli();
+        uint16_t stamp = TCNT1;
+        SREG = oldSREG;
+
+        return stamp;
+    }
+
+    static constexpr uint32_t toCycles(uint16_t ticks)
+    {
+        return (uint32_t)ticks << SHIFT;
+    }
+
+    static constexpr uint32_t toNanos(uint16_t ticks)
+    {
+        return cyclesToNanos(toCycles(ticks));
+    }
+
+    static constexpr uint16_t fromMicros(uint16_t us)
+    {
+        return ((uint32_t)us * CYCLES_PER_US) >> SHIFT;
+    }
+};
+
+using CycleStamp = Timer1Stamp<STAMP_CLK_1>;
+using FastStamp = Timer1Stamp<STAMP_CLK_8>;
+
+#endif // TIMING_HPP
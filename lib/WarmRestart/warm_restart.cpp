@@ -0,0 +1,96 @@
+/**
+ * @file warm_restart.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Definition of the reset cause capture and the warm state CRC
+ */
+#include "warm_restart.hpp"
+#include <avr/wdt.h>
+#include <util/crc16.h>
+
+// MCUSR at boot; .bss is cleared after .init3, so it lives in .noinit
+static uint8_t bootFlags WARM_NOINIT;
+
+#ifdef __AVR__
+void captureResetFlags() __attribute__((naked, used, section(".init3")));
+#else
+// a native build has no .init3, so run before the constructors instead
+void captureResetFlags() __attribute__((constructor(103)));
+#endif
+
+/**
+ * @brief Runs before .bss is cleared and before any constructor. Saves the
+ * reset cause, clears MCUSR and stops the watchdog, which stays enabled at the
+ * shortest period after a watchdog reset and would otherwise reset the chip
+ * again before setup() runs.
+ *
+ * A bootloader may have cleared MCUSR already. Optiboot 8.0 and later pass its
+ * value in r2, which is read only when the build defines OPTIBOOT_PASSES_MCUSR.
+ * The optiboot 4.4 the Uno ships with passes nothing, so there an MCUSR of 0
+ * leaves the cause unknown.
+ *
+ */
+void captureResetFlags()
+{
+    // r2 first, before the compiler can use it for anything else
+#if defined(__AVR__) && defined(OPTIBOOT_PASSES_MCUSR)
+    uint8_t passed;
+    __asm__ __volatile__("mov %0, r2" : "=r"(passed));
+#else
+    uint8_t passed = 0;
+#endif
+
+    uint8_t flags = MCUSR;
+    if (flags == 0)
+    {
+        flags = passed;
+    }
+
+    bootFlags = flags;
+    MCUSR = 0;
+    wdt_disable();
+}
+
+/**
+ * @brief MCUSR as it was at boot
+ *
+ * @return uint8_t PORF, EXTRF, BORF and WDRF bits, 0 if the bootloader cleared
+ * them without passing them on
+ */
+uint8_t resetFlags()
+{
+    return bootFlags;
+}
+
+/**
+ * @brief True if the last reset was only a watchdog or brown-out reset, so
+ * .noinit RAM may still hold the state from before it. False when the cause
+ * is unknown.
+ *
+ * @return true
+ * @return false
+ */
+bool isWarmReset()
+{
+    return (bootFlags & ((1 << WDRF) | (1 << BORF))) && !(bootFlags & ((1 << PORF) | (1 << EXTRF)));
+}
+
+/**
+ * @brief CRC-16 of a state block, seeded with its size so a zeroed block does
+ * not pass
+ *
+ * @param data
+ * @param size
+ * @return uint16_t
+ */
+uint16_t warmCrc(const void *data, uint8_t size)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint16_t crc = 0xFFFF ^ size;
+
+    for (uint8_t i = 0; i < size; ++i)
+    {
+        crc = _crc_ccitt_update(crc, bytes[i]);
+    }
+
+    return crc;
+}
@@ -0,0 +1,66 @@
+/**
+ * @file warm_restart.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Runtime state that survives a watchdog or brown-out reset
+ */
+#ifndef WARM_RESTART_HPP
+#define WARM_RESTART_HPP
+
+#include <Arduino.h>
+
+// place a variable in RAM the startup code does not clear; it must not have an
+// initializer or a constructor
+#ifdef __AVR__
+#define WARM_NOINIT __attribute__((section(".noinit")))
+#else
+// a native build starts with cleared RAM, as after a power-on reset
+#define WARM_NOINIT
+#endif
+
+uint8_t resetFlags();
+bool isWarmReset();
+uint16_t warmCrc(const void *data, uint8_t size);
+
+/**
+ * @brief State block kept in .noinit RAM with a CRC-16 over it. After a
+ * watchdog or brown-out reset RAM still holds the block, so restore() can hand
+ * it back and setup() can skip its slow cold start. After a power-on or
+ * external reset, or if the CRC fails, restore() returns false and the caller
+ * starts from its defaults.
+ *
+ * The reset cause comes from MCUSR, which the optiboot 4.4 on a stock Uno
+ * clears before the sketch starts. With that bootloader the cause reads as
+ * unknown and restore() returns false, which also turns off the reports of
+ * the task supervisor and StackPaint. Warm restarts need optiboot 8.0 or
+ * later, which passes MCUSR in r2, and -DOPTIBOOT_PASSES_MCUSR in build_flags.
+ *
+ * Declare it at file scope with WARM_NOINIT and call save() whenever data
+ * changes.
+ *
+ * @tparam T plain struct with no constructor
+ */
+template <typename T>
+struct WarmState
+{
+    static_assert(__has_trivial_constructor(T), "warm state must not have a constructor");
+
+    T data;
+    uint16_t crc;
+
+    bool restore() const
+    {
+        return isWarmReset() && crc == warmCrc(&data, sizeof(T));
+    }
+
+    void save()
+    {
+        crc = warmCrc(&data, sizeof(T));
+    }
+
+    void clear()
+    {
+        crc = ~warmCrc(&data, sizeof(T));
+    }
+};
+
+#endif // WARM_RESTART_HPP
@@ -0,0 +1,134 @@
+#!/usr/bin/env python3
+"""Decode the BinLog stream from lib/BinLog back into text.
+
+Records are a header byte 0x80 | argc, the event id, then the microseconds
+since the previous record and argc arguments as LEB128 varints. Bytes below
+0x80 are plain text from the Stream interface and are passed through.
+
+Event formats come from the project's log_events.hpp, one per line:
+
+    EVT_NAME = <id>, // "printf style format"
+
+usage:
+    binlog_decode.py --events include/log_events.hpp /dev/ttyACM0
+    binlog_decode.py --events include/log_events.hpp capture.bin
+"""
+import argparse
+import os
+import re
+import sys
+
+DEFAULT_BAUD = 500000
+DROPPED = 0
+
+EVENT_LINE = re.compile(r'^\s*(\w+)\s*=\s*(\d+)\s*,?\s*//\s*"(.*)"')
+
+
+def load_events(paths):
+    """Map event id to (name, format) from the given headers."""
+    events = {DROPPED: ('BINLOG_DROPPED', 'BinLog dropped %u records')}
+    for path in paths:
+        with open(path) as header:
+            for line in header:
+                match = EVENT_LINE.match(line)
+                if match:
+                    name, number, fmt = match.groups()
+                    events[int(number)] = (name, fmt)
+    return events
+
+
+def format_event(events, event, args):
+    """Fill in an event's format, falling back to the raw values."""
+    if event not in events:
+        return 'unknown event %d %s' % (event, args)
+
+    name, fmt = events[event]
+    # the firmware sends unsigned values; %u is not a Python conversion
+    fmt = fmt.replace('%lu', '%d').replace('%u', '%d')
+    try:
+        return fmt % tuple(args)
+    except (TypeError, ValueError):
+        return '%s %s' % (name, args)
+
+
+class Decoder:
+    """Byte at a time decoder, so it works on a live port."""
+
+    def __init__(self, events, out):
+        self.events = events
+        self.out = out
+        self.time = 0
+        self.text = ''
+        self.record = None
+
+    def feed(self, data):
+        for byte in data:
+            if self.record is not None:
+                self.record_byte(byte)
+            elif byte & 0x80:
+                self.record = {'argc': byte & 0x07, 'event': None, 'values': [], 'value': 0, 'shift': 0}
+            elif byte == ord('\n'):
+                self.emit(self.text.rstrip('\r'))
+                self.text = ''
+            else:
+                self.text += chr(byte)
+
+    def record_byte(self, byte):
+        record = self.record
+        if record['event'] is None:
+            record['event'] = byte
+            return
+
+        record['value'] |= (byte & 0x7F) << record['shift']
+        record['shift'] += 7
+        if byte & 0x80:
+            return
+
+        record['values'].append(record['value'])
+        record['value'] = 0
+        record['shift'] = 0
+
+        # the delta comes first, then the arguments
+        if len(record['values']) == record['argc'] + 1:
+            self.time += record['values'][0]
+            self.emit(format_event(self.events, record['event'], record['values'][1:]))
+            self.record = None
+
+    def emit(self, line):
+        self.out.write('[%12.6f] %s\n' % (self.time / 1e6, line))
+        self.out.flush()
+
+
+def open_source(path, baud):
+    """A capture file, or a serial port through pyserial."""
+    if os.path.isfile(path) or path == '-':
+        return sys.stdin.buffer if path == '-' else open(path, 'rb')
+
+    import serial  # pyserial, only needed for a live port
+    return serial.Serial(path, baud, timeout=0.1)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('source', help='serial port, capture file, or - for stdin')
+    parser.add_argument('--events', action='append', required=True, help='log_events.hpp of the project')
+    parser.add_argument('--baud', type=int, default=DEFAULT_BAUD)
+    args = parser.parse_args()
+
+    decoder = Decoder(load_events(args.events), sys.stdout)
+    source = open_source(args.source, args.baud)
+
+    try:
+        while True:
+            data = source.read(256)
+            if not data:
+                if not hasattr(source, 'in_waiting'):
+                    break
+                continue
+            decoder.feed(data)
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,41 @@
+/**
+ * @file bounce_trace.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Switch edge traces, recorded or synthetic, and the presses in them
+ */
+#ifndef BOUNCE_TRACE_HPP
+#define BOUNCE_TRACE_HPP
+
+#include <stdint.h>
+#include <vector>
+
+const unsigned long TRACE_LEAD = 10000;   // us of idle level before the first edge
+const unsigned long DEFAULT_GAP = 20000;  // us of quiet that ends a burst of bounces
+
+/**
+ * @brief A change of the switch pin, low while pressed
+ */
+struct Edge
+{
+    unsigned long time; // us from the start of the trace
+    uint8_t level;
+};
+
+/**
+ * @brief A burst of bounces that leaves the pin at the other level: a press if
+ * it ends low, a release if it ends high. Bursts that end where they started
+ * are glitches and are not transitions.
+ */
+struct Transition
+{
+    unsigned long start; // us of the first edge of the burst
+    bool press;
+};
+
+using EdgeTrace = std::vector<Edge>;
+
+bool loadTrace(const char *path, EdgeTrace &trace);
+EdgeTrace syntheticTrace(uint32_t seed, uint16_t presses);
+std::vector<Transition> transitions(const EdgeTrace &trace, unsigned long gap);
+
+#endif // BOUNCE_TRACE_HPP
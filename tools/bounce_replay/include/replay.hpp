@@ -0,0 +1,31 @@
+/**
+ * @file replay.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief The debouncers of the projects, wrapped for replay
+ */
+#ifndef REPLAY_HPP
+#define REPLAY_HPP
+
+#include "avr_mock.hpp"
+
+/**
+ * @brief A debouncer under test, on the pin it reads in its project, polled
+ * about as often as its project's loop calls it
+ */
+struct DebouncerUnderTest
+{
+    const char *name;
+    MockPort port;
+    uint8_t bit;
+    unsigned long pollPeriod; // us between polls
+    unsigned long resolution; // us, the delays it takes are multiples of this
+    void (*begin)();
+    bool (*poll)(unsigned long delay); // true once for each press, delay in us
+};
+
+extern const DebouncerUnderTest pwmDebouncer;
+extern const DebouncerUnderTest watchDogDebouncer;
+extern const DebouncerUnderTest keyMatrixDebouncer;
+extern const DebouncerUnderTest buttonPairDebouncer;
+
+#endif // REPLAY_HPP
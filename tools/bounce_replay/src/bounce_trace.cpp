@@ -0,0 +1,166 @@
+/**
+ * @file bounce_trace.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Definition of the trace loading, generation and press detection
+ */
+#include "bounce_trace.hpp"
+#include <stdio.h>
+#include <random>
+
+/**
+ * @brief Read a trace file. Lines are either "<us> <level>" or the EVT_EDGE
+ * lines of a DebounceSwitches edge_trace capture decoded by
+ * tools/binlog_decode.py, "[    1.234567] Switch edge, level 0". Other lines
+ * are skipped. The pin is high before the first edge.
+ *
+ * @param path
+ * @param trace edges, moved to start TRACE_LEAD after 0
+ * @return true if the file could be read and has edges
+ */
+bool loadTrace(const char *path, EdgeTrace &trace)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        return false;
+    }
+
+    trace.clear();
+    char line[256];
+    unsigned long first = 0;
+
+    while (fgets(line, sizeof(line), file))
+    {
+        double seconds;
+        unsigned long time;
+        unsigned int level;
+
+        if (sscanf(line, " [%lf] Switch edge, level %u", &seconds, &level) == 2)
+        {
+            time = (unsigned long)(seconds * 1e6 + 0.5);
+        }
+        else if (line[0] == '#' || sscanf(line, "%lu %u", &time, &level) != 2)
+        {
+            continue;
+        }
+
+        if (trace.empty())
+        {
+            first = time;
+        }
+        // the loop can only log an edge when the level differs from the last
+        if (trace.empty() ? level == 0 : level != trace.back().level)
+        {
+            trace.push_back({time - first + TRACE_LEAD, (uint8_t)(level ? 1 : 0)});
+        }
+    }
+
+    fclose(file);
+    return !trace.empty();
+}
+
+/**
+ * @brief Append a burst of bounces that starts with the pin leaving its level
+ * and ends at the other level
+ *
+ * @param trace
+ * @param time us of the first edge, moved past the burst
+ * @param level level at the end of the burst
+ * @param bounces extra pairs of edges
+ * @param random
+ */
+static void appendBurst(EdgeTrace &trace, unsigned long &time, uint8_t level, uint8_t bounces,
+                        std::mt19937 &random)
+{
+    // contacts chatter fast at first and settle over a few milliseconds
+    std::uniform_int_distribution<unsigned long> interval(5, 100);
+
+    for (uint8_t edge = 0; edge < 2 * bounces + 1; ++edge)
+    {
+        trace.push_back({time, (uint8_t)((edge & 1) ? !level : level)});
+        time += interval(random) * (edge / 2 + 1);
+    }
+}
+
+/**
+ * @brief Presses and releases with bounces of the kind the DebounceSwitches
+ * characterizer measured (up to 9 bounces over 5.5 ms on release), and short
+ * spikes that are not presses: one while released, one while held.
+ *
+ * @param seed
+ * @param presses
+ * @return EdgeTrace
+ */
+EdgeTrace syntheticTrace(uint32_t seed, uint16_t presses)
+{
+    std::mt19937 random(seed);
+    std::uniform_int_distribution<unsigned long> idle(50000, 400000);
+    std::uniform_int_distribution<unsigned long> hold(50000, 300000);
+    std::uniform_int_distribution<unsigned long> spike(2, 80);
+    std::uniform_int_distribution<int> pressBounces(0, 3);
+    std::uniform_int_distribution<int> releaseBounces(0, 9);
+    std::bernoulli_distribution glitch(0.25);
+
+    EdgeTrace trace;
+    unsigned long time = TRACE_LEAD;
+
+    for (uint16_t press = 0; press < presses; ++press)
+    {
+        unsigned long pressAt = time + idle(random);
+        if (glitch(random))
+        {
+            unsigned long at = time + (pressAt - time) / 2;
+            trace.push_back({at, 0});
+            trace.push_back({at + spike(random), 1});
+        }
+
+        time = pressAt;
+        appendBurst(trace, time, 0, pressBounces(random), random);
+
+        unsigned long releaseAt = time + hold(random);
+        if (glitch(random))
+        {
+            unsigned long at = time + (releaseAt - time) / 2;
+            trace.push_back({at, 1});
+            trace.push_back({at + spike(random), 0});
+        }
+
+        time = releaseAt;
+        appendBurst(trace, time, 1, releaseBounces(random), random);
+    }
+
+    return trace;
+}
+
+/**
+ * @brief The presses and releases in a trace: edges closer than gap are one
+ * burst, and a burst is a transition if it leaves the pin at the other level
+ *
+ * @param trace
+ * @param gap us
+ * @return std::vector<Transition>
+ */
+std::vector<Transition> transitions(const EdgeTrace &trace, unsigned long gap)
+{
+    std::vector<Transition> found;
+    uint8_t level = 1;
+
+    for (size_t edge = 0; edge < trace.size();)
+    {
+        unsigned long start = trace[edge].time;
+        size_t last = edge;
+        while (last + 1 < trace.size() && trace[last + 1].time - trace[last].time < gap)
+        {
+            ++last;
+        }
+
+        if (trace[last].level != level)
+        {
+            level = trace[last].level;
+            found.push_back({start, level == 0});
+        }
+        edge = last + 1;
+    }
+
+    return found;
+}
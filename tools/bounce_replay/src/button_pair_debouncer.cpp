@@ -0,0 +1,24 @@
+/**
+ * @file button_pair_debouncer.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief debounceButton() of DebouncingSwitchTimeDivMux on the increment
+ * button
+ */
+#include "replay.hpp"
+#include "../../../DebouncingSwitchTimeDivMux/src/buttons.cpp"
+
+static void begin()
+{
+    // the decrement button stays up; the shield has pull-ups on both
+    mockDrive(MOCK_PORT_B, PB2, HIGH);
+    ButtonIncrement::input();
+    ButtonDecrement::input();
+}
+
+static bool poll(unsigned long delay)
+{
+    return debounceButton(delay) == INCREMENT_PRESSED;
+}
+
+// buttonTask() runs on every 1 ms scheduler tick
+const DebouncerUnderTest buttonPairDebouncer = {"debounceButton", MOCK_PORT_B, PB3, 1000, 1, begin, poll};
@@ -0,0 +1,27 @@
+/**
+ * @file key_matrix_debouncer.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief KeyMatrix::getKey() of CombinationLock
+ *
+ * The trace drives the first column straight, not through a row, so the scan
+ * sees the key on its first row: '1' while the switch is closed.
+ */
+#include "replay.hpp"
+#include "../../../CombinationLock/src/key_matrix.cpp"
+
+static KeyMatrix *keypad;
+
+static void begin()
+{
+    static KeyMatrix matrix;
+    matrix = KeyMatrix();
+    keypad = &matrix;
+}
+
+static bool poll(unsigned long delay)
+{
+    return keypad->getKey(delay) != '\0';
+}
+
+// one loop() of the safe is a scan and the state machine
+const DebouncerUnderTest keyMatrixDebouncer = {"KeyMatrix::getKey", MOCK_PORT_D, PD5, 200, 1, begin, poll};
@@ -0,0 +1,235 @@
+/**
+ * @file main.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Replays switch bounce traces through every debouncer of the projects,
+ * for a range of debounce delays, and reports how each one did
+ *
+ * Each trace runs on the debouncer's own pin in virtual time, polled as often
+ * as its project's loop would. A detected press that does not follow a press
+ * in the trace is a false press, e.g. from a spike or a bounce on release. A
+ * press in the trace with no detection before the next release is missed.
+ * Latency is from the first edge of the press to its detection.
+ *
+ * usage: program [--presses N] [--seed N] [--gap us] [trace ...]
+ *
+ * Traces are "<us> <level>" lines, or a capture of DebounceSwitches built
+ * with its edge_trace env, decoded by tools/binlog_decode.py. Without any, one synthetic trace of --presses
+ * presses (200) is generated from --seed.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include "bounce_trace.hpp"
+// after the standard headers, the core's min and max macros break them
+#include "replay.hpp"
+
+const uint16_t DEFAULT_PRESSES = 200;
+const unsigned long SETTLE_TIME = 200000; // us of idle before a trace, past the longest delay
+const unsigned long TAIL_TIME = 200000;   // us of idle after the last edge
+
+// debounce delays to try, in us
+const unsigned long DELAYS[] = {500, 1000, 2000, 5000, 10000, 20000, 50000};
+
+const DebouncerUnderTest *const DEBOUNCERS[] = {&pwmDebouncer, &watchDogDebouncer, &keyMatrixDebouncer,
+                                                &buttonPairDebouncer};
+
+/**
+ * @brief Results of one debouncer at one delay over every trace
+ */
+struct Score
+{
+    unsigned long presses;
+    unsigned long falsePresses;
+    unsigned long missed;
+    std::vector<unsigned long> latencies; // us
+};
+
+static unsigned long elapsedMicros(unsigned long long since)
+{
+    return (unsigned long)((mockCycles() - since) / (F_CPU / 1000000));
+}
+
+/**
+ * @brief Poll the debouncer for a while with the pin at a steady level
+ *
+ * @param debouncer
+ * @param delay us
+ * @param time us
+ */
+static void idle(const DebouncerUnderTest &debouncer, unsigned long delay, unsigned long time)
+{
+    mockDrive(debouncer.port, debouncer.bit, HIGH);
+    for (unsigned long long start = mockCycles(); elapsedMicros(start) < time;)
+    {
+        debouncer.poll(delay);
+        mockAdvance(debouncer.pollPeriod * (F_CPU / 1000000));
+    }
+}
+
+/**
+ * @brief Replay one trace and score the detections against its transitions
+ *
+ * @param debouncer
+ * @param delay us
+ * @param trace
+ * @param expected transitions of the trace
+ * @param score
+ */
+static void replay(const DebouncerUnderTest &debouncer, unsigned long delay, const EdgeTrace &trace,
+                   const std::vector<Transition> &expected, Score &score)
+{
+    idle(debouncer, delay, SETTLE_TIME);
+
+    std::vector<bool> matched(expected.size(), false);
+    size_t edge = 0;
+    size_t next = 0; // first transition not started yet
+    unsigned long end = trace.back().time + TAIL_TIME;
+    unsigned long long start = mockCycles();
+
+    for (unsigned long now = 0; now < end; now = elapsedMicros(start))
+    {
+        // edges between two polls: the debouncer only sees the last level
+        while (edge < trace.size() && trace[edge].time <= now)
+        {
+            mockDrive(debouncer.port, debouncer.bit, trace[edge++].level);
+        }
+        while (next < expected.size() && expected[next].start <= now)
+        {
+            ++next;
+        }
+
+        if (debouncer.poll(delay))
+        {
+            // the press belongs to the transition in progress, if that is a press
+            size_t current = next - 1;
+            if (next > 0 && expected[current].press && !matched[current])
+            {
+                matched[current] = true;
+                score.latencies.push_back(now - expected[current].start);
+            }
+            else
+            {
+                ++score.falsePresses;
+            }
+        }
+
+        mockAdvance(debouncer.pollPeriod * (F_CPU / 1000000));
+    }
+
+    for (size_t transition = 0; transition < expected.size(); ++transition)
+    {
+        if (expected[transition].press)
+        {
+            ++score.presses;
+            score.missed += !matched[transition];
+        }
+    }
+}
+
+static unsigned long percentile(const std::vector<unsigned long> &sorted, uint8_t percent)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    return sorted[(sorted.size() - 1) * percent / 100];
+}
+
+int main(int argc, char *argv[])
+{
+    uint16_t presses = DEFAULT_PRESSES;
+    uint32_t seed = 1;
+    unsigned long gap = DEFAULT_GAP;
+    std::vector<EdgeTrace> traces;
+
+    for (int arg = 1; arg < argc; ++arg)
+    {
+        if (!strcmp(argv[arg], "--presses") && arg + 1 < argc)
+        {
+            presses = atoi(argv[++arg]);
+        }
+        else if (!strcmp(argv[arg], "--seed") && arg + 1 < argc)
+        {
+            seed = strtoul(argv[++arg], nullptr, 0);
+        }
+        else if (!strcmp(argv[arg], "--gap") && arg + 1 < argc)
+        {
+            gap = strtoul(argv[++arg], nullptr, 0);
+        }
+        else
+        {
+            traces.emplace_back();
+            if (!loadTrace(argv[arg], traces.back()))
+            {
+                fprintf(stderr, "no edges in %s\n", argv[arg]);
+                return 1;
+            }
+        }
+    }
+
+    if (traces.empty())
+    {
+        traces.push_back(syntheticTrace(seed, presses));
+    }
+
+    std::vector<std::vector<Transition>> expected;
+    for (const EdgeTrace &trace : traces)
+    {
+        expected.push_back(transitions(trace, gap));
+    }
+
+    // the replay runs for as long as it takes, not AVR_MOCK_SECONDS
+    mockRunFor(1ULL << 62);
+
+    printf("%-20s %8s %7s %6s %6s %8s %8s %8s %8s\n", "debouncer", "delay us", "presses", "false", "missed",
+           "p50 us", "p90 us", "p99 us", "max us");
+
+    const DebouncerUnderTest *best = nullptr;
+    unsigned long bestDelay = 0;
+    unsigned long bestLatency = 0;
+
+    for (const DebouncerUnderTest *debouncer : DEBOUNCERS)
+    {
+        debouncer->begin();
+
+        for (unsigned long delay : DELAYS)
+        {
+            if (delay % debouncer->resolution)
+            {
+                continue;
+            }
+
+            Score score = {};
+            for (size_t trace = 0; trace < traces.size(); ++trace)
+            {
+                replay(*debouncer, delay, traces[trace], expected[trace], score);
+            }
+
+            std::sort(score.latencies.begin(), score.latencies.end());
+            unsigned long p99 = percentile(score.latencies, 99);
+            printf("%-20s %8lu %7lu %6lu %6lu %8lu %8lu %8lu %8lu\n", debouncer->name, delay, score.presses,
+                   score.falsePresses, score.missed, percentile(score.latencies, 50),
+                   percentile(score.latencies, 90), p99, percentile(score.latencies, 100));
+
+            if (!score.falsePresses && !score.missed && score.presses && (!best || p99 < bestLatency))
+            {
+                best = debouncer;
+                bestDelay = delay;
+                bestLatency = p99;
+            }
+        }
+    }
+
+    if (best)
+    {
+        printf("\nlowest p99 latency with no false or missed presses: %s at %lu us, %lu us\n", best->name,
+               bestDelay, bestLatency);
+    }
+    else
+    {
+        printf("\nno debouncer and delay got every press without a false one\n");
+    }
+
+    return 0;
+}
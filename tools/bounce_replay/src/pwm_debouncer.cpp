@@ -0,0 +1,29 @@
+/**
+ * @file pwm_debouncer.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Debouncer::debounce() of PWMAssignment on Switch1
+ */
+#include "replay.hpp"
+#include "gpio.hpp"
+
+// WatchDogTimer has its own Debouncer template; a namespace keeps the two
+// apart. Arduino.h and gpio.hpp are already in, so only the class lands here.
+namespace pwm
+{
+#include "../../../PWMAssignment/include/debouncer.hpp"
+}
+
+static pwm::Debouncer<Pin<PortC, PC4>> switch1;
+
+static void begin()
+{
+    switch1.begin();
+}
+
+static bool poll(unsigned long delay)
+{
+    return switch1.debounce(delay);
+}
+
+// loop() runs the software PWM pulse, up to 255 us, between polls
+const DebouncerUnderTest pwmDebouncer = {"Debouncer::debounce", MOCK_PORT_C, PC4, 300, 1, begin, poll};
@@ -0,0 +1,35 @@
+/**
+ * @file watchdog_debouncer.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Debouncer::update() of WatchDogTimer on the wake button
+ */
+#include "replay.hpp"
+#include "gpio.hpp"
+
+// PWMAssignment has its own Debouncer template; a namespace keeps the two
+// apart. Arduino.h and gpio.hpp are already in, so only the class lands here.
+namespace watchdog
+{
+#include "../../../WatchDogTimer/include/debouncer.hpp"
+}
+
+static watchdog::Debouncer<Pin<PortB, PB2>> wakeButton;
+static bool wasPressed;
+
+static void begin()
+{
+    wakeButton.begin();
+    wasPressed = false;
+}
+
+static bool poll(unsigned long delay)
+{
+    // update() returns the debounced level; a press is its falling edge
+    bool pressed = wakeButton.update(delay / 1000);
+    bool press = pressed && !wasPressed;
+    wasPressed = pressed;
+    return press;
+}
+
+// loop() idles until the next Timer0 overflow between polls
+const DebouncerUnderTest watchDogDebouncer = {"Debouncer::update", MOCK_PORT_B, PB2, 1024, 1000, begin, poll};
@@ -0,0 +1,400 @@
+#!/usr/bin/env python3
+"""Flash and SRAM footprint of the firmware images, against their budgets.
+
+Each project's Uno image is broken down by section, by module and by symbol.
+The sizes come from the ELF, and each symbol is put down to the module that
+defines it from the symbol tables of the objects and archives in the build
+directory and of the toolchain's libraries, which holds up under the link
+time optimisation of the Arduino core. Initialised data is marked: it takes
+flash for its image and SRAM for the copy made at boot, which is where
+tables without PROGMEM end up.
+
+--stack runs the project's scenario from tools/simbench/scenarios under the
+simbench harness and reports how deep the stack went, how far the heap grew
+and the gap neither of them touched, from the STACK_CANARY bytes that
+lib/StackPaint paints over the SRAM above .noinit at boot.
+
+Budgets are read from the env in the project's platformio.ini, in bytes:
+
+    custom_flash_budget = 32256     .text and .data
+    custom_sram_budget = 1536       .data, .bss and .noinit
+    custom_sram_headroom = 256      least SRAM left untouched under --stack
+
+tools/footprint_gate.py checks the first two after every link of an env that
+lists it in extra_scripts. --set-budgets writes them from the measured
+footprint, so that growth fails the build: the image plus FLASH_MARGIN, the
+static SRAM plus SRAM_MARGIN and, with --stack, the untouched SRAM less
+HEADROOM_MARGIN. The measured sizes go in a comment above them.
+
+usage:
+    footprint.py
+    footprint.py CombinationLock --symbols 30
+    footprint.py --no-build --stack --check
+    footprint.py --stack --set-budgets
+"""
+import argparse
+import configparser
+import os
+import re
+import subprocess
+import sys
+import tempfile
+
+import simbench
+from simbench import MCU, REPO, SCENARIOS, Scenario, ScenarioError, Trace
+
+DEFAULT_ENV = 'uno'
+DEFAULT_SYMBOLS = 15
+DEFAULT_MODULES = 20
+DATA_SPACE = 0x800000    # avr-nm adds it to SRAM addresses
+EEPROM_SPACE = 0x810000  # and this to EEPROM addresses
+
+FLASH_SECTIONS = ('.text', '.data')
+SRAM_SECTIONS = ('.data', '.bss', '.noinit')
+BUDGETS = ('flash_budget', 'sram_budget', 'sram_headroom')
+
+# room --set-budgets leaves over the measured footprint, in bytes: a small
+# feature's worth of code, a few variables, and a couple of call frames
+FLASH_MARGIN = 512
+SRAM_MARGIN = 64
+HEADROOM_MARGIN = 64
+MEASURED = '; measured: '
+
+UNATTRIBUTED = '(unattributed)'
+
+# suffixes GCC gives to copies of a function, demangled or not
+CLONE = re.compile(r'(\s*\[clone [^\]]*\]|\.(lto_priv|constprop|part|isra|cold|clone)(\.\d+)?)+$')
+
+
+def build_dir(project, env):
+    return os.path.join(REPO, project, '.pio', 'build', env)
+
+
+def sections(elf):
+    """Section name to size in bytes."""
+    output = subprocess.check_output([simbench.find_tool('avr-size'), '-A', elf], universal_newlines=True)
+    sizes = {}
+    for line in output.splitlines():
+        words = line.split()
+        if len(words) == 3 and words[0].startswith('.') and words[1].isdigit():
+            sizes[words[0]] = int(words[1])
+    return sizes
+
+
+def elf_symbols(elf):
+    """(name, address, size, type) of every symbol with a size."""
+    output = subprocess.check_output([simbench.find_tool('avr-nm'), '-C', '-S', '--size-sort', elf],
+                                     universal_newlines=True)
+    found = []
+    for line in output.splitlines():
+        parts = line.split(None, 3)
+        if len(parts) == 4 and int(parts[1], 16):
+            found.append((parts[3], int(parts[0], 16), int(parts[1], 16), parts[2]))
+    return found
+
+
+def module_name(path, member=None):
+    """A short module name for an object file or an archive member: src/main.cpp,
+    lib/LoopMonitor/loop_monitor.cpp, core/wiring.c or libgcc/_addsub_sf"""
+    if member:
+        library = re.sub(r'^lib|\.a$', '', os.path.basename(path))
+        member = re.sub(r'\.o$', '', member)
+        if library == 'FrameworkArduino':
+            return 'core/' + member
+        if library in ('gcc', 'c', 'm'):
+            return 'lib%s/%s' % (library, member)
+        return 'lib/%s/%s' % (library, member)
+
+    match = re.search(r'\.pio/build/[^/]+/(.*)$', path)
+    name = match.group(1) if match else os.path.basename(path)
+    name = re.sub(r'^lib[0-9a-f]*/', 'lib/', name)
+    name = re.sub(r'^FrameworkArduino/', 'core/', name)
+    return re.sub(r'\.o$', '', name)
+
+
+def toolchain_libraries():
+    """libgcc, libc and libm of the MCU, where float and string code comes from"""
+    compiler = simbench.find_tool('avr-gcc')
+    found = []
+    for option in ('-print-libgcc-file-name', '-print-file-name=libc.a', '-print-file-name=libm.a'):
+        path = subprocess.check_output([compiler, '-mmcu=' + MCU, option], universal_newlines=True).strip()
+        if os.path.isabs(path) and os.path.exists(path):
+            found.append(path)
+    return found
+
+
+def definitions(directory):
+    """Symbol name, and name without parameters, to the modules defining it"""
+    paths = toolchain_libraries()
+    for root, _, names in os.walk(directory):
+        paths.extend(os.path.join(root, name) for name in sorted(names) if name.endswith(('.o', '.a')))
+
+    # gcc-nm reads the symbol tables of LTO objects too
+    nm = simbench.find_tool('avr-gcc-nm', required=False) or simbench.find_tool('avr-nm')
+
+    defined = {}
+    for path in paths:
+        result = subprocess.run([nm, '-C', '--defined-only', path], stdout=subprocess.PIPE,
+                                stderr=subprocess.DEVNULL, universal_newlines=True)
+        member = None
+        for line in result.stdout.splitlines():
+            if path.endswith('.a') and line.endswith(':') and ' ' not in line:
+                member = line[:-1]
+                continue
+            parts = line.split(None, 2)
+            if len(parts) != 3 or parts[1] in 'aNU':
+                continue
+            module = module_name(path, member)
+            for name in {parts[2], parts[2].split('(')[0]}:
+                defined.setdefault(name, set()).add(module)
+    return defined
+
+
+def attribute(name, defined, classes):
+    """The module of a symbol of the image"""
+    name = CLONE.sub('', name)
+    name = re.sub(r'^(vtable|typeinfo|typeinfo name) for ', '', name)
+
+    for key in (name, name.split('(')[0]):
+        if key in defined:
+            return '+'.join(sorted(defined[key]))
+
+    # members a module does not export, like statics, go with their class
+    scope = name.split('(')[0].rsplit('::', 1)[0] if '::' in name else name
+    return classes.get(scope, UNATTRIBUTED)
+
+
+def footprint(elf, directory):
+    """Sizes of an image by section, module and symbol"""
+    sizes = sections(elf)
+    defined = definitions(directory)
+
+    classes = {}
+    for name, modules in defined.items():
+        if '::' in name and len(modules) == 1:
+            classes.setdefault(name.split('(')[0].rsplit('::', 1)[0], next(iter(modules)))
+
+    symbols = []
+    modules = {}
+    for name, address, size, kind in elf_symbols(elf):
+        if address >= EEPROM_SPACE:
+            continue
+        # SRAM symbols with an initial value keep its image in flash
+        init = address >= DATA_SPACE and kind in 'Dd'
+        flash = size if address < DATA_SPACE or init else 0
+        sram = size if address >= DATA_SPACE else 0
+        module = attribute(name, defined, classes)
+        symbols.append({'name': name, 'module': module, 'flash': flash, 'sram': sram, 'init': init})
+        totals = modules.setdefault(module, {'flash': 0, 'sram': 0})
+        totals['flash'] += flash
+        totals['sram'] += sram
+
+    return {
+        'sections': sizes,
+        'flash': sum(sizes.get(name, 0) for name in FLASH_SECTIONS),
+        'sram': sum(sizes.get(name, 0) for name in SRAM_SECTIONS),
+        'modules': modules,
+        'symbols': symbols,
+    }
+
+
+def read_budgets(project, env):
+    """custom_<budget> of an env and the envs it extends, as ints"""
+    config = configparser.ConfigParser(inline_comment_prefixes=(';', '#'), interpolation=None)
+    config.read(os.path.join(REPO, project, 'platformio.ini'))
+
+    budgets = {}
+    section = 'env:' + env
+    while config.has_section(section):
+        for budget in BUDGETS:
+            value = config.get(section, 'custom_' + budget, fallback=None)
+            if value is not None and budget not in budgets:
+                budgets[budget] = int(value, 0)
+        parent = config.get(section, 'extends', fallback=None)
+        section = parent.strip() if parent else None
+    return budgets
+
+
+def measured_budgets(result):
+    """Budgets from a footprint, with the margins"""
+    budgets = {
+        'flash_budget': result['flash'] + FLASH_MARGIN,
+        'sram_budget': result['sram'] + SRAM_MARGIN,
+    }
+    if 'stack' in result:
+        budgets['sram_headroom'] = max(result['stack']['free'] - HEADROOM_MARGIN, 0)
+    return budgets
+
+
+def write_budgets(project, env, result, budgets):
+    """Replace the custom_<budget> lines of an env in the project's
+    platformio.ini, and the comment with the sizes they come from"""
+    path = os.path.join(REPO, project, 'platformio.ini')
+    with open(path) as source:
+        lines = source.read().splitlines()
+
+    header = '[env:%s]' % env
+    if header not in lines:
+        sys.exit('%s has no %s' % (path, header))
+    start = lines.index(header) + 1
+    end = next((i for i in range(start, len(lines)) if lines[i].startswith('[')), len(lines))
+    # blank lines and comments before the next header belong to it
+    while end > start and (not lines[end - 1].strip() or lines[end - 1].startswith(';')):
+        end -= 1
+
+    note = MEASURED + 'flash %d, sram %d' % (result['flash'], result['sram'])
+    if 'stack' in result:
+        note += ', %d untouched under --stack' % result['stack']['free']
+
+    keys = dict(('custom_' + budget, value) for budget, value in budgets.items())
+    section = []
+    for line in lines[start:end]:
+        key = line.split('=')[0].strip()
+        if line.startswith(MEASURED):
+            continue
+        if key in keys:
+            if not section or not section[-1].startswith('custom_'):
+                section.append(note)
+                note = None
+            section.append('%s = %d' % (key, keys.pop(key)))
+        else:
+            section.append(line)
+
+    if note and keys:
+        section.append(note)
+    section.extend('%s = %d' % item for item in sorted(keys.items()))
+
+    lines[start:end] = section
+    with open(path, 'w') as output:
+        output.write('\n'.join(lines) + '\n')
+
+
+def measure_stack(project, elf, harness):
+    """Stack depth, heap size and untouched gap in bytes under the project's
+    scenario"""
+    scenario = Scenario(os.path.join(SCENARIOS, project + '.sim'))
+    heap = simbench.symbols(elf).get('__heap_start')
+    if heap is None:
+        sys.exit('%s has no __heap_start symbol' % elf)
+
+    with tempfile.TemporaryDirectory() as work:
+        commands = os.path.join(work, 'commands')
+        trace_path = os.path.join(work, 'trace')
+        simbench.write_commands(scenario, None, commands)
+        with open(commands, 'a') as output:
+            output.write('painted %d\n' % (heap - DATA_SPACE))
+        status = subprocess.call([harness, elf, commands, trace_path])
+        trace = Trace(trace_path)
+
+    if status or trace.state == 'crashed' or not trace.sram:
+        sys.exit('%s crashed at cycle %s' % (project, trace.end))
+
+    painted, ramend, start, end = trace.sram
+    if start == end:
+        start = end = painted  # nothing left painted, the stack took it all
+    return {'stack': ramend + 1 - end, 'heap': start - painted, 'free': end - start}
+
+
+def over_budget(result, budgets):
+    """Budgets the result breaks, as printable lines"""
+    found = []
+    for name in ('flash', 'sram'):
+        budget = budgets.get(name + '_budget')
+        if budget is not None and result[name] > budget:
+            found.append('%s %d bytes, budget %d' % (name, result[name], budget))
+    headroom = budgets.get('sram_headroom')
+    if headroom is not None and 'stack' in result and result['stack']['free'] < headroom:
+        found.append('%d bytes of SRAM left untouched, headroom %d' % (result['stack']['free'], headroom))
+    return found
+
+
+def percent(value, budget):
+    return ' of %d (%d%%)' % (budget, 100 * value // budget) if budget else ''
+
+
+def print_totals(project, result, budgets):
+    sizes = result['sections']
+    print('%s' % project)
+    print('  flash %6d bytes%-18s %s' % (result['flash'], percent(result['flash'], budgets.get('flash_budget')),
+                                         ', '.join('%s %d' % (name, sizes.get(name, 0)) for name in FLASH_SECTIONS)))
+    print('  sram  %6d bytes%-18s %s' % (result['sram'], percent(result['sram'], budgets.get('sram_budget')),
+                                         ', '.join('%s %d' % (name, sizes.get(name, 0)) for name in SRAM_SECTIONS)))
+    if 'stack' in result:
+        stack = result['stack']
+        print('  stack %6d bytes deep, heap %d bytes, %d bytes never touched%s' % (
+            stack['stack'], stack['heap'], stack['free'],
+            ' (headroom %d)' % budgets['sram_headroom'] if 'sram_headroom' in budgets else ''))
+
+
+def print_breakdown(result, modules, symbols):
+    print('\n  %-44s %6s %6s' % ('module', 'flash', 'sram'))
+    ranked = sorted(result['modules'].items(), key=lambda item: (-item[1]['flash'] - item[1]['sram'], item[0]))
+    for name, totals in ranked[:modules]:
+        print('  %-44s %6d %6d' % (name, totals['flash'], totals['sram']))
+    if len(ranked) > modules:
+        rest = ranked[modules:]
+        print('  %-44s %6d %6d' % ('%d more' % len(rest), sum(totals['flash'] for _, totals in rest),
+                                   sum(totals['sram'] for _, totals in rest)))
+
+    for memory in ('flash', 'sram') if symbols else ():
+        print('\n  %-44s %6s  %s' % ('largest in ' + memory, 'bytes', 'module'))
+        ranked = sorted((symbol for symbol in result['symbols'] if symbol[memory]), key=lambda s: -s[memory])
+        for symbol in ranked[:symbols]:
+            name = symbol['name'] if len(symbol['name']) <= 44 else symbol['name'][:41] + '...'
+            note = ', copied to SRAM at boot' if symbol['init'] else ''
+            print('  %-44s %6d  %s%s' % (name, symbol[memory], symbol['module'], note))
+
+
+def main():
+    projects = sorted(os.path.splitext(name)[0] for name in os.listdir(SCENARIOS) if name.endswith('.sim'))
+
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('projects', nargs='*', metavar='project', help='default: %s' % ', '.join(projects))
+    parser.add_argument('--env', default=DEFAULT_ENV, help='PlatformIO env to build and report (default %s)'
+                        % DEFAULT_ENV)
+    parser.add_argument('--modules', type=int, default=DEFAULT_MODULES, help='modules to list')
+    parser.add_argument('--symbols', type=int, default=DEFAULT_SYMBOLS, help='symbols to list for each memory')
+    parser.add_argument('--stack', action='store_true', help='measure stack and heap under simavr')
+    parser.add_argument('--check', action='store_true', help='exit with 1 when a project is over budget')
+    parser.add_argument('--no-build', action='store_true', help='use the firmware.elf already built')
+    parser.add_argument('--harness', help='prebuilt simbench harness')
+    parser.add_argument('--set-budgets', action='store_true',
+                        help="write budgets from the measured footprint to the env's platformio.ini")
+    args = parser.parse_intermixed_args()
+
+    if args.stack and not args.harness:
+        simbench.build_harness()
+        args.harness = simbench.HARNESS
+
+    failed = []
+    for project in args.projects or projects:
+        if not args.no_build and subprocess.call(['pio', 'run', '-d', os.path.join(REPO, project), '-e', args.env]):
+            sys.exit('build of %s failed' % project)
+
+        directory = build_dir(project, args.env)
+        elf = os.path.join(directory, 'firmware.elf')
+        result = footprint(elf, directory)
+        if args.stack:
+            try:
+                result['stack'] = measure_stack(project, elf, args.harness)
+            except ScenarioError as error:
+                sys.exit(str(error))
+
+        if args.set_budgets:
+            write_budgets(project, args.env, result, measured_budgets(result))
+
+        budgets = read_budgets(project, args.env)
+        print_totals(project, result, budgets)
+        print_breakdown(result, args.modules, args.symbols)
+        print()
+
+        failed.extend('%s: %s' % (project, line) for line in over_budget(result, budgets))
+
+    for line in failed:
+        print('over budget: ' + line)
+    if failed and args.check:
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
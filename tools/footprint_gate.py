@@ -0,0 +1,50 @@
+"""PlatformIO extra script: the flash and SRAM footprint of every link,
+checked against the budgets of the env.
+
+    extra_scripts = post:../tools/footprint_gate.py
+    custom_flash_budget = 32256
+    custom_sram_budget = 1536
+
+After firmware.elf is linked, the totals and the largest modules are printed
+and the build fails if the image is over budget. tools/footprint.py gives the
+full breakdown and measures the stack under simavr.
+"""
+import os
+import sys
+
+Import('env')  # noqa: F821, provided by PlatformIO
+
+GATE_MODULES = 8
+
+sys.path.insert(0, os.path.join(env.subst('$PROJECT_DIR'), os.pardir, 'tools'))  # noqa: F821
+import footprint  # noqa: E402
+
+
+def budgets_of(env):
+    found = {}
+    for budget in footprint.BUDGETS:
+        value = env.GetProjectOption('custom_' + budget, None)
+        if value is not None:
+            found[budget] = int(value, 0)
+    return found
+
+
+def check_footprint(source, target, env):
+    # find the AVR tools on the PATH of the build
+    os.environ['PATH'] = env['ENV']['PATH']
+
+    elf = str(target[0])
+    result = footprint.footprint(elf, env.subst('$BUILD_DIR'))
+    budgets = budgets_of(env)
+
+    footprint.print_totals(env.subst('$PIOENV'), result, budgets)
+    failed = footprint.over_budget(result, budgets)
+    if failed:
+        footprint.print_breakdown(result, GATE_MODULES, 0)
+        for line in failed:
+            sys.stderr.write('over budget: %s\n' % line)
+        return 1
+    return 0
+
+
+env.AddPostAction('$BUILD_DIR/${PROGNAME}.elf', check_footprint)  # noqa: F821
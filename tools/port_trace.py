@@ -0,0 +1,204 @@
+#!/usr/bin/env python3
+"""Golden port traces: check that a change leaves the pin waveforms alone.
+
+Each project with a scenario in tools/simbench/scenarios runs with the inputs
+of its scenario, either as the native build on the mock registers of
+lib/AvrMock or as the Uno image under the simbench harness. The trace of its
+port writes and UART output is then recorded as golden, or checked against the
+golden trace in tools/port_trace/<backend>/<project>.trace: every pin has to
+make the same changes in the same order, each one within the tolerance of its
+golden time, and the UART has to send the same bytes. Pins the scenario lists
+as untraced, like one toggled in a tight loop, are left out.
+
+The native build only counts the cycles of core calls, delays, sleeps and
+interrupts, not those of the program's own code, so its traces hold the
+waveform the code asks for; simavr's are cycle accurate. A golden trace only
+compares against runs on its own backend.
+
+usage:
+    port_trace.py record
+    port_trace.py record PWMAssignment
+    port_trace.py check --tolerance 20us
+    port_trace.py check --backend simavr CombinationLock
+"""
+import argparse
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+import simbench
+from simbench import F_CPU, REPO, SCENARIOS, Scenario, ScenarioError, Trace
+
+GOLDEN = os.path.join(simbench.TOOLS, 'port_trace')
+BACKENDS = ('native', 'simavr')
+DEFAULT_TOLERANCE = '10us'
+
+PINS = [(port, bit) for port in 'BCD' for bit in range(8)]
+
+
+def masks(scenario):
+    """Port letter to the pins to trace, for the ports with untraced pins."""
+    result = {}
+    for port, bit in scenario.untraced:
+        result[port] = result.get(port, 0xFF) & ~(1 << bit)
+    return result
+
+
+def run_native(project, commands, trace_path, args):
+    if not args.no_build and subprocess.call(['pio', 'run', '-d', os.path.join(REPO, project), '-e', 'native']):
+        sys.exit('native build of %s failed' % project)
+
+    program = os.path.join(REPO, project, '.pio', 'build', 'native', 'program')
+    environment = dict(os.environ, AVR_MOCK_INPUT=commands, AVR_MOCK_TRACE=trace_path)
+    environment.pop('AVR_MOCK_EEPROM', None)  # start from an erased EEPROM every time
+    result = subprocess.run([program], env=environment, stdin=subprocess.DEVNULL, stdout=subprocess.DEVNULL,
+                            stderr=subprocess.PIPE, universal_newlines=True)
+    if result.returncode:
+        sys.stderr.write(result.stderr)
+    return result.returncode
+
+
+def run_simavr(project, commands, trace_path, args):
+    if not args.no_build:
+        simbench.build_firmware(project)
+
+    elf = os.path.join(REPO, project, '.pio', 'build', 'uno', 'firmware.elf')
+    return subprocess.call([args.harness, elf, commands, trace_path])
+
+
+def run_project(project, args):
+    """Run a project's scenario and return the path of its trace, in a
+    temporary directory the caller removes."""
+    scenario = Scenario(os.path.join(SCENARIOS, project + '.sim'))
+
+    commands = os.path.join(args.work, project + '.commands')
+    trace_path = os.path.join(args.work, project + '.trace')
+    simbench.write_commands(scenario, None, commands, masks(scenario))
+
+    run = run_native if args.backend == 'native' else run_simavr
+    status = run(project, commands, trace_path, args)
+    trace = Trace(trace_path) if os.path.exists(trace_path) else None
+    if status or not trace or trace.state == 'crashed':
+        sys.exit('%s crashed at %s' % (project, ms(trace.end) if trace and trace.end else 'the start'))
+    return trace_path
+
+
+def changes(trace, pin):
+    """(cycle, level) of a pin at the first write to its port and at every
+    change after it, level 'z' while the pin is an input"""
+    port, bit = pin
+    level = None
+    result = []
+    for cycle, value, ddr in trace.ports[port]:
+        now = (value >> bit) & 1 if ddr & (1 << bit) else 'z'
+        if now != level:
+            result.append((cycle, now))
+            level = now
+    return result
+
+
+def ms(cycle):
+    return '%.3f ms' % (cycle * 1e3 / F_CPU)
+
+
+def differences(golden, trace, tolerance):
+    """Where a trace leaves its golden one, as printable lines: the first
+    difference of each pin, then of the UART output."""
+    found = []
+
+    for pin in PINS:
+        name = '%s%d' % pin
+        expected, actual = changes(golden, pin), changes(trace, pin)
+        for index, (want, got) in enumerate(zip(expected, actual)):
+            if want[1] != got[1]:
+                found.append('%s: change %d to %s at %s, golden is to %s at %s' % (name, index, got[1], ms(got[0]),
+                                                                                  want[1], ms(want[0])))
+                break
+            if abs(got[0] - want[0]) > tolerance:
+                found.append('%s: change %d to %s at %s, golden at %s' % (name, index, got[1], ms(got[0]),
+                                                                          ms(want[0])))
+                break
+        else:
+            if len(expected) != len(actual):
+                extra = expected[len(actual)] if len(expected) > len(actual) else actual[len(expected)]
+                found.append('%s: %d changes, golden %d, from %s' % (name, len(actual), len(expected),
+                                                                     ms(extra[0])))
+
+    if golden.uart != trace.uart:
+        index = next((i for i, (a, b) in enumerate(zip(golden.uart, trace.uart)) if a != b),
+                     min(len(golden.uart), len(trace.uart)))
+        found.append('serial: output differs from byte %d of %d, golden %d bytes' % (index, len(trace.uart),
+                                                                                   len(golden.uart)))
+
+    if golden.state != trace.state:
+        found.append('end: %s, golden %s' % (trace.state, golden.state))
+
+    return found
+
+
+def record(project, args):
+    trace_path = run_project(project, args)
+    golden_path = os.path.join(GOLDEN, args.backend, project + '.trace')
+    os.makedirs(os.path.dirname(golden_path), exist_ok=True)
+    shutil.copyfile(trace_path, golden_path)
+
+    trace = Trace(golden_path)
+    count = sum(max(len(changes(trace, pin)) - 1, 0) for pin in PINS)
+    print('%s: %d pin changes, %d serial bytes -> %s' % (project, count, len(trace.uart),
+                                                          os.path.relpath(golden_path)))
+    return True
+
+
+def check(project, args):
+    golden_path = os.path.join(GOLDEN, args.backend, project + '.trace')
+    if not os.path.exists(golden_path):
+        print('%s: no golden trace, run port_trace.py record --backend %s %s' % (project, args.backend, project))
+        return False
+
+    found = differences(Trace(golden_path), Trace(run_project(project, args)), args.tolerance)
+    for line in found:
+        print('%s %s' % (project, line))
+    if not found:
+        print('%s: matches' % project)
+    return not found
+
+
+def main():
+    projects = sorted(os.path.splitext(name)[0] for name in os.listdir(SCENARIOS) if name.endswith('.sim'))
+
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('action', choices=('record', 'check'))
+    parser.add_argument('projects', nargs='*', metavar='project', help='default: %s' % ', '.join(projects))
+    parser.add_argument('--backend', choices=BACKENDS, default='native')
+    parser.add_argument('--tolerance', default=DEFAULT_TOLERANCE,
+                        help='allowed shift of a change, cycles or a time like 20us (default %s)' % DEFAULT_TOLERANCE)
+    parser.add_argument('--no-build', action='store_true', help='use the program or firmware.elf already built')
+    parser.add_argument('--harness', help='prebuilt simbench harness')
+    args = parser.parse_intermixed_args()
+
+    try:
+        args.tolerance = simbench.parse_time(args.tolerance)
+    except ScenarioError as error:
+        sys.exit(str(error))
+
+    if args.backend == 'simavr' and not args.harness:
+        simbench.build_harness()
+        args.harness = simbench.HARNESS
+
+    action = record if args.action == 'record' else check
+    passed = True
+    with tempfile.TemporaryDirectory() as args.work:
+        for project in args.projects or projects:
+            try:
+                passed = action(project, args) and passed
+            except ScenarioError as error:
+                sys.exit(str(error))
+
+    if not passed:
+        sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,44 @@
+/**
+ * @file safe_probe.hpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief What the stand-ins for KeyMatrix and the servo pass between
+ * SafeControl and the fuzzer
+ */
+#ifndef SAFE_PROBE_HPP
+#define SAFE_PROBE_HPP
+
+#include "code_table.hpp"
+
+// SafeControl::State, in the same order
+enum ProbeState : uint8_t
+{
+    PROBE_OPEN,
+    PROBE_CLOSED,
+    PROBE_INVALID_CODE,
+    PROBE_SET_CODE,
+    PROBE_STATES,
+};
+
+/**
+ * @brief The private state of a SafeControl, copied by its stand-in members
+ */
+struct SafeSnapshot
+{
+    uint8_t state;     // ProbeState
+    uint8_t lastState; // ProbeState
+    CodeType enteredCode;
+    uint8_t enteredLength;
+    uint8_t codeLength;
+    bool continuous;
+    bool ownerSaved; // the store holds a new owner code
+    CodeType ownerCode;
+    uint8_t lastUser; // user slot of the last matching code
+};
+
+// returned by the next KeyMatrix::getKey(), once
+extern char nextKey;
+
+void probeUpdate(const SafeSnapshot &before);
+void probeServo(bool open, const SafeSnapshot &now);
+
+#endif // SAFE_PROBE_HPP
@@ -0,0 +1,488 @@
+/**
+ * @file main.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief Drives random and adversarial key sequences through the SafeControl
+ * state machine and checks its invariants on every update()
+ *
+ * Invariants:
+ *   - the servo only moves on a correct code: the codeLength keys typed before
+ *     the '*' that opens or the '#' that closes are a user code, or in
+ *     continuous entry the last codeLength keys typed
+ *   - a correct code typed into an empty entry opens a closed safe on '*' and
+ *     closes an open one on '#'
+ *   - the entry never holds more than codeLength keys
+ *   - INVALID_CODE lasts one update(), so lastState is never INVALID_CODE
+ *   - the owner stays the last user when a new owner code is saved
+ *
+ * Keys normally come one per update() with an idle update() after each, the
+ * way the debounced keypad delivers them. Burst sequences leave the idle
+ * updates out, as the keypad could with a debounce delay of 0.
+ *
+ * usage: program [--sequences N] [--seed N]
+ *
+ * The report gives the update() rate on this host, the cycles the mock
+ * charges per update() for core calls (not the code's own cycles, build
+ * CombinationLock's profile env for those), and the state transitions seen
+ * for each kind of key. Exits with 1 if an invariant broke.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+// after the standard headers, the core's min and max macros break them
+#include "avr_mock.hpp"
+#include "safe_control.hpp"
+#include "safe_probe.hpp"
+
+const unsigned long DEFAULT_SEQUENCES = 1000000;
+const uint8_t MAX_REPORTED = 10; // violations printed in full
+const size_t HISTORY = 32;       // keys shown with a violation
+
+const char SYMBOLS[] = "0123456789ABCD";
+const char KEYS[] = "0123456789ABCD*#";
+const char *const STATE_NAMES[PROBE_STATES] = {"OPEN", "CLOSED", "INVALID_CODE", "SET_CODE"};
+
+enum KeyClass : uint8_t
+{
+    KEY_NONE,
+    KEY_SYMBOL,
+    KEY_STAR,
+    KEY_HASH,
+    KEY_CLASSES,
+};
+
+const char *const KEY_NAMES[KEY_CLASSES] = {"none", "0-9 A-D", "*", "#"};
+
+/**
+ * @brief The update() in progress, finished by the next probeUpdate()
+ */
+struct UpdateRecord
+{
+    char key;
+    uint8_t before;  // ProbeState
+    bool moved;      // the servo started a move
+    bool open;       // to the open position
+};
+
+static SafeControl safe;
+static CodeTable table; // the fuzzer's own lookup of the user codes
+static std::vector<CodeType> userCodes;
+static std::mt19937 rng;
+
+// the fuzzer's side of the run
+static bool continuousMode = false;
+static bool started = false;      // init() has run
+static std::string typed;         // code keys since the last '*', '#' or mode change
+static bool typedPaced = true;    // every key of typed, and the '*' or '#' before, had an idle update after it
+static std::string history;       // keys fed, '.' for an idle update
+static UpdateRecord current;
+static bool haveCurrent = false;
+static SafeSnapshot before;       // state at the start of the update() in progress
+
+// results
+static unsigned long long updates = 0;
+static unsigned long long transitions[PROBE_STATES][KEY_CLASSES][PROBE_STATES];
+static unsigned long opens = 0;
+static unsigned long closes = 0;
+static unsigned long ownerChanges = 0;
+static unsigned long violations = 0;
+static unsigned long long cyclesMin = ~0ULL;
+static unsigned long long cyclesMax = 0;
+static unsigned long long cyclesTotal = 0;
+
+static bool isSymbol(char key)
+{
+    return key && strchr(SYMBOLS, key);
+}
+
+static KeyClass keyClass(char key)
+{
+    return !key ? KEY_NONE : key == '*' ? KEY_STAR : key == '#' ? KEY_HASH : KEY_SYMBOL;
+}
+
+/**
+ * @brief Pack the last CODE_DIGITS keys of an entry, as SafeControl does
+ */
+static CodeType packCode(const std::string &keys)
+{
+    CodeType code = 0;
+    for (size_t i = keys.size() - CODE_DIGITS; i < keys.size(); ++i)
+    {
+        code = (code << 4) | (strchr(SYMBOLS, keys[i]) - SYMBOLS);
+    }
+    return code;
+}
+
+/**
+ * @brief A code that opens and closes the safe right now: a table code, but
+ * the owner's once a new owner code is saved
+ */
+static bool isUserCode(CodeType code, const SafeSnapshot &snapshot)
+{
+    if (snapshot.ownerSaved && code == snapshot.ownerCode)
+    {
+        return true;
+    }
+
+    uint8_t user = table.lookup(code);
+    return user != NO_USER && !(user == OWNER_USER && snapshot.ownerSaved);
+}
+
+static void violation(const char *what, const SafeSnapshot &snapshot)
+{
+    if (++violations > MAX_REPORTED)
+    {
+        return;
+    }
+
+    size_t shown = history.size() < HISTORY ? history.size() : HISTORY;
+    printf("violation: %s\n", what);
+    printf("  %s entry, state %s, last state %s, %u keys entered (%04X), update %llu\n",
+           snapshot.continuous ? "continuous" : "normal", STATE_NAMES[snapshot.state % PROBE_STATES],
+           STATE_NAMES[snapshot.lastState % PROBE_STATES], snapshot.enteredLength, snapshot.enteredCode, updates);
+    printf("  last keys: %s\n", history.substr(history.size() - shown).c_str());
+}
+
+/**
+ * @brief Called by the servo stand-in at the start of every update(), with the
+ * state the last update() left
+ */
+void probeUpdate(const SafeSnapshot &snapshot)
+{
+    if (haveCurrent)
+    {
+        ++transitions[current.before][keyClass(current.key)][snapshot.state];
+
+        if (current.before == PROBE_INVALID_CODE && snapshot.state == PROBE_INVALID_CODE)
+        {
+            violation("INVALID_CODE lasted more than one update", snapshot);
+        }
+        if (before.ownerCode != snapshot.ownerCode || before.ownerSaved != snapshot.ownerSaved)
+        {
+            ++ownerChanges;
+
+            if (snapshot.lastUser != OWNER_USER)
+            {
+                violation("saving a new owner code lost the owner as the last user", snapshot);
+            }
+        }
+    }
+
+    if (snapshot.enteredLength > snapshot.codeLength)
+    {
+        violation("the entry holds more keys than a code", snapshot);
+    }
+    else if (!snapshot.continuous && snapshot.enteredLength < CODE_DIGITS &&
+             (snapshot.enteredCode >> (4 * snapshot.enteredLength)))
+    {
+        violation("the entry holds keys beyond its length", snapshot);
+    }
+    if (snapshot.lastState == PROBE_INVALID_CODE)
+    {
+        violation("lastState is INVALID_CODE, the safe cannot leave it", snapshot);
+    }
+
+    before = snapshot;
+    current = {nextKey, snapshot.state, false, false};
+    haveCurrent = true;
+}
+
+/**
+ * @brief Called by the servo stand-in when a move starts
+ */
+void probeServo(bool open, const SafeSnapshot &snapshot)
+{
+    if (!started)
+    {
+        return; // init() moves the servo to open
+    }
+
+    current.moved = true;
+    current.open = open;
+    ++(open ? opens : closes);
+
+    // the keys the safe checked: in continuous entry the key being typed too
+    std::string entry = continuousMode ? typed + current.key : typed;
+    bool keyMatches = continuousMode ? isSymbol(current.key) : current.key == (open ? '*' : '#');
+
+    if (!keyMatches || entry.size() < snapshot.codeLength || !isUserCode(packCode(entry), snapshot))
+    {
+        violation(open ? "the servo opened without a correct code" : "the servo closed without a correct code",
+                  snapshot);
+    }
+}
+
+/**
+ * @brief One update() with a key, or '\0' for none
+ *
+ * @param key
+ * @param idleAfter an idle update() follows, as with the debounced keypad
+ */
+static void step(char key, bool idleAfter)
+{
+    nextKey = key;
+    history += key ? key : '.';
+    if (history.size() > 4 * HISTORY)
+    {
+        history.erase(0, history.size() - HISTORY);
+    }
+
+    unsigned long long start = mockCycles();
+    safe.update();
+    unsigned long long cycles = mockCycles() - start;
+
+    ++updates;
+    cyclesTotal += cycles;
+    cyclesMin = cycles < cyclesMin ? cycles : cyclesMin;
+    cyclesMax = cycles > cyclesMax ? cycles : cyclesMax;
+
+    if (!key)
+    {
+        return;
+    }
+
+    // a correct code typed into an empty entry, at the keypad's pace
+    bool closing = key == '#' && before.state == PROBE_OPEN;
+    bool opening = key == '*' && before.state == PROBE_CLOSED;
+    if (!continuousMode && typedPaced && (opening || closing) && typed.size() == before.codeLength &&
+        isUserCode(packCode(typed), before) && (!current.moved || current.open != opening))
+    {
+        violation(opening ? "a correct code and '*' did not open the safe"
+                          : "a correct code and '#' did not close the safe",
+                  before);
+    }
+
+    if (isSymbol(key))
+    {
+        typed += key;
+        typedPaced = typedPaced && idleAfter;
+    }
+    else
+    {
+        typed.clear();
+        typedPaced = idleAfter;
+    }
+}
+
+static void type(const std::string &keys, bool burst)
+{
+    for (char key : keys)
+    {
+        step(key, !burst);
+        if (!burst)
+        {
+            step('\0', true);
+        }
+    }
+}
+
+static std::string randomKeys(size_t count, const char *from)
+{
+    std::string keys;
+    size_t choices = strlen(from);
+    for (size_t i = 0; i < count; ++i)
+    {
+        keys += from[rng() % choices];
+    }
+    return keys;
+}
+
+static std::string codeKeys(CodeType code)
+{
+    std::string keys;
+    for (int8_t digit = CODE_DIGITS - 1; digit >= 0; --digit)
+    {
+        keys += SYMBOLS[(code >> (4 * digit)) & 0x0F];
+    }
+    return keys;
+}
+
+/**
+ * @brief A user code that works right now, the owner's one time in four
+ */
+static std::string someUserCode()
+{
+    if (rng() % 4 == 0)
+    {
+        return codeKeys(before.ownerSaved ? before.ownerCode : userCodes[OWNER_USER]);
+    }
+
+    CodeType code = userCodes[1 + rng() % (userCodes.size() - 1)];
+    return codeKeys(code);
+}
+
+/**
+ * @brief A sequence of keys aimed at one part of the state machine
+ */
+static std::string sequence()
+{
+    std::string terminator(1, rng() % 2 ? '*' : '#');
+
+    switch (rng() % 6)
+    {
+    case 0: // anything
+        return randomKeys(1 + rng() % 12, KEYS);
+    case 1: // a correct code
+        return someUserCode() + terminator;
+    case 2: // a code one key off
+    {
+        std::string code = someUserCode();
+        size_t position = rng() % code.size();
+        char replacement;
+        do
+        {
+            replacement = SYMBOLS[rng() % (sizeof(SYMBOLS) - 1)];
+        } while (replacement == code[position]);
+        code[position] = replacement;
+        return code + terminator;
+    }
+    case 3: // too many keys, before or after a correct code
+        if (rng() % 2)
+        {
+            return randomKeys(1 + rng() % 3, SYMBOLS) + someUserCode() + terminator;
+        }
+        return someUserCode() + randomKeys(1 + rng() % 3, SYMBOLS) + terminator;
+    case 4: // change the owner code: owner code, '*', new code, '#'
+    {
+        std::string owner = codeKeys(before.ownerSaved ? before.ownerCode : userCodes[OWNER_USER]);
+        std::string code;
+        switch (rng() % 4)
+        {
+        case 0: // another user's code, which must be refused
+            code = codeKeys(userCodes[1 + rng() % (userCodes.size() - 1)]);
+            break;
+        case 1: // too short
+            code = randomKeys(rng() % CODE_DIGITS, SYMBOLS);
+            break;
+        default:
+            code = randomKeys(CODE_DIGITS, SYMBOLS);
+            break;
+        }
+        return owner + "*" + code + (rng() % 8 ? "#" : "*");
+    }
+    default: // '*' and '#' only
+        return randomKeys(1 + rng() % 4, "*#");
+    }
+}
+
+/**
+ * @brief Every code the table knows, by user slot
+ */
+static void loadUserCodes()
+{
+    for (uint32_t code = 0; code <= 0xFFFF; ++code)
+    {
+        bool valid = true;
+        for (uint8_t digit = 0; digit < CODE_DIGITS; ++digit)
+        {
+            valid = valid && ((code >> (4 * digit)) & 0x0F) <= 0x0D;
+        }
+
+        uint8_t user = valid ? table.lookup(code) : NO_USER;
+        if (user != NO_USER)
+        {
+            if (user >= userCodes.size())
+            {
+                userCodes.resize(user + 1, EMPTY_CODE);
+            }
+            userCodes[user] = code;
+        }
+    }
+}
+
+static void printReport(double seconds, unsigned long sequences)
+{
+    printf("%llu updates from %lu sequences in %.2f s, %.2f M updates/s on this host\n", updates, sequences,
+           seconds, updates / seconds / 1e6);
+    printf("mock cycles per update: min %llu, mean %.1f, max %llu (core calls only)\n", cyclesMin,
+           (double)cyclesTotal / updates, cyclesMax);
+    printf("servo: %lu opens, %lu closes; owner code saved %lu times\n\n", opens, closes, ownerChanges);
+
+    printf("%-13s %-8s %s\n", "state", "key", "next state: updates");
+    unsigned int pairs = 0;
+    unsigned int reached = 0;
+    for (uint8_t from = 0; from < PROBE_STATES; ++from)
+    {
+        for (uint8_t key = 0; key < KEY_CLASSES; ++key)
+        {
+            printf("%-13s %-8s", STATE_NAMES[from], KEY_NAMES[key]);
+            bool any = false;
+            for (uint8_t to = 0; to < PROBE_STATES; ++to)
+            {
+                if (transitions[from][key][to])
+                {
+                    printf(" %s: %llu", STATE_NAMES[to], transitions[from][key][to]);
+                    any = true;
+                    ++reached;
+                }
+            }
+            printf("%s\n", any ? "" : " never reached");
+            pairs += any;
+        }
+    }
+    printf("\ncoverage: %u of %u state and key pairs, %u transitions\n", pairs, PROBE_STATES * KEY_CLASSES,
+           reached);
+    printf("violations: %lu\n", violations);
+}
+
+int main(int argc, char *argv[])
+{
+    unsigned long sequences = DEFAULT_SEQUENCES;
+    uint32_t seed = 1;
+
+    for (int arg = 1; arg < argc; ++arg)
+    {
+        if (!strcmp(argv[arg], "--sequences") && arg + 1 < argc)
+        {
+            sequences = strtoul(argv[++arg], nullptr, 0);
+        }
+        else if (!strcmp(argv[arg], "--seed") && arg + 1 < argc)
+        {
+            seed = strtoul(argv[++arg], nullptr, 0);
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--sequences N] [--seed N]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    // the fuzzer runs for as long as it takes, not AVR_MOCK_SECONDS
+    mockRunFor(1ULL << 62);
+    rng.seed(seed);
+
+    loadUserCodes();
+    if (userCodes.size() < 2)
+    {
+        fprintf(stderr, "the code table has no users besides the owner\n");
+        return 1;
+    }
+
+    safe.init();
+    step('\0', true);
+    started = true;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (unsigned long run = 0; run < sequences; ++run)
+    {
+        if (rng() % 16 == 0)
+        {
+            continuousMode = rng() % 4 == 0;
+            safe.setContinuousEntry(continuousMode);
+            typed.clear();
+            typedPaced = true;
+        }
+
+        type(sequence(), rng() % 8 == 0);
+    }
+    step('\0', true); // report the last update()
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printReport(seconds, sequences);
+
+    return violations ? 1 : 0;
+}
@@ -0,0 +1,10 @@
+/**
+ * @file safe_sources.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief The SafeControl state machine of CombinationLock and the code table
+ * and store it checks codes against, built as they are. KeyMatrix and the
+ * servo moves come from stand_ins.cpp.
+ */
+#include "../../../CombinationLock/src/safe_control.cpp"
+#include "../../../CombinationLock/src/code_table.cpp"
+#include "../../../CombinationLock/src/code_store.cpp"
@@ -0,0 +1,52 @@
+/**
+ * @file stand_ins.cpp
+ * @author Kevin Wing (wing5640@vandals.uidaho.edu)
+ * @brief KeyMatrix and the servo moves of SafeControl, replaced: the keypad
+ * returns the keys the fuzzer sets, and the servo only reports its moves
+ *
+ * The servo stays "moving", so update() calls servoMove() first thing every
+ * time, which makes it the place to report the state the last update() left.
+ */
+#include "safe_control.hpp"
+#include "safe_probe.hpp"
+
+char nextKey = '\0';
+
+// the members are private, so the snapshot is taken inside the members below
+#define SAFE_SNAPSHOT()                                                                                              \
+    SafeSnapshot                                                                                                     \
+    {                                                                                                                \
+        (uint8_t)state, (uint8_t)lastState, enteredCode, enteredLength, codeLength, continuousEntry, store.hasCode(), \
+            store.getCode(), lastUser                                                                                \
+    }
+
+KeyMatrix::KeyMatrix()
+{
+}
+
+char KeyMatrix::getKey(TickType debounceDelay)
+{
+    (void)debounceDelay;
+
+    char key = nextKey;
+    nextKey = '\0';
+    return key;
+}
+
+void SafeControl::servoOpen(bool open)
+{
+    servoTarget = open;
+    servoMoving = true;
+    probeServo(open, SAFE_SNAPSHOT());
+}
+
+CoStatus SafeControl::servoMove()
+{
+    static_assert(OPEN == (int)PROBE_OPEN && CLOSED == (int)PROBE_CLOSED &&
+                      INVALID_CODE == (int)PROBE_INVALID_CODE &&
+                      SET_CODE == (int)PROBE_SET_CODE,
+                  "ProbeState does not match SafeControl::State");
+
+    probeUpdate(SAFE_SNAPSHOT());
+    return CO_WAITING;
+}
@@ -0,0 +1,463 @@
+#!/usr/bin/env python3
+"""Cycle-accurate benchmarks of the firmware images under simavr.
+
+Each project with a scenario in tools/simbench/scenarios is built for the Uno,
+run under the simbench harness (tools/simbench/simbench.c, linked against
+libsimavr) with the inputs of its scenario, and measured from the cycle
+stamped trace of port writes, loop() entries and ISR runs. The results go to
+a JSON file, and --baseline compares them against an earlier run.
+
+Scenario files, one directive per line, '#' starts a comment line. Times are
+cycles, or a number with s, ms or us:
+
+    duration <time>
+    loop <symbol>                       main loop period, from entry to entry
+    isr <VECTOR>                        execution cycles, e.g. isr TIMER1_COMPA
+    keypad <rows> <cols> <keys>         e.g. D0D7D6D4 D5D3D2D1 123A456B789C*0#D
+    at <time> pin <B3> <0|1> [mark <name>]
+    at <time> adc <channel> <mV> [mark <name>]
+    at <time> key <key|none> [mark <name>]
+    at <time> serial "<text>" [mark <name>]
+    latency <name> <mark> <pin>         mark to the next change of a pin
+    period <name> <pin> [rising|falling|any] [from <time>] [to <time>]
+    untraced <pin> [<pin> ...]          left out of tools/port_trace.py traces
+
+usage:
+    simbench.py
+    simbench.py CombinationLock --output bench.json
+    simbench.py --output bench.json --baseline main.json --tolerance 5
+"""
+import argparse
+import codecs
+import datetime
+import glob
+import json
+import os
+import re
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+
+F_CPU = 16000000
+MCU = 'atmega328p'
+DEFAULT_TOLERANCE = 5.0
+
+TOOLS = os.path.dirname(os.path.abspath(__file__))
+REPO = os.path.dirname(TOOLS)
+SCENARIOS = os.path.join(TOOLS, 'simbench', 'scenarios')
+HARNESS_SOURCE = os.path.join(TOOLS, 'simbench', 'simbench.c')
+HARNESS = os.path.join(TOOLS, 'simbench', 'simbench')
+
+# ATmega328P interrupt vector numbers, as in __vector_N
+VECTORS = ['RESET', 'INT0', 'INT1', 'PCINT0', 'PCINT1', 'PCINT2', 'WDT', 'TIMER2_COMPA', 'TIMER2_COMPB',
+           'TIMER2_OVF', 'TIMER1_CAPT', 'TIMER1_COMPA', 'TIMER1_COMPB', 'TIMER1_OVF', 'TIMER0_COMPA',
+           'TIMER0_COMPB', 'TIMER0_OVF', 'SPI_STC', 'USART_RX', 'USART_UDRE', 'USART_TX', 'ADC', 'EE_READY',
+           'ANALOG_COMP', 'TWI', 'SPM_READY']
+
+TIME = re.compile(r'^(\d+(?:\.\d+)?)(s|ms|us)?$')
+PIN = re.compile(r'^([BCD])([0-7])$')
+UNITS = {None: 1, 'us': F_CPU / 1e6, 'ms': F_CPU / 1e3, 's': F_CPU}
+
+# metric values that get worse as they grow, checked against the baseline
+COMPARED = ('mean', 'max', 'jitter')
+
+
+class ScenarioError(Exception):
+    pass
+
+
+def parse_time(text):
+    match = TIME.match(text)
+    if not match:
+        raise ScenarioError('bad time %r' % text)
+    value, unit = match.groups()
+    return int(float(value) * UNITS[unit])
+
+
+def parse_pin(text):
+    match = PIN.match(text)
+    if not match:
+        raise ScenarioError('bad pin %r' % text)
+    return match.group(1), int(match.group(2))
+
+
+class Scenario:
+    """Inputs and metrics of one project, read from its scenario file."""
+
+    def __init__(self, path):
+        self.duration = F_CPU
+        self.loop = None
+        self.isrs = []
+        self.keypad = None
+        self.keys = ''
+        self.events = []
+        self.latencies = []
+        self.periods = []
+        self.untraced = []
+
+        with open(path) as scenario:
+            for number, line in enumerate(scenario, 1):
+                line = line.strip()
+                if not line or line.startswith('#'):
+                    continue
+                try:
+                    self.parse(line)
+                except (ScenarioError, ValueError, IndexError) as error:
+                    raise ScenarioError('%s:%d: %s' % (path, number, error))
+
+        self.events.sort(key=lambda event: event[0])
+
+    def parse(self, line):
+        if line.startswith('at '):
+            self.parse_input(line)
+            return
+
+        words = line.split()
+        directive = words[0]
+        if directive == 'duration':
+            self.duration = parse_time(words[1])
+        elif directive == 'loop':
+            self.loop = words[1]
+        elif directive == 'isr':
+            name = words[1][:-5] if words[1].endswith('_vect') else words[1]
+            if name not in VECTORS:
+                raise ScenarioError('unknown vector %r' % words[1])
+            self.isrs.append(name)
+        elif directive == 'keypad':
+            for pins in words[1:3]:
+                for i in range(0, 8, 2):
+                    parse_pin(pins[i:i + 2])
+            if len(words[3]) != 16:
+                raise ScenarioError('a keypad has 16 keys')
+            self.keypad = words[1:3]
+            self.keys = words[3]
+        elif directive == 'latency':
+            self.latencies.append((words[1], words[2], parse_pin(words[3])))
+        elif directive == 'period':
+            self.parse_period(words)
+        elif directive == 'untraced':
+            self.untraced.extend(parse_pin(word) for word in words[1:])
+        else:
+            raise ScenarioError('unknown directive %r' % directive)
+
+    def parse_input(self, line):
+        # serial text is quoted and may hold spaces
+        match = re.match(r'^at\s+(\S+)\s+serial\s+"((?:[^"\\]|\\.)*)"\s*(.*)$', line)
+        if match:
+            time, text, rest = match.groups()
+            data = codecs.decode(text, 'unicode_escape').encode('latin-1')
+            command = ['uart', data.hex()]
+            words = rest.split()
+        else:
+            words = line.split()[1:]
+            time = words.pop(0)
+            kind = words.pop(0)
+            if kind == 'pin':
+                port, bit = parse_pin(words.pop(0))
+                command = ['pin', port, str(bit), str(int(words.pop(0)))]
+            elif kind == 'adc':
+                command = ['adc', str(int(words.pop(0))), str(int(words.pop(0)))]
+            elif kind == 'key':
+                command = ['key'] + self.key_position(words.pop(0))
+            else:
+                raise ScenarioError('unknown input %r' % kind)
+
+        cycle = parse_time(time)
+        self.events.append((cycle, command))
+
+        if words:
+            if words[0] != 'mark' or len(words) != 2:
+                raise ScenarioError('expected mark <name>, got %r' % ' '.join(words))
+            self.events.append((cycle, ['mark', words[1]]))
+
+    def key_position(self, key):
+        if key == 'none':
+            return ['-1', '-1']
+        if not self.keypad or key not in self.keys:
+            raise ScenarioError('key %r is not on the keypad' % key)
+        index = self.keys.index(key)
+        return [str(index // 4), str(index % 4)]
+
+    def parse_period(self, words):
+        name, pin = words[1], parse_pin(words[2])
+        edge, start, end = 'rising', 0, None
+        rest = words[3:]
+        while rest:
+            word = rest.pop(0)
+            if word in ('rising', 'falling', 'any'):
+                edge = word
+            elif word == 'from':
+                start = parse_time(rest.pop(0))
+            elif word == 'to':
+                end = parse_time(rest.pop(0))
+            else:
+                raise ScenarioError('unexpected %r' % word)
+        self.periods.append((name, pin, edge, start, end))
+
+
+def find_tool(name, required=True):
+    """A tool from PATH, or else from PlatformIO's AVR toolchain. None if it
+    is missing and not required."""
+    found = shutil.which(name)
+    if found:
+        return found
+    pattern = os.path.expanduser('~/.platformio/packages/toolchain-atmelavr*/bin/' + name)
+    matches = glob.glob(pattern)
+    if not matches and not required:
+        return None
+    if not matches:
+        sys.exit('%s not found, install avr-gcc or build a project with PlatformIO first' % name)
+    return matches[0]
+
+
+def build_harness():
+    """Compile the harness against libsimavr if it is missing or stale."""
+    if os.path.exists(HARNESS) and os.path.getmtime(HARNESS) >= os.path.getmtime(HARNESS_SOURCE):
+        return
+    include = os.environ.get('SIMAVR_INCLUDE', '/usr/include/simavr')
+    command = [os.environ.get('CC', 'cc'), '-O2', '-o', HARNESS, HARNESS_SOURCE, '-I' + include, '-lsimavr',
+               '-lelf']
+    if subprocess.call(command):
+        sys.exit('cannot build the harness, is simavr installed? (SIMAVR_INCLUDE=%s)' % include)
+
+
+def build_firmware(project):
+    if subprocess.call(['pio', 'run', '-d', os.path.join(REPO, project), '-e', 'uno']):
+        sys.exit('build of %s failed' % project)
+
+
+def symbols(elf):
+    """Map symbol name to byte address."""
+    output = subprocess.check_output([find_tool('avr-nm'), '-C', elf], universal_newlines=True)
+    table = {}
+    for line in output.splitlines():
+        parts = line.split(None, 2)
+        if len(parts) == 3:
+            address, _, name = parts
+            table[name] = int(address, 16)
+            # demangled functions come with their parameter list
+            table.setdefault(name.split('(')[0], int(address, 16))
+    return table
+
+
+def write_probes(scenario, table, commands):
+    if scenario.loop:
+        if scenario.loop not in table:
+            raise ScenarioError('no symbol %r in the image' % scenario.loop)
+        commands.write('loop %d\n' % table[scenario.loop])
+    for name in scenario.isrs:
+        vector = VECTORS.index(name)
+        symbol = '__vector_%d' % vector
+        if symbol not in table:
+            raise ScenarioError('the image has no %s_vect' % name)
+        commands.write('isr %d %d\n' % (vector, table[symbol]))
+
+
+def write_commands(scenario, table, path, masks=None):
+    """The harness commands of a scenario. Without a symbol table the loop and
+    ISR probes are left out, as for the native build; masks maps a port letter
+    to the pins to trace."""
+    with open(path, 'w') as commands:
+        commands.write('mcu %s %d\n' % (MCU, F_CPU))
+        commands.write('stop %d\n' % scenario.duration)
+        for port, mask in sorted((masks or {}).items()):
+            commands.write('trace %s %d\n' % (port, mask))
+        if table is not None:
+            write_probes(scenario, table, commands)
+        if scenario.keypad:
+            commands.write('keypad %s %s\n' % tuple(scenario.keypad))
+        for cycle, command in scenario.events:
+            commands.write('at %d %s\n' % (cycle, ' '.join(command)))
+
+
+class Trace:
+    """The harness output, split by kind."""
+
+    def __init__(self, path):
+        self.loops = []
+        self.isrs = {}
+        self.marks = {}
+        self.ports = {'B': [], 'C': [], 'D': []}
+        self.uart = bytearray()
+        self.sram = None
+        self.end = None
+        self.state = None
+
+        with open(path) as trace:
+            for line in trace:
+                words = line.split()
+                cycle, kind = int(words[0]), words[1]
+                if kind == 'loop':
+                    self.loops.append(cycle)
+                elif kind == 'isr':
+                    self.isrs.setdefault(int(words[2]), []).append(int(words[3]))
+                elif kind == 'port':
+                    self.ports[words[2]].append((cycle, int(words[3]), int(words[4])))
+                elif kind == 'mark':
+                    self.marks.setdefault(words[2], []).append(cycle)
+                elif kind == 'uart':
+                    self.uart.append(int(words[2]))
+                elif kind == 'sram':
+                    self.sram = tuple(int(word) for word in words[2:6])
+                elif kind == 'end':
+                    self.end, self.state = cycle, words[2]
+
+    def edges(self, pin):
+        """(cycle, level) of every change of a pin after the first write, level
+        'z' while the pin is an input"""
+        port, bit = pin
+        level = None
+        changes = []
+        for cycle, value, ddr in self.ports[port]:
+            now = (value >> bit) & 1 if ddr & (1 << bit) else 'z'
+            if now != level:
+                if level is not None:
+                    changes.append((cycle, now))
+                level = now
+        return changes
+
+
+def summary(values):
+    if not values:
+        return {'count': 0}
+    result = {'count': len(values), 'min': min(values), 'mean': round(statistics.mean(values), 1),
+              'max': max(values)}
+    if len(values) > 1:
+        result['stdev'] = round(statistics.pstdev(values), 1)
+    return result
+
+
+def measure(scenario, trace):
+    metrics = {}
+
+    if scenario.loop:
+        loops = trace.loops
+        metrics['loop_period'] = summary([b - a for a, b in zip(loops, loops[1:])])
+
+    for name in scenario.isrs:
+        metrics['isr_%s' % name] = summary(trace.isrs.get(VECTORS.index(name), []))
+
+    for name, mark, pin in scenario.latencies:
+        edges = [cycle for cycle, _ in trace.edges(pin)]
+        latencies = []
+        for start in trace.marks.get(mark, []):
+            later = [cycle for cycle in edges if cycle >= start]
+            if later:
+                latencies.append(later[0] - start)
+        metrics['latency_%s' % name] = summary(latencies)
+
+    for name, pin, edge, start, end in scenario.periods:
+        wanted = {'rising': (1,), 'falling': (0,), 'any': (0, 1, 'z')}[edge]
+        edges = [cycle for cycle, level in trace.edges(pin)
+                 if level in wanted and cycle >= start and (end is None or cycle <= end)]
+        result = summary([b - a for a, b in zip(edges, edges[1:])])
+        if result['count']:
+            result['jitter'] = result['max'] - result['min']
+        metrics['period_%s' % name] = result
+
+    for result in metrics.values():
+        result['unit'] = 'cycles'
+    return metrics
+
+
+def run_project(project, args):
+    scenario = Scenario(os.path.join(SCENARIOS, project + '.sim'))
+    if not args.no_build:
+        build_firmware(project)
+
+    elf = os.path.join(REPO, project, '.pio', 'build', 'uno', 'firmware.elf')
+    table = symbols(elf)
+
+    with tempfile.TemporaryDirectory() as work:
+        commands = os.path.join(work, 'commands')
+        trace_path = os.path.join(work, 'trace')
+        write_commands(scenario, table, commands)
+        status = subprocess.call([args.harness, elf, commands, trace_path])
+        trace = Trace(trace_path)
+
+    if status or trace.state == 'crashed':
+        sys.exit('%s crashed at cycle %s' % (project, trace.end))
+
+    return {'cycles': trace.end, 'state': trace.state, 'metrics': measure(scenario, trace)}
+
+
+def compare(results, baseline, tolerance):
+    """Regressions beyond tolerance percent, as printable lines."""
+    regressions = []
+    for project, result in results['projects'].items():
+        old = baseline.get('projects', {}).get(project, {}).get('metrics', {})
+        for metric, values in result['metrics'].items():
+            for key in COMPARED:
+                before, after = old.get(metric, {}).get(key), values.get(key)
+                if before is None or after is None:
+                    continue
+                if after > before * (1 + tolerance / 100.0) and after > before:
+                    regressions.append('%s %s %s: %s -> %s cycles' % (project, metric, key, before, after))
+    return regressions
+
+
+def git_commit():
+    try:
+        return subprocess.check_output(['git', '-C', REPO, 'rev-parse', 'HEAD'], universal_newlines=True,
+                                       stderr=subprocess.DEVNULL).strip()
+    except (OSError, subprocess.CalledProcessError):
+        return None
+
+
+def print_metrics(project, result):
+    print('%s (%d cycles, %s)' % (project, result['cycles'], result['state']))
+    for metric, values in sorted(result['metrics'].items()):
+        if not values['count']:
+            print('  %-32s no samples' % metric)
+            continue
+        line = '  %-32s n=%-6d min %-8d mean %-10.1f max %-8d' % (metric, values['count'], values['min'],
+                                                                  values['mean'], values['max'])
+        if 'jitter' in values:
+            line += ' jitter %d' % values['jitter']
+        print(line + ' (%.1f us max)' % (values['max'] * 1e6 / F_CPU))
+
+
+def main():
+    projects = sorted(os.path.splitext(name)[0] for name in os.listdir(SCENARIOS) if name.endswith('.sim'))
+
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('projects', nargs='*', metavar='project', help='default: %s' % ', '.join(projects))
+    parser.add_argument('--output', help='write the results as JSON')
+    parser.add_argument('--baseline', help='JSON from an earlier run to compare against')
+    parser.add_argument('--tolerance', type=float, default=DEFAULT_TOLERANCE, help='allowed growth in percent')
+    parser.add_argument('--no-build', action='store_true', help='use the firmware.elf already built')
+    parser.add_argument('--harness', help='prebuilt simbench harness')
+    args = parser.parse_args()
+
+    if not args.harness:
+        build_harness()
+        args.harness = HARNESS
+
+    results = {'commit': git_commit(), 'date': datetime.datetime.now().isoformat(timespec='seconds'), 'mcu': MCU,
+               'f_cpu': F_CPU, 'projects': {}}
+
+    for project in args.projects or projects:
+        try:
+            results['projects'][project] = run_project(project, args)
+        except ScenarioError as error:
+            sys.exit(str(error))
+        print_metrics(project, results['projects'][project])
+
+    if args.output:
+        with open(args.output, 'w') as output:
+            json.dump(results, output, indent=2, sort_keys=True)
+            output.write('\n')
+
+    if args.baseline:
+        with open(args.baseline) as baseline:
+            regressions = compare(results, json.load(baseline), args.tolerance)
+        for line in regressions:
+            print('regression: ' + line)
+        if regressions:
+            sys.exit(1)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,416 @@
+/*
+ * simbench: run a firmware ELF under simavr, apply timed inputs and write a
+ * cycle-stamped trace. tools/simbench.py writes the command file from a
+ * scenario and turns the trace into metrics.
+ *
+ * usage: simbench <firmware.elf> <commands> <trace>
+ *
+ * Commands, one per line, times in CPU cycles and sorted:
+ *
+ *   mcu <name> <frequency>
+ *   stop <cycle>
+ *   loop <address>                  trace each entry to this address
+ *   isr <vector> <address>          time each run of this ISR to its RETI
+ *   keypad <rows> <cols>            4 row and 4 column pins, like D0D7D6D4
+ *   trace <B|C|D> <mask>            pins of the port to trace, all by default
+ *   painted <address>               the firmware paints SRAM from here to RAMEND
+ *   at <cycle> pin <port> <bit> <0|1>
+ *   at <cycle> adc <channel> <millivolts>
+ *   at <cycle> key <row> <col>      hold a key; row -1 releases it
+ *   at <cycle> uart <hex bytes>
+ *   at <cycle> mark <name>
+ *
+ * Trace lines:
+ *
+ *   <cycle> port <B|C|D> <PORTx> <DDRx>    either register changed
+ *   <cycle> loop
+ *   <cycle> isr <vector> <cycles>
+ *   <cycle> uart <byte>
+ *   <cycle> mark <name>
+ *   <cycle> sram <painted> <ramend> <gap start> <gap end>
+ *   <cycle> end <running|sleeping|done|crashed>
+ *
+ * Build: cc -O2 -o simbench simbench.c -I/usr/include/simavr -lsimavr -lelf
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "sim_avr.h"
+#include "sim_elf.h"
+#include "sim_io.h"
+#include "avr_ioport.h"
+#include "avr_adc.h"
+#include "avr_uart.h"
+
+#define MAX_EVENTS 4096
+#define MAX_ISRS 8
+#define PORTS 3
+#define OPCODE_RETI 0x9518
+#define PAINT 0xC5 // STACK_CANARY of lib/StackPaint
+
+// data space addresses of PINx, DDRx and PORTx on the ATmega328P
+static const uint16_t DDR_ADDRESS[PORTS] = {0x24, 0x27, 0x2A};
+static const uint16_t PORT_ADDRESS[PORTS] = {0x25, 0x28, 0x2B};
+static const char PORT_NAME[PORTS] = {'B', 'C', 'D'};
+
+struct event
+{
+    uint64_t cycle;
+    char kind[8];
+    char args[256];
+};
+
+struct isr_watch
+{
+    int vector;
+    uint32_t address;
+    uint64_t start;
+};
+
+struct pin
+{
+    int port; // index into PORT_NAME
+    int bit;
+};
+
+static struct event events[MAX_EVENTS];
+static int eventCount;
+static struct isr_watch isrs[MAX_ISRS];
+static int isrCount;
+static char mcu[32] = "atmega328p";
+static uint32_t frequency = 16000000;
+static uint64_t stopCycle = 16000000;
+static int64_t loopAddress = -1;
+static uint8_t traceMasks[PORTS] = {0xFF, 0xFF, 0xFF};
+static int64_t paintAddress = -1;
+
+static int keypadEnabled;
+static struct pin keypadRows[4], keypadCols[4];
+static int heldRow = -1, heldCol = -1;
+static int colLevels[4] = {1, 1, 1, 1};
+
+static FILE *trace;
+static avr_t *avr;
+
+static int portIndex(char name)
+{
+    const char *found = strchr("BCD", name);
+    return name && found ? (int)(found - "BCD") : -1;
+}
+
+/**
+ * Pins written as port letter and bit, four in a row: D0D7D6D4
+ */
+static int parsePins(const char *text, struct pin *pins)
+{
+    for (int i = 0; i < 4; ++i)
+    {
+        pins[i].port = portIndex(text[2 * i]);
+        pins[i].bit = text[2 * i + 1] - '0';
+        if (pins[i].port < 0 || pins[i].bit < 0 || pins[i].bit > 7)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static void readCommands(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (!file)
+    {
+        perror(path);
+        exit(1);
+    }
+
+    char line[512];
+    while (fgets(line, sizeof(line), file))
+    {
+        char word[32], rows[16], cols[16], port;
+        unsigned long long cycle;
+        unsigned int address, mask;
+        int vector, length;
+
+        if (sscanf(line, "mcu %31s %u", mcu, &frequency) == 2)
+        {
+            continue;
+        }
+        else if (sscanf(line, "stop %llu", &cycle) == 1)
+        {
+            stopCycle = cycle;
+        }
+        else if (sscanf(line, "painted %u", &address) == 1)
+        {
+            paintAddress = address;
+        }
+        else if (sscanf(line, "loop %u", &address) == 1)
+        {
+            loopAddress = address;
+        }
+        else if (sscanf(line, "isr %d %u", &vector, &address) == 2 && isrCount < MAX_ISRS)
+        {
+            isrs[isrCount++] = (struct isr_watch){vector, address, 0};
+        }
+        else if (sscanf(line, "keypad %15s %15s", rows, cols) == 2)
+        {
+            if (parsePins(rows, keypadRows) || parsePins(cols, keypadCols))
+            {
+                fprintf(stderr, "bad keypad pins: %s", line);
+                exit(1);
+            }
+            keypadEnabled = 1;
+        }
+        else if (sscanf(line, "trace %c %u", &port, &mask) == 2 && portIndex(port) >= 0)
+        {
+            traceMasks[portIndex(port)] = mask;
+        }
+        else if (sscanf(line, "at %llu %7s %n", &cycle, word, &length) == 2 && eventCount < MAX_EVENTS)
+        {
+            struct event *event = &events[eventCount++];
+            event->cycle = cycle;
+            strcpy(event->kind, word);
+            snprintf(event->args, sizeof(event->args), "%s", line + length);
+            event->args[strcspn(event->args, "\n")] = '\0';
+        }
+    }
+
+    fclose(file);
+}
+
+/**
+ * The longest run of painted bytes left between the heap and the stack: the
+ * SRAM neither of them ever reached. Written as [start, end).
+ */
+static void writeSram(void)
+{
+    uint32_t start = 0, end = 0, runStart = paintAddress;
+    for (uint32_t address = paintAddress; address <= avr->ramend + 1u; ++address)
+    {
+        if (address <= avr->ramend && avr->data[address] == PAINT)
+        {
+            continue;
+        }
+        if (address - runStart > end - start)
+        {
+            start = runStart;
+            end = address;
+        }
+        runStart = address + 1;
+    }
+
+    fprintf(trace, "%llu sram %u %u %u %u\n", (unsigned long long)avr->cycle, (unsigned)paintAddress,
+            (unsigned)avr->ramend, (unsigned)start, (unsigned)end);
+}
+
+static void setPin(int port, int bit, int level)
+{
+    avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ(PORT_NAME[port]), bit), level);
+}
+
+/**
+ * Drive the column of the held key low while its row is driven low, the way
+ * the switch connects them. Columns float up to their pull-ups otherwise.
+ */
+static void updateKeypad(void)
+{
+    int rowLow = 0;
+    if (heldRow >= 0)
+    {
+        struct pin row = keypadRows[heldRow];
+        uint8_t ddr = avr->data[DDR_ADDRESS[row.port]];
+        uint8_t port = avr->data[PORT_ADDRESS[row.port]];
+        rowLow = (ddr & (1 << row.bit)) && !(port & (1 << row.bit));
+    }
+
+    for (int col = 0; col < 4; ++col)
+    {
+        int level = !(rowLow && col == heldCol);
+        if (level != colLevels[col])
+        {
+            colLevels[col] = level;
+            setPin(keypadCols[col].port, keypadCols[col].bit, level);
+        }
+    }
+}
+
+static void applyEvent(const struct event *event)
+{
+    if (!strcmp(event->kind, "pin"))
+    {
+        char port;
+        int bit, level;
+        if (sscanf(event->args, "%c %d %d", &port, &bit, &level) == 3 && portIndex(port) >= 0)
+        {
+            setPin(portIndex(port), bit, level);
+        }
+    }
+    else if (!strcmp(event->kind, "adc"))
+    {
+        int channel, millivolts;
+        if (sscanf(event->args, "%d %d", &channel, &millivolts) == 2)
+        {
+            avr_raise_irq(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC0 + channel), millivolts);
+        }
+    }
+    else if (!strcmp(event->kind, "key"))
+    {
+        if (sscanf(event->args, "%d %d", &heldRow, &heldCol) != 2 || heldRow < 0)
+        {
+            heldRow = -1;
+        }
+    }
+    else if (!strcmp(event->kind, "uart"))
+    {
+        avr_irq_t *input = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT);
+        const char *hex = event->args;
+        unsigned int byte;
+        int length;
+        while (sscanf(hex, "%2x%n", &byte, &length) == 1)
+        {
+            avr_raise_irq(input, byte);
+            hex += length;
+        }
+    }
+    else if (!strcmp(event->kind, "mark"))
+    {
+        fprintf(trace, "%llu mark %s\n", (unsigned long long)avr->cycle, event->args);
+    }
+}
+
+static void uartOutput(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    (void)irq;
+    (void)param;
+    fprintf(trace, "%llu uart %u\n", (unsigned long long)avr->cycle, value & 0xFF);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 4)
+    {
+        fprintf(stderr, "usage: %s <firmware.elf> <commands> <trace>\n", argv[0]);
+        return 2;
+    }
+
+    readCommands(argv[2]);
+
+    elf_firmware_t firmware = {{0}};
+    if (elf_read_firmware(argv[1], &firmware))
+    {
+        fprintf(stderr, "cannot read %s\n", argv[1]);
+        return 1;
+    }
+
+    avr = avr_make_mcu_by_name(mcu);
+    if (!avr)
+    {
+        fprintf(stderr, "unknown mcu %s\n", mcu);
+        return 1;
+    }
+    avr_init(avr);
+    avr->frequency = frequency;
+    avr->vcc = avr->avcc = avr->aref = 5000;
+    avr_load_firmware(avr, &firmware);
+
+    // paintSram() of lib/StackPaint fills the SRAM above .noinit with PAINT
+    // from .init3, before anything is pushed, so every painted byte that
+    // changes after that was reached by the heap or the stack. Painting here
+    // as well would only be overwritten.
+
+    trace = fopen(argv[3], "w");
+    if (!trace)
+    {
+        perror(argv[3]);
+        return 1;
+    }
+
+    // UART output goes to the trace, not the terminal
+    uint32_t flags = 0;
+    avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+    flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT), uartOutput, NULL);
+
+    uint8_t ports[PORTS], ddrs[PORTS];
+    for (int i = 0; i < PORTS; ++i)
+    {
+        ports[i] = avr->data[PORT_ADDRESS[i]] & traceMasks[i];
+        ddrs[i] = avr->data[DDR_ADDRESS[i]] & traceMasks[i];
+    }
+
+    int next = 0;
+    int activeIsr = -1;
+    int state = cpu_Running;
+
+    while (avr->cycle < stopCycle && state != cpu_Done && state != cpu_Crashed)
+    {
+        while (next < eventCount && events[next].cycle <= avr->cycle)
+        {
+            applyEvent(&events[next++]);
+        }
+
+        avr_flashaddr_t pc = avr->pc;
+        int reti = 0;
+
+        if (state == cpu_Running)
+        {
+            if ((int64_t)pc == loopAddress)
+            {
+                fprintf(trace, "%llu loop\n", (unsigned long long)avr->cycle);
+            }
+
+            for (int i = 0; i < isrCount && activeIsr < 0; ++i)
+            {
+                if (pc == isrs[i].address)
+                {
+                    activeIsr = i;
+                    isrs[i].start = avr->cycle;
+                }
+            }
+
+            reti = activeIsr >= 0 && (avr->flash[pc] | (avr->flash[pc + 1] << 8)) == OPCODE_RETI;
+        }
+
+        state = avr_run(avr);
+
+        if (reti)
+        {
+            struct isr_watch *isr = &isrs[activeIsr];
+            fprintf(trace, "%llu isr %d %llu\n", (unsigned long long)isr->start, isr->vector,
+                    (unsigned long long)(avr->cycle - isr->start));
+            activeIsr = -1;
+        }
+
+        for (int i = 0; i < PORTS; ++i)
+        {
+            uint8_t port = avr->data[PORT_ADDRESS[i]] & traceMasks[i];
+            uint8_t ddr = avr->data[DDR_ADDRESS[i]] & traceMasks[i];
+            if (port != ports[i] || ddr != ddrs[i])
+            {
+                ports[i] = port;
+                ddrs[i] = ddr;
+                fprintf(trace, "%llu port %c %u %u\n", (unsigned long long)avr->cycle, PORT_NAME[i], port, ddr);
+            }
+        }
+
+        if (keypadEnabled)
+        {
+            updateKeypad();
+        }
+    }
+
+    if (paintAddress >= 0 && paintAddress <= avr->ramend)
+    {
+        writeSram();
+    }
+
+    static const char *const STATES[] = {"limbo", "stopped", "running", "sleeping", "step", "step_done", "done",
+                                         "crashed"};
+    fprintf(trace, "%llu end %s\n", (unsigned long long)avr->cycle,
+            state >= 0 && state < (int)(sizeof(STATES) / sizeof(STATES[0])) ? STATES[state] : "unknown");
+    fclose(trace);
+
+    return state == cpu_Crashed;
+}